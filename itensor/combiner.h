@@ -29,7 +29,11 @@ class Combiner
     {
     public:
 
-    using left_it = array<Index,NMAX+1>::const_iterator;
+    //left_[0] is unused so that left indices are
+    //numbered from 1 as in groupIndices
+    using LeftStorage = SmallVector<Index,NMAX+1>;
+
+    using left_it = LeftStorage::const_iterator;
 
     //Accessor Methods ----------------------------------------------
 
@@ -51,7 +55,7 @@ class Combiner
 
     //Constructors --------------------------------------------------
 
-    Combiner() : rl_(0), initted(false) {}
+    Combiner() : left_(1), rl_(0), initted(false) {}
 
     Combiner(const Index& l1, const Index& l2 = Index::Null(), 
              const Index& l3 = Index::Null(), const Index& l4 = Index::Null(), 
@@ -117,7 +121,7 @@ class Combiner
 
     /////////
 
-    array<Index,NMAX+1> left_; // max dim is 8
+    LeftStorage left_;
     mutable Index right_;
     int rl_; //Number of m>1 'left' indices (indices to be combined into one)
     mutable bool initted;
@@ -151,16 +155,16 @@ Combiner(const Index& l1, const Index& l2,
          const Index& l5, const Index& l6, 
          const Index& l7, const Index& l8)
     : 
+    left_(1),
     rl_(0), 
     initted(false)
 	{
-    array<const Index*,NMAX+1> ll 
-    = {{ &Index::Null(), &l1, &l2, &l3, &l4, &l5, &l6, &l7, &l8 }};
-
-    do { ++rl_; left_[rl_] = *ll[rl_]; } 
-    while(rl_ < NMAX && *ll[rl_+1] != Index::Null());
-
-    assert(rl_ == NMAX || left_[rl_+1] == Index::Null());
+    for(const Index* l : { &l1, &l2, &l3, &l4, &l5, &l6, &l7, &l8 })
+        {
+        if(*l == Index::Null()) break;
+        left_.push_back(*l);
+        ++rl_;
+        }
     assert(left_[rl_] != Index::Null());
 	}
 
@@ -168,6 +172,7 @@ inline
 void Combiner::
 reset()
     {
+    left_.resize(1);
     rl_ = 0;
     initted = false;
     }
@@ -176,20 +181,18 @@ void inline Combiner::
 addleft(const Index& l)// Include another left index
     { 
     initted = false;
-    if(rl_ == NMAX) 
-        Error("Combiner: already reached max number of left indices.");
-    ++rl_;
-    left_[rl_] = l; 
+    left_.resize(++rl_);
+    left_.push_back(l); 
     }
 
 void inline Combiner::
 addleft(const std::vector<Index>& ls)
     { 
     initted = false;
-    if(rl_+int(ls.size()) > NMAX) 
-        Error("Combiner: too many left indices.");
+    left_.resize(rl_+1);
     for(size_t j = 0; j < ls.size(); ++j)
-        left_[++rl_] = ls[j]; 
+        left_.push_back(ls[j]); 
+    rl_ += ls.size();
     }
 
 inline
@@ -0,0 +1,164 @@
+//
+// Distributed under the ITensor Library License, Version 1.1.
+//    (See accompanying LICENSE file.)
+//
+#include "contract.h"
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+
+namespace itensor {
+namespace detail {
+
+using std::vector;
+using std::pair;
+
+//Networks with more tensors than this are
+//contracted from left to right instead
+const int MaxOptimalOrder = 12;
+
+//Most network shapes whose order is cached (per thread)
+const size_t MaxCachedOrders = 256;
+
+using Bits = vector<unsigned long long>;
+
+//Search over all ways of splitting each subset of the
+//tensors into two (dynamic programming over subsets)
+vector<ContractStep> static
+optimalOrder(const vector<vector<pair<int,long>>>& ops)
+    {
+    const int n = ops.size();
+    int nlabel = 0;
+    for(const auto& op : ops)
+    for(const auto& I : op)
+        {
+        nlabel = std::max(nlabel,I.first+1);
+        }
+    vector<long> dim(nlabel,1);
+    const int nw = (nlabel+63)/64;
+
+    const long nsub = 1l << n;
+    //open[s]: labels of the indices of the product of
+    //the tensors in subset s (an index contracted once
+    //both of its tensors are included)
+    vector<Bits> open(nsub,Bits(nw,0));
+    vector<double> cost(nsub,0);
+    vector<long> split(nsub,0);
+
+    for(int t = 0; t < n; ++t)
+    for(const auto& I : ops[t])
+        {
+        open[1l << t][I.first/64] ^= (1ull << (I.first%64));
+        dim[I.first] = I.second;
+        }
+
+    //Number of elements of the product of subsets a and b
+    //times the dimension of the indices contracted by it
+    auto pairCost = [&](long a, long b)
+        {
+        double c = 1;
+        for(int w = 0; w < nw; ++w)
+            {
+            auto bits = open[a][w] | open[b][w];
+            for(int j = 0; bits != 0; ++j, bits >>= 1)
+                {
+                if(bits & 1) c *= dim[64*w+j];
+                }
+            }
+        return c;
+        };
+
+    for(long s = 1; s < nsub; ++s)
+        {
+        const long low = s & (-s);
+        if(s == low) continue;
+        const long rest = s ^ low;
+        for(int w = 0; w < nw; ++w) open[s][w] = open[low][w] ^ open[rest][w];
+        cost[s] = -1;
+        //Only subsets a containing the lowest member of s,
+        //so each split is considered once
+        for(long a = s; a > 0; a = (a-1) & s)
+            {
+            if(!(a & low) || a == s) continue;
+            const long b = s ^ a;
+            const double c = cost[a]+cost[b]+pairCost(a,b);
+            if(cost[s] < 0 || c < cost[s])
+                {
+                cost[s] = c;
+                split[s] = a;
+                }
+            }
+        }
+
+    vector<ContractStep> steps;
+    //Returns the number of the tensor holding the product of subset s
+    std::function<int(long)> build = [&](long s) -> int
+        {
+        if((s & (s-1)) == 0)
+            {
+            int t = 0;
+            while((1l << t) != s) ++t;
+            return t;
+            }
+        const int a = build(split[s]),
+                  b = build(s ^ split[s]);
+        steps.emplace_back(a,b);
+        return n+steps.size()-1;
+        };
+    build(nsub-1);
+    return steps;
+    }
+
+using OrderKey = vector<long>;
+
+struct OrderKeyHash
+    {
+    size_t
+    operator()(const OrderKey& key) const
+        {
+        size_t h = key.size();
+        for(auto k : key)
+            {
+            h ^= std::hash<long>()(k) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            }
+        return h;
+        }
+    };
+
+vector<ContractStep>
+contractionOrder(const vector<vector<pair<int,long>>>& ops)
+    {
+    const int n = ops.size();
+    vector<ContractStep> steps;
+    if(n < 2) return steps;
+
+    if(n > MaxOptimalOrder)
+        {
+        steps.emplace_back(0,1);
+        for(int t = 2; t < n; ++t) steps.emplace_back(n+t-2,t);
+        return steps;
+        }
+
+    OrderKey key;
+    for(const auto& op : ops)
+        {
+        key.push_back(op.size());
+        for(const auto& I : op)
+            {
+            key.push_back(I.first);
+            key.push_back(I.second);
+            }
+        }
+
+    thread_local std::unordered_map<OrderKey,vector<ContractStep>,OrderKeyHash> cache;
+    auto it = cache.find(key);
+    if(it != cache.end()) return it->second;
+
+    steps = optimalOrder(ops);
+    if(cache.size() >= MaxCachedOrders) cache.clear();
+    cache.emplace(std::move(key),steps);
+    return steps;
+    }
+
+} //namespace detail
+} //namespace itensor
@@ -0,0 +1,155 @@
+//
+// Distributed under the ITensor Library License, Version 1.1.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_CONTRACT_H
+#define __ITENSOR_CONTRACT_H
+
+#include "global.h"
+#include <vector>
+#include <utility>
+#include <initializer_list>
+
+namespace itensor {
+
+namespace detail {
+
+//
+// Finds an order of pairwise products minimizing the
+// total cost of contracting a network of tensors.
+//
+// Tensor i of the network has the indices ops[i],
+// each given as (label,dimension); indices with the
+// same label are contracted when their tensors are
+// multiplied (as for the ITensor * operator).
+//
+// Returns the products to perform as pairs (a,b):
+// tensors are numbered 0,...,n-1 and the result
+// of product number k gets the number n+k.
+//
+// The order found for a given network shape is cached
+// (per thread) so that later calls skip the search.
+//
+using ContractStep = std::pair<int,int>;
+
+std::vector<ContractStep>
+contractionOrder(const std::vector<std::vector<std::pair<int,long>>>& ops);
+
+} //namespace detail
+
+//
+// ContractExpr
+//
+// Records a product of several tensors without carrying
+// it out. Evaluating the expression multiplies the
+// tensors pairwise in the order of least cost (estimated
+// from the dimensions of their indices), instead of from
+// left to right.
+//
+// Only references to the tensors are kept, so an
+// expression must be evaluated before they go away;
+// normally it is created by contract(...) and evaluated
+// in the same statement:
+//
+//     ITensor R = contract(A,B,C,D);
+//
+template<typename Tensor>
+class ContractExpr
+    {
+    public:
+
+    using IndexT = typename Tensor::IndexT;
+
+    ContractExpr() { }
+
+    explicit
+    ContractExpr(const Tensor& T) { add(T); }
+
+    //Include T in the product
+    ContractExpr&
+    add(const Tensor& T)
+        {
+        ops_.push_back(&T);
+        return *this;
+        }
+
+    int
+    size() const { return ops_.size(); }
+
+    Tensor
+    eval() const;
+
+    operator Tensor() const { return eval(); }
+
+    private:
+
+    std::vector<const Tensor*> ops_;
+    };
+
+template<typename Tensor, typename... Rest>
+ContractExpr<Tensor>
+contract(const Tensor& T, const Rest&... rest)
+    {
+    ContractExpr<Tensor> expr(T);
+    for(const Tensor* p : std::initializer_list<const Tensor*>{&rest...}) expr.add(*p);
+    return expr;
+    }
+
+template<typename Tensor>
+Tensor ContractExpr<Tensor>::
+eval() const
+    {
+    const int n = ops_.size();
+    if(n == 0) Error("Empty ContractExpr");
+    if(n == 1) return *ops_.front();
+
+    //Label distinct (m != 1) indices in order of appearance
+    std::vector<const IndexT*> labels;
+    std::vector<std::vector<std::pair<int,long>>> sig(n);
+    for(int t = 0; t < n; ++t)
+        {
+        for(const IndexT& I : ops_[t]->indices())
+            {
+            if(I.m() == 1) continue;
+            int l = 0;
+            while(l < int(labels.size()) && !(*labels[l] == I)) ++l;
+            if(l == int(labels.size())) labels.push_back(&I);
+            sig[t].emplace_back(l,I.m());
+            }
+        }
+
+    const auto steps = detail::contractionOrder(sig);
+
+    //Each intermediate is used by exactly one later step,
+    //after which it is released, so at most the operands
+    //and result of the current step are held at once
+    std::vector<Tensor> inter(steps.size());
+    for(size_t k = 0; k < steps.size(); ++k)
+        {
+        const int a = steps[k].first,
+                  b = steps[k].second;
+        if(a < n) 
+            {
+            inter[k] = *ops_[a];
+            }
+        else
+            {
+            inter[k] = std::move(inter[a-n]);
+            inter[a-n] = Tensor();
+            }
+        if(b < n) 
+            {
+            inter[k] *= *ops_[b];
+            }
+        else
+            {
+            inter[k] *= inter[b-n];
+            inter[b-n] = Tensor();
+            }
+        }
+    return std::move(inter.back());
+    }
+
+} //namespace itensor
+
+#endif
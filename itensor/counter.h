@@ -47,21 +47,36 @@ namespace itensor {
 // v[C.ind] == v[_ind(C.i[1],C.i[2],...,C.i[8]]
 // where v is the Vector in an ITDat.
 //
+// The arrays C.n and C.i always have at least
+// NMAX+1 elements, those past C.rn having
+// C.n[j] == 1 and C.i[j] == 0, so fixed-length
+// expressions over the first NMAX entries
+// remain valid for Counters of low rank.
+//
 
 class Counter
     {
     public:
 
-    array<int,NMAX+1> n, 
-                      i;
+    using Store = SmallVector<int,NMAX+1>;
+
+    Store n, 
+          i;
     int ind,
         rn,
         r;
 
     Counter();
 
-    template <class IndexT>
-    Counter(const array<IndexT,NMAX+1>& ii,int rn,int r);
+    //Empty Counter (rn == 0) whose n and i
+    //have room for maxrank indices; used when
+    //the ranges are filled in one by one
+    explicit
+    Counter(int maxrank);
+
+    //ii is one-indexed: ii[1],...,ii[rn]
+    template <class IndexContainer>
+    Counter(const IndexContainer& ii,int rn,int r);
 
     template <class IndexT> 
     explicit
@@ -76,6 +91,13 @@ class Counter
     void 
     reset();
 
+    protected:
+
+    //Size n and i for up to maxrank indices,
+    //setting all ranges to 1
+    void
+    allocate(int maxrank);
+
     };
 
 
@@ -87,9 +109,14 @@ inline Counter::
 Counter() 
     : rn(0), r(0)
     {
-    n.fill(1); 
-    n[0] = 0;
-    reset();
+    allocate(NMAX);
+    }
+
+inline Counter::
+Counter(int maxrank) 
+    : rn(0), r(0)
+    {
+    allocate(maxrank);
     }
 
 void inline Counter::
@@ -99,18 +126,25 @@ reset()
     ind = 0;
     }
 
-template <class IndexT>
+void inline Counter::
+allocate(int maxrank)
+    {
+    const int size = std::max(maxrank,NMAX)+1;
+    n.assign(size,1);
+    n[0] = 0;
+    i.assign(size,0);
+    ind = 0;
+    }
+
+template <class IndexContainer>
 Counter::
-Counter(const array<IndexT,NMAX+1>& ii, int rn_, int r_)
+Counter(const IndexContainer& ii, int rn_, int r_)
     {
     rn = rn_;
     r = r_;
-    n[0] = 0;
+    allocate(rn);
     for(int j = 1; j <= rn; ++j) 
         n[j] = ii[j].m();
-    for(int j = rn+1; j <= NMAX; ++j) 
-        n[j] = 1;
-    reset();
     }
 
 template <class IndexT>
@@ -119,12 +153,9 @@ Counter(const IndexSet<IndexT>& is)
     {
     rn = is.rn();
     r = is.r();
-    n[0] = 0;
+    allocate(r);
     for(int j = 1; j <= rn; ++j) 
         n[j] = is.index(j).m();
-    for(int j = rn+1; j <= NMAX; ++j) 
-        n[j] = 1;
-    reset();
     }
 
 inline
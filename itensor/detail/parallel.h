@@ -0,0 +1,179 @@
+//
+// Distributed under the ITensor Library License, Version 1.1.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_PARALLEL_H
+#define __ITENSOR_PARALLEL_H
+
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <algorithm>
+
+namespace itensor {
+namespace detail {
+
+//
+// True while the calling thread works on one of several
+// concurrent pieces of work started by the functions
+// below; work they start from inside such a piece
+// runs serially on the calling thread
+//
+bool inline&
+inParallelTask()
+    {
+    thread_local bool in_task = false;
+    return in_task;
+    }
+
+//Marks the calling thread as inside a parallel
+//task for as long as the object exists
+class ParallelTaskScope
+    {
+    public:
+
+    ParallelTaskScope() : outer_(inParallelTask()) { inParallelTask() = true; }
+
+    ~ParallelTaskScope() { inParallelTask() = outer_; }
+
+    private:
+
+    bool outer_;
+    };
+
+//Keeps the first exception thrown by any of the
+//threads of a parallel region, to be rethrown on
+//the calling thread once they have all finished
+class TaskErrors
+    {
+    public:
+
+    //Runs f, catching what it throws; false if f threw
+    template<typename Func>
+    bool
+    run(Func&& f)
+        {
+        try 
+            { 
+            f(); 
+            return true;
+            }
+        catch(...)
+            {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(!error_) error_ = std::current_exception();
+            failed_ = true;
+            return false;
+            }
+        }
+
+    bool
+    failed() const { return failed_; }
+
+    void
+    rethrow() const { if(error_) std::rethrow_exception(error_); }
+
+    private:
+
+    std::mutex mutex_;
+    std::exception_ptr error_;
+    std::atomic<bool> failed_{false};
+    };
+
+//
+// Splits the range [0,n) into (at most) nthread
+// contiguous pieces and calls f(begin,end) on each
+// piece concurrently. The calling thread works on
+// the first piece itself.
+//
+// If nthread <= 1 or n is too small to split,
+// simply calls f(0,n).
+//
+// An exception thrown by f on any thread is rethrown
+// on the calling thread after all pieces have ended.
+//
+template<typename Func>
+void
+parallelRanges(long n, int nthread, Func&& f)
+    {
+    if(n <= 0) return;
+    const long nt = (inParallelTask() ? 1 : std::min(long(nthread),n));
+    if(nt <= 1)
+        {
+        f(0l,n);
+        return;
+        }
+    const long chunk = n/nt,
+               extra = n%nt;
+    TaskErrors errors;
+    std::vector<std::thread> workers;
+    workers.reserve(nt-1);
+    long begin = chunk+(extra > 0 ? 1 : 0);
+    const long first_end = begin;
+    for(long t = 1; t < nt; ++t)
+        {
+        const long end = begin+chunk+(t < extra ? 1 : 0);
+        workers.emplace_back([&f,&errors,begin,end]() 
+            { 
+            ParallelTaskScope scope;
+            errors.run([&]() { f(begin,end); });
+            });
+        begin = end;
+        }
+        {
+        ParallelTaskScope scope;
+        errors.run([&]() { f(0l,first_end); });
+        }
+    for(auto& w : workers) w.join();
+    errors.rethrow();
+    }
+
+//
+// Calls f(k) for k = 0,1,...,n-1 using up to nthread
+// threads (including the calling one). Each thread
+// takes the next task not yet started, so tasks begin
+// in order of k: listing the largest tasks first keeps
+// the threads evenly loaded.
+//
+// If nthread <= 1 or n < 2, calls f(k) in order on
+// the calling thread.
+//
+// If f throws, tasks not yet started are skipped and
+// the (first) exception is rethrown on the calling
+// thread after the running ones have ended.
+//
+template<typename Func>
+void
+parallelTasks(long n, int nthread, Func&& f)
+    {
+    if(n <= 0) return;
+    const long nt = (inParallelTask() ? 1 : std::min(long(nthread),n));
+    if(nt <= 1)
+        {
+        for(long k = 0; k < n; ++k) f(k);
+        return;
+        }
+    std::atomic<long> next(0);
+    TaskErrors errors;
+    auto work = [&f,&next,&errors,n]()
+        {
+        ParallelTaskScope scope;
+        for(long k = next++; k < n && !errors.failed(); k = next++) 
+            {
+            errors.run([&]() { f(k); });
+            }
+        };
+    std::vector<std::thread> workers;
+    workers.reserve(nt-1);
+    for(long t = 1; t < nt; ++t) workers.emplace_back(work);
+    work();
+    for(auto& w : workers) w.join();
+    errors.rethrow();
+    }
+
+} //namespace detail
+} //namespace itensor
+
+#endif
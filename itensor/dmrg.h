@@ -184,6 +184,28 @@ DMRGWorker(MPSt<Tensor>& psi,
     return energy;
     }
 
+//Holds a tensor in single precision for the lifetime
+//of the scope, returning it to double precision on exit
+//(including exit by an exception)
+template <class Tensor>
+class SinglePrecisionScope
+    {
+    Tensor& t_;
+    bool on_;
+    public:
+    SinglePrecisionScope(Tensor& t, bool on = true)
+        : t_(t), on_(on)
+        { 
+        if(on_) t_.toSinglePrecision(); 
+        }
+    ~SinglePrecisionScope() 
+        { 
+        if(on_) t_.toDoublePrecision(); 
+        }
+    SinglePrecisionScope(const SinglePrecisionScope&) = delete;
+    SinglePrecisionScope& operator=(const SinglePrecisionScope&) = delete;
+    };
+
 template <class Tensor, class LocalOpT>
 Real
 DMRGWorker(MPSt<Tensor>& psi,
@@ -202,6 +224,10 @@ DMRGWorker(MPSt<Tensor>& psi,
 
     args.add("DebugLevel",debug_level);
     args.add("DoNormalize",true);
+
+    //Run the Davidson step in single precision
+    //during the first SinglePrecisionSweeps sweeps
+    const int single_sweeps = args.getInt("SinglePrecisionSweeps",0);
     
     for(int sw = 1; sw <= sweeps.nsweep(); ++sw)
         {
@@ -237,7 +263,10 @@ DMRGWorker(MPSt<Tensor>& psi,
 
             Tensor phi = psi.A(b)*psi.A(b+1);
 
-            energy = davidson(PH,phi,args);
+                {
+                SinglePrecisionScope<Tensor> single(phi,sw <= single_sweeps);
+                energy = davidson(PH,phi,args);
+                }
             
             Spectrum spec = psi.svdBond(b,phi,(ha==1?Fromleft:Fromright),PH,args);
 
@@ -265,7 +294,7 @@ DMRGWorker(MPSt<Tensor>& psi,
         if(obs.checkDone(args)) break;
     
         } //for loop over sw
-    
+
     psi.normalize();
 
     return energy;
@@ -571,6 +571,10 @@ complexDavidson(const BigMatrixT& A,
     V[0] = phi.front();
     A.product(V[0],AV[0]);
 
+    //Keep the Krylov vectors in the precision 
+    //of the starting vector
+    const bool single = phi.front().isSinglePrecision();
+
     Complex z = BraKet(V[0],AV[0]);
     const Real initEn = z.real();
 
@@ -845,6 +849,7 @@ complexDavidson(const BigMatrixT& A,
         //Step G of Davidson (1975)
         //Expand AV and M
         //for next step
+        if(single) q.toSinglePrecision();
         A.product(V[ni],AV[ni]);
 
         //Step H of Davidson (1975)
@@ -37,6 +37,9 @@ namespace itensor {
 
 enum Direction { Fromright, Fromleft, Both, None };
 
+//Number of indices of a tensor which are stored
+//without heap allocation and handled by the unrolled
+//fast paths; tensors may have more indices than this
 static const int NMAX = 8;
 static const Real MIN_CUT = 1E-15;
 static const int MAX_M = 5000;
@@ -344,6 +347,18 @@ class Global
         {
         Args::Global().add(name,sval);
         }
+    //Number of threads used by the tensor kernels
+    //which support multithreading (default is 1).
+    //Their tasks make single threaded BLAS calls with
+    //MKL or OpenBLAS; with other BLAS libraries, set
+    //BLAS to run serially (e.g. VECLIB_MAXIMUM_THREADS=1
+    //with Accelerate) to avoid oversubscribing
+    static int&
+    nthread()
+        {
+        static int nthread_ = 1;
+        return nthread_;
+        }
     static bool& 
     printdat()
         {
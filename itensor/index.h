@@ -159,6 +159,11 @@ class Index
     using IDGenerator = mt19937;
     using IDType = IDGenerator::result_type;
 
+    // Returns the number shared by all copies of
+    // this Index (id() returns it as a string)
+    IDType
+    rawId() const { return id_; }
+
     private:
 
     /////////////
@@ -6,6 +6,7 @@
 #define __ITENSOR_INDEXSET_H
 #include "index.h"
 #include "permutation.h"
+#include "smallvector.h"
 
 namespace itensor {
 
@@ -13,6 +14,12 @@ namespace itensor {
 //
 // IndexSet
 //
+// Holds the indices of a tensor, with all m!=1
+// indices coming before the m==1 indices.
+// There is no upper limit on the number of indices;
+// sets of up to NMAX indices are stored inline
+// without any heap allocation.
+//
 
 template <class IndexT>
 class IndexSet
@@ -46,7 +53,7 @@ class IndexSet
     // Type definitions
     //
 
-    using Storage = array<IndexT,NMAX>;
+    using Storage = SmallVector<IndexT,NMAX>;
 
     using const_iterator = typename Storage::const_iterator;
 
@@ -177,6 +184,7 @@ template<class IndexT>
 IndexSet<IndexT>::
 IndexSet(const IndexT& i1)
     :
+    index_(1,i1),
     rn_((i1.m() == 1 ? 0 : 1)),
     r_(1)
     { 
@@ -184,13 +192,13 @@ IndexSet(const IndexT& i1)
     if(i1 == IndexT::Null())
         Error("i1 is null");
 #endif
-    index_[0] = i1;
     }
 
 template<class IndexT>
 IndexSet<IndexT>::
 IndexSet(const IndexT& i1, const IndexT& i2)
     :
+    index_(2),
     r_(2)
     { 
 #ifdef DEBUG
@@ -229,8 +237,8 @@ IndexSet(IndexT i1, IndexT i2, IndexT i3,
     if(i3 == IndexT::Null())
         Error("i3 is null");
 #endif
-    array<IndexT,NMAX> ii = {{ i1, i2, i3, i4, i5, i6, i7, i8 }};
-	while(r_ < NMAX && ii[r_] != IndexT::Null()) ++r_;
+    const array<IndexT,8> ii = {{ i1, i2, i3, i4, i5, i6, i7, i8 }};
+	while(r_ < int(ii.size()) && ii[r_] != IndexT::Null()) ++r_;
     int alloc_size;
     sortIndices(ii,r_,alloc_size,0);
     }
@@ -260,6 +268,7 @@ template <class IndexT>
 IndexSet<IndexT>::
 IndexSet(const IndexSet& other, const Permutation& P)
     :
+    index_(other.r_),
     rn_(other.rn_),
     r_(other.r_)
     {
@@ -490,8 +499,6 @@ void IndexSet<IndexT>::
 addindex(const IndexT& I)
     {
 #ifdef DEBUG
-    if(r_ == NMAX) 
-        Error("Maximum number of indices reached");
     if(I == IndexT::Null())
         Error("Index is null");
     for(int j = (I.m()==1 ? rn_ : 0); j < r_; ++j)
@@ -504,6 +511,7 @@ addindex(const IndexT& I)
             }
         }
 #endif
+    index_.resize(r_+1);
     if(I.m() == 1)
         {
         index_[r_] = I;
@@ -606,6 +614,7 @@ template <class IndexT>
 void IndexSet<IndexT>::
 clear()
     {
+    index_.clear();
     rn_ = 0;
     r_ = 0;
     }
@@ -624,6 +633,7 @@ read(std::istream& s)
     {
     s.read((char*) &r_,sizeof(r_));
     s.read((char*) &rn_,sizeof(rn_));
+    index_.resize(r_);
     for(int j = 0; j < r_; ++j) 
         {
         index_[j].read(s);
@@ -645,16 +655,12 @@ template <class Iterable>
 void IndexSet<IndexT>::
 sortIndices(const Iterable& I, int ninds, int& alloc_size, int offset)
     {
-#ifdef DEBUG
-    if(ninds > NMAX)
-        Error("Too many indices for IndexSet");
-#endif
-
+    index_.resize(ninds);
     rn_ = 0;
     alloc_size = 1;
 
     int r1_ = 0;
-    array<const IndexT*,NMAX> index1_;
+    SmallVector<const IndexT*,NMAX> index1_(ninds);
 
     for(int n = offset; n < ninds+offset; ++n)
         {
@@ -741,12 +747,13 @@ findtype(const IndexSet<IndexT>& iset, IndexType t)
 
 //
 // Compute the permutation P taking an IndexSet iset
-// to oset (of type IndexSet or array<IndexT,NMAX>)
+// to oset (an IndexSet, or any container of
+// IndexT's such as IndexSet<IndexT>::Storage)
 //
-template <class IndexT>
+template <class IndexT, class OSet>
 void
 getperm(const IndexSet<IndexT>& iset, 
-        const typename IndexSet<IndexT>::Storage& oset, 
+        const OSet& oset, 
         Permutation& P)
 	{
 	for(int j = 0; j < iset.r(); ++j)
@@ -3,6 +3,8 @@
 //    (See accompanying LICENSE file.)
 //
 #include "iqcombiner.h"
+#include "detail/parallel.h"
+#include <algorithm>
 
 namespace itensor {
 
@@ -13,19 +15,101 @@ using std::endl;
 using std::vector;
 using std::string;
 
-size_t static
-indexPos(const IQCombiner& C, const Index& i)
+//Most routing plans kept by an IQCombiner
+const size_t MaxRoutePlans = 4;
+
+//Least total size of the blocks of an IQTensor
+//for which they are combined in parallel
+const double MinParallelWork = 1E6;
+
+//Stride of the sector number of I in the
+//block positions of an IQTensor with indices is
+long static
+sectorStride(const IndexSet<IQIndex>& is, const IQIndex& I)
     {
-    size_t dim = 1;
-    for(const IQIndex& J : C.left())
+    long dim = 1;
+    for(const IQIndex& J : is)
         {
-        const int f = findindex(J,i);
-        if(f != 0) return dim*(f-1);
+        if(J == I) return dim;
         dim *= J.nindex();
         }
+    Error("IQIndex not found in sectorStride");
     return 0;
     }
 
+//Same indices, including their arrows
+bool static
+sameIndices(const IndexSet<IQIndex>& a, const IndexSet<IQIndex>& b)
+    {
+    if(a.r() != b.r()) return false;
+    for(int j = 1; j <= a.r(); ++j)
+        {
+        if(a.index(j) != b.index(j) || a.index(j).dir() != b.index(j).dir()) return false;
+        }
+    return true;
+    }
+
+struct IQCombiner::RoutePlan
+    {
+    bool expand = false;
+
+    //Indices of the IQTensors the plan applies to
+    //and indices of the result
+    IndexSet<IQIndex> in;
+    std::vector<IQIndex> out;
+
+    //For each index of the input: number of sectors,
+    //stride in the block position of the result (indices 
+    //not combined), stride in the Combiner number (left
+    //indices, when combining)
+    std::vector<long> nsec,
+                      outStride,
+                      combStride;
+
+    //Combining: stride of the combined index in the result
+    //and its sector for each Combiner
+    long rStride = 0;
+    std::vector<long> combSector;
+
+    //Expanding: position of the combined index in the input,
+    //Combiner for each of its sectors, and number of sectors
+    //and stride in the result of each left index
+    int rInd = -1;
+    std::vector<long> sectorComb,
+                      leftSec,
+                      leftStride;
+
+    //Number of the Combiner taking the input block 
+    //at position pos, and the position it goes to
+    void
+    route(long pos, long& comb, long& outpos) const
+        {
+        comb = 0;
+        outpos = 0;
+        for(size_t j = 0; j < nsec.size(); ++j)
+            {
+            const long s = pos%nsec[j];
+            pos /= nsec[j];
+            if(expand && int(j) == rInd) comb = sectorComb[s];
+            else if(outStride[j] != 0) outpos += s*outStride[j];
+            else comb += s*combStride[j];
+            }
+        if(expand)
+            {
+            long c = comb;
+            for(size_t l = 0; l < leftSec.size(); ++l)
+                {
+                outpos += (c%leftSec[l])*leftStride[l];
+                c /= leftSec[l];
+                }
+            }
+        else
+            {
+            outpos += combSector[comb]*rStride;
+            }
+        }
+    };
+
 
 IQCombiner::
 IQCombiner() 
@@ -62,6 +146,10 @@ IQCombiner(const IQCombiner& other)
     cond = other.cond;
     ucright_ = other.ucright_;
     do_condense = other.do_condense;
+    combSector_ = other.combSector_;
+    sectorComb_ = other.sectorComb_;
+    std::lock_guard<std::mutex> lock(other.plansMutex_);
+    plans_ = other.plans_;
     }
 
 IQCombiner& IQCombiner::
@@ -75,6 +163,10 @@ operator=(const IQCombiner& other)
     cond = other.cond;
     ucright_ = other.ucright_;
     do_condense = other.do_condense;
+    combSector_ = other.combSector_;
+    sectorComb_ = other.sectorComb_;
+    std::lock_guard<std::mutex> lock(other.plansMutex_);
+    plans_ = other.plans_;
     return *this;
     }
 
@@ -91,6 +183,7 @@ void IQCombiner::
 reset()
     {
     left_.clear();
+    plans_.clear();
     initted = false;
     }
 
@@ -103,6 +196,7 @@ addleft(const IQIndex& l) 	// Include another left index
     //Flip arrows to make combiner compatible with
     //the IQTensor from which it got its left indices
     left_.back().dag();
+    plans_.clear();
     initted = false;
 	}
 
@@ -144,6 +238,9 @@ init(string rname, IndexType type,
         storage_dim *= L.nindex();
         }
     combs_.resize(storage_dim);
+    combSector_.assign(storage_dim,0);
+    sectorComb_.assign(storage_dim,0);
+    plans_.clear();
 
     //Construct individual Combiners
     QCounter c(left_);
@@ -159,6 +256,9 @@ init(string rname, IndexType type,
         co.addleft(vind);
         co.init(rname+q.toString(),type,rdir,primelevel);
 
+        combSector_[pos] = iq.size();
+        sectorComb_[iq.size()] = pos;
+
         iq.push_back(IndexQN(co.right(),q));
         }
 
@@ -221,6 +321,7 @@ right() const
 void  IQCombiner::
 prime(IndexType type, int inc)
     {
+    plans_.clear();
     for(IQIndex& ll : left_)
         ll.prime(type,inc);
     for(Combiner& co : combs_)
@@ -241,6 +342,7 @@ void IQCombiner::
 dag() 
     { 
     init();
+    plans_.clear();
     for(IQIndex& I : left_) I.dag(); 
     if(do_condense) 
         {
@@ -251,18 +353,119 @@ dag()
     }
 
 
-static const Combiner&
-findcomb(const Index& K, const vector<Combiner>& combs)
+shared_ptr<const IQCombiner::RoutePlan> IQCombiner::
+routePlan(const IndexSet<IQIndex>& is, bool expand) const
     {
-    for(const Combiner& co : combs)
+    std::lock_guard<std::mutex> lock(plansMutex_);
+    for(const auto& P : plans_)
         {
-        if(K==co.right())
+        if(P->expand == expand && sameIndices(P->in,is)) return P;
+        }
+
+    auto P = make_shared<RoutePlan>();
+    P->expand = expand;
+    P->in = is;
+
+    const IQIndex& r = (do_condense ? ucright_ : right_);
+    if(expand)
+        {
+        for(const IQIndex& I : is)
             {
-            return co;
+            if(I == r) P->out.insert(P->out.end(),left_.begin(),left_.end());
+            else       P->out.push_back(I);
             }
         }
-    Error("Combiner not found");
-    return combs.front();
+    else
+        {
+        for(const IQIndex& I : is)
+            {
+            if(!hasindex(*this,I)) P->out.push_back(I);
+            }
+        P->out.push_back(r);
+        }
+
+    //Block positions follow the index order of an IQTensor
+    //with these indices
+    std::vector<IQIndex> outcopy(P->out);
+    const IQTensor proto(outcopy);
+    const IndexSet<IQIndex>& ois = proto.indices();
+
+    int j = 0;
+    for(const IQIndex& I : is)
+        {
+        P->nsec.push_back(I.nindex());
+        long ostride = 0,
+             cstride = 0;
+        if(I == r)
+            {
+            P->rInd = j;
+            }
+        else if(!expand && hasindex(*this,I))
+            {
+            cstride = 1;
+            for(const IQIndex& L : left_)
+                {
+                if(L == I) break;
+                cstride *= L.nindex();
+                }
+            }
+        else
+            {
+            ostride = sectorStride(ois,I);
+            }
+        P->outStride.push_back(ostride);
+        P->combStride.push_back(cstride);
+        ++j;
+        }
+
+    if(expand)
+        {
+        P->sectorComb = sectorComb_;
+        for(const IQIndex& L : left_)
+            {
+            P->leftSec.push_back(L.nindex());
+            P->leftStride.push_back(sectorStride(ois,L));
+            }
+        }
+    else
+        {
+        P->rStride = sectorStride(ois,r);
+        P->combSector = combSector_;
+        }
+
+    if(plans_.size() >= MaxRoutePlans) plans_.erase(plans_.begin());
+    plans_.push_back(P);
+    return P;
+    }
+
+//Applies combs[n] to each block src, writing to dest:
+//the blocks of a product (see IQCombiner::product)
+struct CombineTask
+    {
+    const ITensor* src;
+    ITensor* dest;
+    long comb;
+    };
+
+void static
+runCombineTasks(std::vector<CombineTask>& tasks,
+                const std::vector<Combiner>& combs)
+    {
+    double work = 0;
+    for(const auto& t : tasks) work += t.src->indices().dim();
+    const int nthread = (work < MinParallelWork ? 1 : Global::nthread());
+    if(nthread > 1)
+        {
+        std::stable_sort(tasks.begin(),tasks.end(),[](const CombineTask& a, const CombineTask& b)
+            {
+            return a.src->indices().dim() > b.src->indices().dim();
+            });
+        }
+    detail::parallelTasks(tasks.size(),nthread,[&tasks,&combs](long k)
+        {
+        const CombineTask& t = tasks[k];
+        combs[t.comb].product(*t.src,*t.dest);
+        });
     }
 
 void IQCombiner::
@@ -293,28 +496,25 @@ product(IQTensor T, IQTensor& res) const
                 Error("Incompatible arrow directions in operator*(IQTensor,IQCombiner).");
                 }
 
-        iqinds.reserve(T_.indices().r()-1+left_.size());
-
-        for(const IQIndex& I : T_.indices())
-            {
-            if(I == r)
-                copy(left_.begin(),left_.end(),back_inserter(iqinds));
-            else
-                iqinds.push_back(I);
-            }
+        const auto P = routePlan(T_.indices(),true);
 
+        iqinds = P->out;
         res = IQTensor(iqinds);
 
-        for(const ITensor& tt : T_.blocks())
-        for(const Index& K : tt.indices())
+        std::vector<CombineTask> tasks;
+        for(auto it = T_.blocks().begin(); it != T_.blocks().end(); ++it)
             {
-            if(hasindex(r,K))
-                { 
-                res += (findcomb(K,combs_) * tt); 
-                break;
-                }
-            } //end for
-
+            if(it->scale().sign() == 0) continue;
+            long comb = 0,
+                 outpos = 0;
+            P->route(it.pos(),comb,outpos);
+            ITensor& dest = res.d_->insert(outpos);
+#ifdef DEBUG
+            if(dest.valid()) Error("Two blocks routed to the same block in IQCombiner::product");
+#endif
+            tasks.push_back(CombineTask{&(*it),&dest,comb});
+            }
+        runCombineTasks(tasks,combs_);
         }
     else
         {
@@ -322,19 +522,6 @@ product(IQTensor T, IQTensor& res) const
         //T has left IQIndex's, combine them
         //
 
-        iqinds.reserve(T.r()-left_.size()+1);
-
-        //res will have all IQIndex's of T not in the left of c
-        for(const IQIndex& I : T.indices()) 
-            { 
-            if(!hasindex(*this,I)) iqinds.push_back(I); 
-            }
-        //and res will have c's right IQIndex
-        if(do_condense) iqinds.push_back(ucright_);
-        else            iqinds.push_back(right_);
-
-        res = IQTensor(iqinds);
-
         //Check left indices
         for(const IQIndex& I : left_)
             {
@@ -363,28 +550,38 @@ product(IQTensor T, IQTensor& res) const
                 }
             }
 
-        //Loop over each block in T and apply appropriate
-        //Combiner (determined by the uniqueReal of the 
-        //combined Indices)
-        for(const ITensor& t : T.blocks())
-            {
-            size_t pos = 0;
-            for(const Index& K : t.indices())
-                {
-                pos += indexPos(*this,K);
-                }
+        //res will have all IQIndex's of T not in the left of c,
+        //and c's right IQIndex
+        const auto P = routePlan(T.indices(),false);
 
-            if(pos >= combs_.size()) 
+        iqinds = P->out;
+        res = IQTensor(iqinds);
+
+        //Route each block in T to the appropriate Combiner
+        //and to its place in res
+        std::vector<CombineTask> tasks;
+        for(auto it = T.blocks().begin(); it != T.blocks().end(); ++it)
+            {
+            if(it->scale().sign() == 0) continue;
+            long comb = 0,
+                 outpos = 0;
+            P->route(it.pos(),comb,outpos);
+#ifdef DEBUG
+            if(comb >= long(combs_.size())) 
                 {
                 Print(*this);
                 Print(T);
-                Print(t);
-                printfln("pos=%d, combs_.size()=%d",pos,combs_.size());
-                Error("pos out of range");
+                printfln("comb=%d, combs_.size()=%d",comb,combs_.size());
+                Error("comb out of range");
                 }
-
-            res += (combs_[pos] * t);
+#endif
+            ITensor& dest = res.d_->insert(outpos);
+#ifdef DEBUG
+            if(dest.valid()) Error("Two blocks routed to the same block in IQCombiner::product");
+#endif
+            tasks.push_back(CombineTask{&(*it),&dest,comb});
             }
+        runCombineTasks(tasks,combs_);
 
         if(do_condense) 
             { 
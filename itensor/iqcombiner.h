@@ -7,6 +7,7 @@
 #include "combiner.h"
 #include "condenser.h"
 #include "qcounter.h"
+#include <mutex>
 
 namespace itensor {
 
@@ -20,6 +21,9 @@ namespace itensor {
    ---T---- ---C-- --cC---
    where cC is dag(C).  Use of IQCombiners is efficient, whereas
    use of IQTensors for this purpose would not be.
+
+   Once initted (by init() or a first product), a const IQCombiner
+   may be applied to IQTensors from several threads at once.
 */
 class IQCombiner
     {
@@ -101,6 +105,11 @@ class IQCombiner
 
     private:
 
+    //Routes the blocks of IQTensors with a given
+    //set of indices to the Combiners that apply to
+    //them and to their place in the result
+    struct RoutePlan;
+
     /////////////
     //
     // Data Members
@@ -115,9 +124,25 @@ class IQCombiner
     mutable IQIndex ucright_;
     bool do_condense;
 
+    //Sector of the (uncondensed) right index made by
+    //each Combiner, and the reverse
+    mutable std::vector<long> combSector_,
+                              sectorComb_;
+
+    //Plans for the most recently seen index sets;
+    //guarded by plansMutex_ so an initted combiner
+    //can be applied from several threads at once
+    mutable std::vector<shared_ptr<const RoutePlan>> plans_;
+    mutable std::mutex plansMutex_;
+
     //
     /////////////
 
+    //Returned by shared_ptr: the plan stays valid even if
+    //another thread evicts it from plans_
+    shared_ptr<const RoutePlan>
+    routePlan(const IndexSet<IQIndex>& is, bool expand) const;
+
     };
 
 
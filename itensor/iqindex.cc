@@ -3,6 +3,7 @@
 //    (See accompanying LICENSE file.)
 //
 #include "iqindex.h"
+#include <unordered_map>
 
 namespace itensor {
 
@@ -59,6 +60,12 @@ class IQIndexDat
     const QN&
     qn(int i) { return iq_[i-1].qn; }
 
+    int
+    position(const Index& i) const;
+
+    int
+    offset(int i) const { return offset_[i-1]; }
+
     iterator
     begin() { return iq_.begin(); }
     iterator
@@ -86,14 +93,65 @@ class IQIndexDat
 
     StorageT iq_;
 
+    //Position of each Index by id (only when there
+    //are enough Index's for hashing to beat a scan)
+    std::unordered_map<Index::IDType,int> pos_;
+
+    //Offset of each Index
+    std::vector<int> offset_;
+
     /////////////////
 
     //Disallow copying using =
     void 
     operator=(const IQIndexDat&);
 
+    void
+    makeTables();
+
     };
 
+//Least number of Index's for which
+//IQIndexDat::position uses a hash table
+const size_t MinHashedIndices = 8;
+
+void IQIndexDat::
+makeTables()
+    {
+    pos_.clear();
+    offset_.resize(iq_.size());
+    int os = 0;
+    for(size_t j = 0; j < iq_.size(); ++j)
+        {
+        offset_[j] = os;
+        os += iq_[j].m();
+        }
+    if(iq_.size() < MinHashedIndices) return;
+    pos_.reserve(iq_.size());
+    for(size_t j = 0; j < iq_.size(); ++j)
+        {
+        pos_.emplace(iq_[j].rawId(),int(j+1));
+        }
+    }
+
+int IQIndexDat::
+position(const Index& i) const
+    {
+    if(!pos_.empty())
+        {
+        auto it = pos_.find(i.rawId());
+        if(it == pos_.end()) return 0;
+        //Priming changes all Index's of an IQIndex 
+        //together, so the prime levels nearly always agree
+        if(iq_[it->second-1] == i) return it->second;
+        }
+    for(size_t j = 0; j < iq_.size(); ++j)
+        {
+        if(iq_[j] == i) return int(j+1);
+        }
+    return 0;
+    }
+
 IQIndexDat::
 IQIndexDat(const Index& i1, const QN& q1,
            const Index& i2, const QN& q2,
@@ -119,18 +177,22 @@ IQIndexDat(const Index& i1, const QN& q1,
         iq_.push_back(IndexQN(i7,q7));
     if(i8 != Index::Null())
         iq_.push_back(IndexQN(i8,q8));
+    makeTables();
     }
 
 IQIndexDat::
 IQIndexDat(StorageT& ind_qn)
     { 
     iq_.swap(ind_qn); 
+    makeTables();
     }
 
 void IQIndexDat::
 makeCopyOf(const IQIndexDat& other) 
     { 
     iq_ = other.iq_;
+    pos_ = other.pos_;
+    offset_ = other.offset_;
     }
 
 IQIndexDat::
@@ -157,6 +219,7 @@ read(istream& s)
         { 
         x.read(s); 
         }
+    makeTables();
     }
 
 const IQIndexDatPtr& IQIndexDat::
@@ -235,6 +298,28 @@ qn(int i) const
     return pd->qn(i);
     }
 
+int IQIndex::
+position(const Index& i) const
+    {
+    IQINDEX_CHECK_NULL
+    return pd->position(i);
+    }
+
+int IQIndex::
+offset(int i) const
+    {
+    IQINDEX_CHECK_NULL
+#ifdef DEBUG
+    if(i < 1 || i > nindex())
+        {
+        Print(nindex());
+        Print(i);
+        Error("IQIndex::offset arg out of range");
+        }
+#endif
+    return pd->offset(i);
+    }
+
 IQIndex::
 IQIndex() 
     : 
@@ -531,13 +616,19 @@ Null()
 void
 calc_ind_ii(const IQIndexVal& iv, int& j, int& ii)
     {
-    j = 1;
-    ii = iv.i;
-    while(ii > iv.index.index(j).m())
+    //Binary search for the last Index whose
+    //offset is below iv.i
+    const IQIndex& I = iv.index;
+    int lo = 1,
+        hi = I.nindex();
+    while(lo < hi)
         {
-        ii -= iv.index.index(j).m();
-        ++j;
+        const int mid = (lo+hi+1)/2;
+        if(I.offset(mid) < iv.i) lo = mid;
+        else                     hi = mid-1;
         }
+    j = lo;
+    ii = iv.i-I.offset(j);
     }
 
 
@@ -656,32 +747,20 @@ operator()(int n) const
 bool
 hasindex(const IQIndex& J, const Index& i)
     { 
-    for(const Index& j : J.indices())
-        {
-        if(j == i) return true;
-        }
-    return false;
+    return J.position(i) != 0;
     }
 
 int
 findindex(const IQIndex& J, const Index& i)
     { 
-    for(int j = 1; j <= J.nindex(); ++j)
-        {
-        if(J.index(j) == i) return j;
-        }
-    return 0;
+    return J.position(i);
     }
 
 int
 offset(const IQIndex& I, const Index& i)
     {
-    int os = 0;
-    for(const IndexQN& iq : I.indices())
-        {
-        if(iq == i) return os;
-        os += iq.m();
-        }
+    const int j = I.position(i);
+    if(j != 0) return I.offset(j);
     Print(I);
     Print(i);
     Error("Index not contained in IQIndex");
@@ -691,11 +770,8 @@ offset(const IQIndex& I, const Index& i)
 QN
 qn(const IQIndex& I, const Index& i)
     { 
-    for(const IndexQN& jq : I.indices())
-        { 
-        if(jq == i) 
-            return jq.qn; 
-        }
+    const int j = I.position(i);
+    if(j != 0) return I.qn(j);
     cout << I << "\n";
     cout << "i = " << i << endl;
     Error("IQIndex does not contain given index.");
@@ -94,6 +94,16 @@ class IQIndex : public Index
     const QN& 
     qn(int i) const;
 
+    //Number (1-based) of Index i among the Index's 
+    //of this IQIndex, or 0 if i is not one of them
+    int
+    position(const Index& i) const;
+
+    //Offset of the i'th Index (1-based) within this
+    //IQIndex: the sum of the m's of the ones before it
+    int
+    offset(int i) const;
+
     Arrow 
     dir() const { return dir_; }
     void 
@@ -5,35 +5,145 @@
 #ifndef __ITENSOR_IQTDAT_H
 #define __ITENSOR_IQTDAT_H
 
-#include "detail/skip_iterator.h"
+#include <map>
+#include <iterator>
 
 namespace itensor {
 
-struct ITValidCheck;
+//
+// IQTDatIterator
+//
+// Visits the valid blocks held by an IQTDat,
+// in order of their position in the IQTensor
+//
+template<typename MapIter,
+         typename BlockT>
+class IQTDatIterator
+    {
+    public:
+
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = ITensor;
+    using difference_type = std::ptrdiff_t;
+    using reference = BlockT&;
+    using pointer = BlockT*;
+
+    IQTDatIterator() { }
+
+    IQTDatIterator(MapIter curr, MapIter end)
+        :
+        curr_(curr),
+        end_(end)
+        {
+        skipInvalid();
+        }
+
+    //Convert an iterator to a const_iterator
+    template<typename Iter, typename B>
+    IQTDatIterator(const IQTDatIterator<Iter,B>& x)
+        :
+        curr_(x.curr_),
+        end_(x.end_)
+        { }
+
+    reference
+    operator*() const { return curr_->second; }
+
+    pointer
+    operator->() const { return &(curr_->second); }
+
+    //Position of the current block (see IQTDat)
+    long
+    pos() const { return curr_->first; }
+
+    IQTDatIterator&
+    operator++()
+        {
+        ++curr_;
+        skipInvalid();
+        return *this;
+        }
+
+    IQTDatIterator
+    operator++(int)
+        {
+        IQTDatIterator save(*this);
+        operator++();
+        return save;
+        }
+
+    bool
+    operator==(const IQTDatIterator& x) const { return curr_ == x.curr_; }
+
+    bool
+    operator!=(const IQTDatIterator& x) const { return curr_ != x.curr_; }
+
+    private:
+
+    MapIter curr_,
+            end_;
+
+    void
+    skipInvalid()
+        {
+        while(curr_ != end_ && !curr_->second.valid()) ++curr_;
+        }
+
+    template<typename Iter, typename B>
+    friend class IQTDatIterator;
+    };
 
 //
 // IQTDat: storage for IQTensor
 //
+// Only blocks which are present are stored, keyed by
+// their position: the sector numbers of the block's
+// indices, combined in mixed radix with the sector
+// number of the first IQIndex varying fastest.
+//
+// The data of real blocks can be packed into one buffer,
+// in order of position, with a table of the offset of
+// each block into it (see pack). Norms, dot products and
+// sums of IQTensors with packed data then make one pass
+// over the buffer. Blocks stay ordinary ITensors: one 
+// which is modified is copied out of the buffer, after
+// which the data is no longer packed.
+//
 
 class IQTDat
     {
     public:
 
-    using Storage = std::vector<ITensor>;
+    using Storage = std::map<long,ITensor>;
 
-    using const_iterator = detail::SkipIterator<Storage::const_iterator,ITValidCheck>;
+    using const_iterator = IQTDatIterator<Storage::const_iterator,const ITensor>;
 
-    using iterator = detail::SkipIterator<Storage::iterator,ITValidCheck>;
+    using iterator = IQTDatIterator<Storage::iterator,ITensor>;
 
     IQTDat() { }
 
-    IQTDat(size_t size) : blocks_(size) { }
-
+    //Block at position pos, adding a null
+    //ITensor in its place if not present
     ITensor&
-    at(size_t n) { return blocks_.at(n); }
+    insert(long pos) { return blocks_[pos]; }
+
+    //Block at position pos, or nullptr
+    //if not present (never adds a block)
+    ITensor*
+    find(long pos)
+        {
+        auto it = blocks_.find(pos);
+        return (it == blocks_.end() ? nullptr : &(it->second));
+        }
 
+    //Block at position pos, or a null
+    //ITensor if not present
     const ITensor&
-    at(size_t n) const { return blocks_.at(n); }
+    at(long pos) const
+        {
+        auto it = blocks_.find(pos);
+        return (it == blocks_.end() ? nullBlock() : it->second);
+        }
 
     const_iterator
     begin() const { return const_iterator(blocks_.begin(),blocks_.end()); }
@@ -51,45 +161,65 @@ class IQTDat
     cend() const { return const_iterator(blocks_.end(),blocks_.end()); }
 
     int
-    maxSize() const { return blocks_.size(); }
-
-    int
-    size() const 
-        { 
+    size() const
+        {
         int sz = 0;
-        for(const ITensor& t : blocks_)
+        for(const auto& b : blocks_)
             {
-            if(t.valid()) ++sz;
+            if(b.second.valid()) ++sz;
             }
         return sz;
         }
 
     bool
-    empty() const 
-        { 
-        for(const ITensor& t : blocks_)
-            {
-            if(t.valid()) return false;
-            }
-        return true;
-        }
+    empty() const { return begin() == end(); }
 
     void
-    clear() 
-        { 
-        for(ITensor& t : blocks_)
-            {
-            if(t.valid()) t = ITensor();
-            }
-        }
+    clear() { blocks_.clear(); unpack(); }
 
+    //Moves the data of the blocks into one buffer, if all
+    //blocks are real, dense and double precision. Uses the
+    //buffer the data already lies in if it is in order in
+    //one (as after read), else copies it.
     void
-    swap(Storage& new_blocks) { blocks_.swap(new_blocks); }
+    pack();
+
+    //True if the data of the blocks lies in buffer(), 
+    //in order of position, at the offsets of offsets()
+    bool
+    packed() const;
 
-    void 
+    //Offset into buffer() of the data of each block in
+    //order of position, then the end of the last block
+    const std::vector<size_t>&
+    offsets() const { return offsets_; }
+
+    const ITDat::Buffer&
+    buffer() const { return buf_; }
+
+    //True if both are packed with the same blocks (positions,
+    //index order and sizes), so that their buffers can be 
+    //combined element by element
+    bool
+    sameLayout(const IQTDat& other) const;
+
+    //Sum over the blocks of the scaled dot products of the
+    //data of this and other, which must have the same layout
+    Real
+    dot(const IQTDat& other) const;
+
+    //Adds the data of other (which must have the same layout) to
+    //that of this, rescaled to the scales of the blocks of this. 
+    //Writes in place unless the buffer is shared, else into a new 
+    //one. Returns false, changing nothing, if a block of this has 
+    //a zero scale.
+    bool
+    addPacked(const IQTDat& other);
+
+    void
     read(std::istream& s);
 
-    void 
+    void
     write(std::ostream& s) const;
 
     static const shared_ptr<IQTDat>&
@@ -101,50 +231,187 @@ class IQTDat
 
     Storage blocks_;
 
+    ITDat::Buffer buf_;
+    std::vector<size_t> offsets_;
+
     //////////////
 
-    Storage&
-    store() { return blocks_; }
-    const Storage&
-    store() const { return blocks_; }
+    void
+    unpack() { buf_.reset(); offsets_.clear(); }
+
+    //Makes the data of t the size elements of buf at offset.
+    //Returns false, leaving t unchanged, unless t is real,
+    //dense and double precision with data of that size.
+    static bool
+    moveInto(ITensor& t,
+             const ITDat::Buffer& buf,
+             size_t offset,
+             size_t size);
+
+    static const ITensor&
+    nullBlock()
+        {
+        static const ITensor null_;
+        return null_;
+        }
+
+    //Written in place of the number of blocks to mark the
+    //current format (positions of the valid blocks, then the
+    //blocks in the format of writeBlocks); older files hold
+    //one block for every position
+    static const size_t SparseFormat = ~size_t(0);
 
     friend class IQTensor;
 
     }; //class IQTDat
 
-struct ITValidCheck
+bool inline IQTDat::
+moveInto(ITensor& t,
+         const ITDat::Buffer& buf,
+         size_t offset,
+         size_t size)
     {
-    bool
-    operator()(const IQTDat::Storage::const_iterator& it)
+    if(t.type() != ITensor::Dense || t.isComplex() 
+       || t.r_->isSingle() || t.r_->size() != size) 
         {
-        return !it->valid();
+        return false;
         }
-    };
+    std::copy(t.r_->data(),t.r_->data()+size,buf->data()+offset);
+    t.r_ = std::make_shared<ITDat>(buf,offset,size);
+    return true;
+    }
+
+bool inline IQTDat::
+packed() const
+    {
+    if(!buf_) return false;
+    size_t n = 0;
+    for(const ITensor& t : *this)
+        {
+        if(n+1 >= offsets_.size() 
+           || t.isComplex()
+           || t.r_->size() != offsets_[n+1]-offsets_[n]
+           || !t.r_->views(buf_,offsets_[n])) 
+            {
+            return false;
+            }
+        ++n;
+        }
+    return n+1 == offsets_.size();
+    }
+
+void inline IQTDat::
+pack()
+    {
+    if(packed()) return;
+    unpack();
+    std::vector<size_t> offsets;
+    size_t total = 0;
+    for(const ITensor& t : *this)
+        {
+        if(t.type() != ITensor::Dense || t.isComplex() || t.r_->isSingle()) return;
+        offsets.push_back(total);
+        total += t.r_->size();
+        }
+    if(offsets.empty()) return;
+    offsets.push_back(total);
+
+    //Data already in order in one buffer
+    const ITDat& first = *(begin()->r_);
+    if(first.isView())
+        {
+        const size_t start = first.offset();
+        bool inorder = true;
+        size_t n = 0;
+        for(const ITensor& t : *this)
+            {
+            inorder = inorder && t.r_->views(first.buffer(),start+offsets[n++]);
+            }
+        if(inorder)
+            {
+            buf_ = first.buffer();
+            for(auto& o : offsets) o += start;
+            offsets_.swap(offsets);
+            return;
+            }
+        }
+
+    auto buf = std::make_shared<ITDat::Storage>(total);
+    size_t n = 0;
+    for(ITensor& t : *this) 
+        {
+        moveInto(t,buf,offsets[n],offsets[n+1]-offsets[n]);
+        ++n;
+        }
+    buf_ = buf;
+    offsets_.swap(offsets);
+    }
+
+bool inline IQTDat::
+sameLayout(const IQTDat& other) const
+    {
+    if(offsets_ != other.offsets_ || !packed() || !other.packed()) return false;
+    for(auto i = begin(), j = other.begin(); i != end(); ++i, ++j)
+        {
+        if(i.pos() != j.pos()) return false;
+        const IndexSet<Index>& is = i->indices();
+        const IndexSet<Index>& js = j->indices();
+        if(is.r() != js.r()) return false;
+        for(int k = 0; k < is.r(); ++k)
+            {
+            if(is[k] != js[k]) return false;
+            }
+        }
+    return true;
+    }
 
 void inline IQTDat::
 read(std::istream& s)
     {
+    blocks_.clear();
+    unpack();
     size_t sz = 0;
     s.read((char*) &sz,sizeof(sz));
-    blocks_.resize(sz);
-    for(ITensor& t : blocks_)
+    if(sz == SparseFormat)
         {
+        s.read((char*) &sz,sizeof(sz));
+        std::vector<long> pos(sz);
+        s.read((char*) pos.data(),sizeof(long)*sz);
+        auto blocks = readBlocks(s);
+        for(size_t n = 0; n < sz; ++n)
+            {
+            blocks_[pos[n]].swap(blocks.at(n));
+            }
+        //The blocks were read into one buffer in order
+        pack();
+        return;
+        }
+    for(size_t n = 0; n < sz; ++n)
+        {
+        ITensor t;
         t.read(s);
+        if(t.valid()) blocks_[n].swap(t);
         }
     }
 
 void inline IQTDat::
 write(std::ostream& s) const
     {
-    size_t sz = blocks_.size();
+    size_t sz = SparseFormat;
     s.write((char*) &sz,sizeof(sz));
-    for(const ITensor& t : blocks_)
+    std::vector<long> pos;
+    std::vector<const ITensor*> blocks;
+    for(auto it = begin(); it != end(); ++it)
         {
-        t.write(s);
+        pos.push_back(it.pos());
+        blocks.push_back(&(*it));
         }
+    sz = pos.size();
+    s.write((char*) &sz,sizeof(sz));
+    s.write((char*) pos.data(),sizeof(long)*sz);
+    writeBlocks(s,blocks);
     }
 
-
 inline
 const shared_ptr<IQTDat>& IQTDat::
 Null()
@@ -4,7 +4,11 @@
 //
 #include "iqtensor.h"
 #include "qcounter.h"
+#include "lapack_wrap.h"
+#include "detail/parallel.h"
 #include <algorithm>
+#include <atomic>
+#include <unordered_map>
 
 namespace itensor {
 
@@ -25,41 +29,27 @@ insertAdd(ITensor& lhs, const ITensor& rhs)
     else             lhs += rhs;
     }
 
-int static
-indPos(const Index& i,
-       const IQIndex& J)
-    {
-    for(int j = 0; j < J.nindex(); ++j)
-        {
-        if(J[j] == i) return j;
-        }
-    return -1;
-    }
-
 // Determine the position of a given block (specified by an IndexSet<Index>, 
 // which could be from an ITensor or a set of IQIndexVals)
 // in the storage of an IQTensor (specified by an IndexSet<IQIndex>)
-int static
+long static
 blockPos(const IndexSet<Index>& is,
          const IndexSet<IQIndex>& qs)
     {
-    int pos = 0;
-    int dim = 1;
+    long pos = 0;
+    long dim = 1;
 
     for(const IQIndex& J : qs)
         {
-        bool found = false;
+        int j = 0;
         for(const Index& i : is)
             {
-            if(hasindex(J,i))
-                {
-                pos += dim*indPos(i,J);
-                dim *= J.nindex();
-                found = true;
-                break;
-                }
+            j = J.position(i);
+            if(j != 0) break;
             }
-        if(!found) throw ITError("Index not found in IndexSet<IQIndex>");
+        if(j == 0) throw ITError("Index not found in IndexSet<IQIndex>");
+        pos += dim*(j-1);
+        dim *= J.nindex();
         }
 
     return pos;
@@ -101,12 +91,7 @@ empty() const { return d_->empty(); }
 void IQTensor::
 allocate()
     {
-    int dim = 1;
-    for(const IQIndex& I : this->indices())
-        {
-        dim *= I.nindex();
-        }
-    d_ = make_shared<Storage>(dim);
+    d_ = make_shared<Storage>();
     }
 
 
@@ -127,7 +112,7 @@ IQTensor::
 IQTensor(const IQIndex& i1) 
     : 
     is_(i1),
-    d_(make_shared<Storage>(i1.nindex()))
+    d_(make_shared<Storage>())
     { 
     }
 
@@ -135,7 +120,7 @@ IQTensor::
 IQTensor(const IQIndex& i1,const IQIndex& i2) 
     : 
     is_(i1,i2),
-    d_(make_shared<Storage>(i1.nindex()*i2.nindex()))
+    d_(make_shared<Storage>())
     { 
     }
 
@@ -213,7 +198,7 @@ IQTensor::
 IQTensor(const IQIndexVal& iv1) 
     : 
     is_(iv1.index),
-    d_(make_shared<Storage>(iv1.index.nindex()))
+    d_(make_shared<Storage>())
 	{ 
 	operator()(iv1) = 1;
 	}
@@ -222,7 +207,7 @@ IQTensor::
 IQTensor(const IQIndexVal& iv1, const IQIndexVal& iv2) 
 	: 
     is_(iv1.index,iv2.index),
-    d_(make_shared<Storage>(iv1.index.nindex()*iv2.index.nindex()))
+    d_(make_shared<Storage>())
 	{ 
     operator()(iv1,iv2) = 1;
 	}
@@ -549,6 +534,29 @@ normLogNum() const
     //Add sum of squares of the block norms with exp(2*maxLogNum) scaled out, 
     //using lognorm as a temporary
     Real lognorm = 0;
+    if(d_->packed())
+        {
+        //One pass over the data of all blocks, one 
+        //call for each run of blocks of equal scale
+        const Real* p = d_->buffer()->data();
+        const auto& off = d_->offsets();
+        auto it = d_->begin();
+        for(size_t n = 0; n+1 < off.size(); )
+            {
+            const LogNumber& sc = it->scale();
+            size_t m = n+1;
+            auto jt = it;
+            for(++jt; m+1 < off.size() && jt->scale() == sc; ++jt) ++m;
+            if(sc.sign() != 0)
+                {
+                const long len = off[m]-off[n];
+                lognorm += exp(2*(sc.logNum()-maxLogNum))*ddot_wrapper(len,p+off[n],1,p+off[n],1);
+                }
+            n = m;
+            it = jt;
+            }
+        }
+    else
     for(const ITensor& t : *d_)
         { 
         if(t.scale().sign() != 0)
@@ -648,7 +656,7 @@ clean(Real min_norm)
 
 
 void IQTensor::
-tieIndices(const array<IQIndex,NMAX>& indices, 
+tieIndices(const IndexSet<IQIndex>::Storage& indices, 
            int niqind, 
            const IQIndex& tied)
     {
@@ -693,7 +701,7 @@ tieIndices(const array<IQIndex,NMAX>& indices,
     prevdat.swap(d_);
     allocate();
 
-    array<Index,NMAX> totie;
+    IndexSet<Index>::Storage totie(niqind);
     for(int i = 1; i <= nindex; ++i)
         {
         for(int n = 0; n < niqind; ++n)
@@ -723,22 +731,18 @@ tieIndices(const array<IQIndex,NMAX>& indices,
 void IQTensor::
 tieIndices(const IQIndex& i1, const IQIndex& i2, const IQIndex& tied)
     {
-    array<IQIndex,NMAX> inds =
-        {{ i1, i2, 
-           IQIndex::Null(), IQIndex::Null(), 
-           IQIndex::Null(), IQIndex::Null(), 
-           IQIndex::Null(), IQIndex::Null() }};
+    const IndexSet<IQIndex>::Storage inds = { i1, i2 };
 
     tieIndices(inds,2,tied);
     }
 
 IQTensor& IQTensor::
-trace(const array<IQIndex,NMAX>& indices, int niqind)
+trace(const IndexSet<IQIndex>::Storage& indices, int niqind)
     {
     if(niqind < 0)
         {
         niqind = 0;
-        while(indices[niqind] != IQIndex::Null()) ++niqind;
+        while(niqind < int(indices.size()) && indices[niqind] != IQIndex::Null()) ++niqind;
         }
 
     if(niqind < 1) Error("No IQIndices to trace");
@@ -785,7 +789,7 @@ trace(const array<IQIndex,NMAX>& indices, int niqind)
     prevdat.swap(d_);
     allocate();
 
-    array<Index,NMAX> totrace;
+    IndexSet<Index>::Storage totrace(niqind);
     for(int i = 1; i <= nindex; ++i)
         {
         for(int n = 0; n < niqind; ++n)
@@ -823,8 +827,8 @@ trace(const IQIndex& i1, const IQIndex& i2,
       const IQIndex& i5, const IQIndex& i6,
       const IQIndex& i7, const IQIndex& i8)
     {
-    array<IQIndex,NMAX> inds = {{ i1, i2, i3, i4,
-                                i5, i6, i7, i8 }};
+    const IndexSet<IQIndex>::Storage inds = { i1, i2, i3, i4,
+                                              i5, i6, i7, i8 };
     trace(inds);
     return *this;
     }
@@ -949,12 +953,12 @@ operator<<(std::ostream & s, const IQTensor& T)
     }
 
 int
-dot_(const array<const int*,NMAX>& i,
-     const array<int,NMAX>&  L)
+dot_(const SmallVector<const int*,NMAX>& i,
+     const SmallVector<int,NMAX>&  L)
     {
     int d = 0;
-    array<const int*,NMAX>::const_iterator it = i.begin();
-    array<int,NMAX>::const_iterator  Lt = L.begin();
+    auto it = i.begin();
+    auto Lt = L.begin();
     for(; Lt != L.end(); ++Lt,++it)
         {
         d += (*(*it)) * (*Lt);
@@ -967,16 +971,117 @@ dot_(const array<const int*,NMAX>& i,
 
 struct BlockInfo
     {
-    int u, //"partial index" associated with uncontracted indices
-        c, //"partial index" associated with contracted indices
-        p; //position of block in storage
+    long u, //"partial index" associated with uncontracted indices
+         c, //"partial index" associated with contracted indices
+         cm; //dimension of the contracted indices of the block
+    const ITensor* b; //the block
 
-    BlockInfo(int n) : u(0),c(0),p(n) { }
+    BlockInfo(const ITensor& t) : u(0),c(0),cm(1),b(&t) { }
     };
 std::ostream&
 operator<<(std::ostream& s, BlockInfo nfo)
     {
-    return s << "(" << nfo.u << "," << nfo.c << "," << nfo.p << ")";
+    return s << "(" << nfo.u << "," << nfo.c << ")";
+    }
+
+//If all blocks of L and R are real, dense and double
+//precision (and so will be the blocks of their product),
+//returns a buffer for the data of the blocks of the product,
+//out, laid out in order of position: sets the offset of each
+//from its size. Else returns null.
+template<typename OutBlockT>
+ITDat::Buffer static
+resultBuffer(const IQTDat& L,
+             const IQTDat& R,
+             vector<OutBlockT>& out)
+    {
+    if(out.empty()) return ITDat::Buffer();
+    for(const IQTDat* D : {&L,&R})
+    for(const ITensor& t : *D)
+        {
+        if(t.type() != ITensor::Dense || t.isComplex() || t.isSinglePrecision())
+            return ITDat::Buffer();
+        }
+    vector<OutBlockT*> bypos(out.size());
+    for(size_t k = 0; k < out.size(); ++k) bypos[k] = &out[k];
+    std::sort(bypos.begin(),bypos.end(),
+              [](const OutBlockT* a, const OutBlockT* b) { return a->pos < b->pos; });
+    size_t total = 0;
+    for(OutBlockT* O : bypos)
+        {
+        O->offset = total;
+        total += O->size;
+        }
+    return std::make_shared<ITDat::Storage>(total);
+    }
+
+std::atomic<long> static iq_contractions(0),
+                         iq_block_pairs(0),
+                         iq_block_products(0),
+                         iq_block_batched(0);
+
+#ifdef PLATFORM_mkl
+std::atomic<bool> static batch_products(true);
+#else
+std::atomic<bool> static batch_products(false);
+#endif
+
+void
+batchBlockProducts(bool on)
+    {
+    batch_products = on;
+    }
+
+IQContractionStats
+iqContractionStats()
+    {
+    IQContractionStats stats;
+    stats.contractions = iq_contractions;
+    stats.pairs = iq_block_pairs;
+    stats.products = iq_block_products;
+    stats.batched = iq_block_batched;
+    return stats;
+    }
+
+void
+clearIQContractionStats()
+    {
+    iq_contractions = 0;
+    iq_block_pairs = 0;
+    iq_block_products = 0;
+    iq_block_batched = 0;
+    }
+
+//Estimated work (multiply-adds) below which the block
+//products of one IQTensor product are done serially
+const double MinParallelWork = 1E6;
+
+//
+// Calls f(k) for each of ntask tasks, concurrently using
+// Global::nthread() threads if the total work is large
+// enough. Each task runs BLAS on a single thread (with
+// MKL or OpenBLAS, see SerialBlasScope), and tensor 
+// kernels it calls run serially. An exception thrown by
+// a task is rethrown here.
+//
+template<typename Func>
+void static
+runBlockTasks(long ntask, 
+              double work, 
+              Func&& f)
+    {
+    const int nthread = (work < MinParallelWork ? 1 : Global::nthread());
+    if(nthread <= 1 || ntask < 2)
+        {
+        for(long k = 0; k < ntask; ++k) f(k);
+        return;
+        }
+    SerialBlasScope serial;
+    detail::parallelTasks(ntask,nthread,[&f](long k)
+        {
+        SerialBlasScope serial;
+        f(k);
+        });
     }
 
 IQTensor& IQTensor::
@@ -995,19 +1100,15 @@ operator*=(const IQTensor& other)
     if(!other)
         Error("Multiplying by null IQTensor");
 
-    array<bool,NMAX> contractedL,
-                     contractedR;
-    contractedL.fill(false);
-    contractedR.fill(false);
+    SmallVector<bool,NMAX> contractedL(is_.r(),false),
+                           contractedR(other.is_.r(),false);
 
     //cdL/R is "contracted dimensions": weights/shapes 
     //of indices enumerating the contracted indices
-    array<int,NMAX> cdL,
-                    cdR;
-    cdL.fill(-1000);
-    cdR.fill(-1000);
+    SmallVector<long,NMAX> cdL(is_.r(),-1000),
+                           cdR(other.is_.r(),-1000);
 
-    for(int i = 0, cdim = 1; i < is_.rn(); ++i)
+    for(long i = 0, cdim = 1; i < is_.rn(); ++i)
         {
         const IQIndex& I = is_[i];
         for(int j = 0; j < other.is_.rn(); ++j)
@@ -1056,22 +1157,19 @@ operator*=(const IQTensor& other)
         }
 
     //Load newindex with those IQIndex's *not* common to *this and other
-    array<IQIndex,NMAX> newindex;
+    IndexSet<IQIndex>::Storage newindex(is_.r()+other.is_.r());
     int nnew = 0; //number of indices of product
-    int nsize = 1; //size of storage for product
 
     //ud is "uncontracted dimensions": weights/shapes 
     //of indices enumerating the uncontracted indices
-    array<int,NMAX> ud;
-    ud.fill(-1000);
-    int udim = 1; //accumulates products of dims of uncontracted indices
+    SmallVector<long,NMAX> ud(is_.r()+other.is_.r(),-1000);
+    long udim = 1; //accumulates products of dims of uncontracted indices
 
     for(int i = 0; i < is_.rn(); ++i)
         if(!contractedL[i])
             {
             const IQIndex& I = is_[i];
             newindex[nnew] = I;
-            nsize *= I.nindex();
             ud[nnew] = udim;
             udim *= I.nindex();
             ++nnew;
@@ -1085,7 +1183,6 @@ operator*=(const IQTensor& other)
             {
             const IQIndex& J = other.is_[j];
             newindex[nnew] = J;
-            nsize *= J.nindex();
             ud[nnew] = udim;
             udim *= J.nindex();
             ++nnew;
@@ -1106,50 +1203,168 @@ operator*=(const IQTensor& other)
 
 
     IndexSet<IQIndex> nis(newindex,nnew,0);
-    IQTDatPtr ndat = make_shared<IQTDat>(nsize);
+    IQTDatPtr ndat = make_shared<IQTDat>();
 
-    const IQTDat::Storage& L = d_->store();
-    const IQTDat::Storage& R = other.d_->store();
-    IQTDat::Storage& N = ndat->store();
+    const IQTDat& L = *d_;
+    const IQTDat& R = *(other.d_);
+    IQTDat& N = *ndat;
 
-    vector<BlockInfo> Lb;
+    //Blocks of L grouped by their contracted sectors (l.c),
+    //so that each block of R only visits its partners
+    std::unordered_map<long,vector<BlockInfo>> Lb;
+    long nL = 0;
 
-    for(size_t p = 0; p < L.size(); ++p)
+    for(auto it = L.begin(); it != L.end(); ++it)
         {
-        if(!L[p].valid()) continue;
-
-        BlockInfo l(p);
-        for(int n = 0, j = p, nu = 0; n < is_.rn(); ++n)
+        BlockInfo l(*it);
+        long j = it.pos();
+        for(int n = 0, nu = 0; n < is_.rn(); ++n)
             {
-            const int N = is_[n].nindex();
-            const int i = j%N;
+            const long N = is_[n].nindex();
+            const long i = j%N;
             j /= N;
-            if(contractedL[n]) l.c += i*cdL[n];
-            else               l.u += i*ud[nu++];
+            if(contractedL[n]) 
+                {
+                l.c += i*cdL[n];
+                l.cm *= is_[n].index(i+1).m();
+                }
+            else
+                {
+                l.u += i*ud[nu++];
+                }
             }
-        Lb.push_back(l);
-        }
-
-    for(size_t p = 0; p < R.size(); ++p)
-        {
-        if(!R[p].valid()) continue;
-
-        BlockInfo r(p);
-        for(int n = 0, j = p, nu = nucL; n < other.is_.rn(); ++n)
+        Lb[l.c].push_back(l);
+        ++nL;
+        }
+
+    //Products to do grouped by the block of the result 
+    //they add to, each group making one task, so that 
+    //tasks never write to the same block
+    struct OutBlock
+        {
+        long pos = 0;
+        double work = 0;
+        vector<std::pair<const ITensor*,const ITensor*>> prods;
+        vector<double> pwork;
+        ITensor res;
+        size_t size = 0,
+               offset = 0;
+        };
+    vector<OutBlock> out;
+    std::unordered_map<long,size_t> outnum;
+    double work = 0;
+
+    long nR = 0,
+         nprod = 0,
+         nbatched = 0;
+
+    for(auto it = R.begin(); it != R.end(); ++it)
+        {
+        BlockInfo r(*it);
+        long j = it.pos();
+        for(int n = 0, nu = nucL; n < other.is_.rn(); ++n)
             {
-            const int N = other.is_[n].nindex();
-            const int i = j%N;
+            const long N = other.is_[n].nindex();
+            const long i = j%N;
             j /= N;
             if(contractedR[n]) r.c += i*cdR[n];
             else               r.u += i*ud[nu++];
             }
 
-        for(const BlockInfo& l : Lb)
+        ++nR;
+        auto match = Lb.find(r.c);
+        if(match == Lb.end()) continue;
+        for(const BlockInfo& l : match->second)
+            {
+            const long pos = l.u+r.u;
+            auto ins = outnum.emplace(pos,out.size());
+            if(ins.second) 
+                {
+                out.emplace_back();
+                out.back().pos = pos;
+                out.back().size = (l.b->indices().dim()/l.cm)*(r.b->indices().dim()/l.cm);
+                }
+            OutBlock& O = out[ins.first->second];
+            O.prods.emplace_back(l.b,r.b);
+            const double w = double(l.b->indices().dim())*r.b->indices().dim()/l.cm;
+            O.pwork.push_back(w);
+            O.work += w;
+            work += w;
+            ++nprod;
+            }
+        }
+
+    //Each task moves its block into place in one buffer
+    //(see resultBuffer)
+    const ITDat::Buffer buf = resultBuffer(L,R,out);
+    std::atomic<bool> packed{bool(buf)};
+    auto place = [&buf,&packed](OutBlock& O)
+        {
+        if(buf && !IQTDat::moveInto(O.res,buf,O.offset,O.size)) packed = false;
+        };
+
+    //Real products which need no permuting are batched by
+    //shape (see batchBlockProducts), each added to its block
+    //as soon as its group is made; the other products are
+    //made by the tasks below
+    if(batch_products)
+        {
+        vector<std::pair<const ITensor*,const ITensor*>> prods;
+        vector<OutBlock*> dest;
+        vector<double> pwork;
+        prods.reserve(nprod);
+        dest.reserve(nprod);
+        pwork.reserve(nprod);
+        for(OutBlock& O : out)
             {
-            if(l.c == r.c) insertAdd(N[l.u+r.u],L[l.p] * R[r.p]);
+            prods.insert(prods.end(),O.prods.begin(),O.prods.end());
+            dest.insert(dest.end(),O.prods.size(),&O);
+            pwork.insert(pwork.end(),O.pwork.begin(),O.pwork.end());
+            O.prods.clear();
+            O.pwork.clear();
+            O.work = 0;
+            }
+        const vector<bool> batched = multiplyBatch(prods,[&dest](size_t n, ITensor& T)
+            {
+            insertAdd(dest[n]->res,T);
+            });
+        work = 0;
+        for(size_t n = 0; n < prods.size(); ++n)
+            {
+            if(batched[n])
+                {
+                ++nbatched;
+                continue;
+                }
+            OutBlock& O = *dest[n];
+            O.prods.push_back(prods[n]);
+            O.pwork.push_back(pwork[n]);
+            O.work += pwork[n];
+            work += pwork[n];
             }
         }
 
+    //Start the largest blocks first
+    vector<OutBlock*> order(out.size());
+    for(size_t k = 0; k < out.size(); ++k) order[k] = &out[k];
+    std::stable_sort(order.begin(),order.end(),
+                     [](const OutBlock* a, const OutBlock* b) { return a->work > b->work; });
+
+    runBlockTasks(order.size(),work,[&order,&place](long k)
+        {
+        OutBlock& O = *order[k];
+        for(const auto& p : O.prods) insertAdd(O.res,(*p.first) * (*p.second));
+        place(O);
+        });
+
+    for(OutBlock& O : out) N.insert(O.pos).swap(O.res);
+    if(packed) N.pack();
+
+    ++iq_contractions;
+    iq_block_pairs += nL*nR;
+    iq_block_products += nprod;
+    iq_block_batched += nbatched;
+
     is_.swap(nis);
     d_.swap(ndat);
     
@@ -1173,21 +1388,14 @@ operator/=(const IQTensor& other)
     if(!other)
         Error("Multiplying by null IQTensor");
 
-    Counter u;
-
-    const int zero = 0;
-
-    array<const int*,NMAX> li,ri;
-    for(size_t n = 0; n < li.size(); ++n)
-        {
-        li[n] = &zero;
-        ri[n] = &zero;
-        }
+    //Position of each IQIndex of *this (li) 
+    //and of other (ri) among those of the product
+    SmallVector<int,NMAX> li(is_.r(),-1),
+                          ri(other.is_.r(),-1);
 
     //Load newindex with those IQIndex's *not* common to *this and other
-    array<IQIndex,NMAX> newindex;
+    IndexSet<IQIndex>::Storage newindex(is_.r()+other.is_.r());
     int nnew = 0; //number of indices on product
-    int nsize = 1; //size of storage for product
 
     for(int i = 0; i < is_.r(); ++i)
         {
@@ -1212,13 +1420,9 @@ operator/=(const IQTensor& other)
                         }
                     }
 
-                ++u.rn;
-                u.n[u.rn] = J.nindex();
-                li[i] = &(u.i[u.rn]);
-                ri[j] = &(u.i[u.rn]);
-
+                li[i] = nnew;
+                ri[j] = nnew;
                 newindex[nnew] = J;
-                nsize *= J.nindex();
                 ++nnew;
 
                 break;
@@ -1228,74 +1432,134 @@ operator/=(const IQTensor& other)
         if(j == other.is_.r()) 
             { 
             // I is not contracted 
-            ++u.rn;
-            u.n[u.rn] = I.nindex();
-            li[i] = &(u.i[u.rn]);
+            li[i] = nnew;
             newindex[nnew] = I;
-            nsize *= I.nindex();
             ++nnew;
             }
         }
 
     for(int j = 0; j < other.is_.r(); ++j)
         {
-        const IQIndex& J = other.is_[j];
-        bool contracted = false;
-        for(const IQIndex& I : this->indices())
-            {
-            if(I == J)
-                {
-                contracted = true;
-                break;
-                }
-            }
-        if(!contracted)
-            {
-            ++u.rn;
-            u.n[u.rn] = J.nindex();
-            ri[j] = &(u.i[u.rn]);
-            newindex[nnew] = J;
-            nsize *= J.nindex();
-            ++nnew;
-            }
+        if(ri[j] >= 0) continue;
+        ri[j] = nnew;
+        newindex[nnew] = other.is_[j];
+        ++nnew;
         }
 
-    array<int,NMAX> ll,
-                    rl;
-    std::fill(ll.begin(),ll.end(),0);
-    std::fill(rl.begin(),rl.end(),0);
-
-    for(int n = 0, dim = 1; n < is_.r(); ++n)
+    //Weights of the sector numbers of the product's indices
+    SmallVector<long,NMAX> nl(nnew,0);
+    for(long n = 0, dim = 1; n < nnew; ++n)
         {
-        ll[n] = dim;
-        dim *= is_[n].nindex();
+        nl[n] = dim;
+        dim *= newindex[n].nindex();
         }
-    for(int n = 0, dim = 1; n < other.is_.r(); ++n)
+
+    //Indices of *this (commonL) and of other (commonR)
+    //belonging to both
+    SmallVector<bool,NMAX> commonL(is_.r(),false),
+                           commonR(other.is_.r(),false);
+    for(int j = 0; j < other.is_.r(); ++j)
+    for(int i = 0; i < is_.r(); ++i)
         {
-        rl[n] = dim;
-        dim *= other.is_[n].nindex();
+        if(ri[j] == li[i]) commonL[i] = commonR[j] = true;
         }
 
-    is_ = IndexSet<IQIndex>(newindex,nnew,0);
-
-    IQTDatPtr nd_ = make_shared<IQTDat>(nsize);
+    //A stored block, its contribution to the position in
+    //the product and the same for its shared sectors only
+    //(key), which is equal for blocks that can be paired
+    struct Block
+        {
+        const ITensor* b;
+        long pos;
+        long key;
+        long cm; //dimension of the shared indices of the block
 
-    const ITensor* pL = &(d_->store().front());
-    const ITensor* pR = &(other.d_->store().front());
-    ITensor* pN = &(nd_->store().front());
+        Block(const ITensor& t) : b(&t), pos(0), key(0), cm(1) { }
+        };
 
-    for(; u.notDone(); ++u)
+    auto blockList = [&nl](const IQTDat& D, 
+                           const IndexSet<IQIndex>& is,
+                           const SmallVector<int,NMAX>& ni,
+                           const SmallVector<bool,NMAX>& common,
+                           bool skip_common)
         {
-        ITensor& n = pN[u.ind];
-        const ITensor& l = pL[dot_(li,ll)];
-        const ITensor& r = pR[dot_(ri,rl)];
-        if(l.valid() && r.valid())
+        vector<Block> res;
+        for(auto it = D.begin(); it != D.end(); ++it)
+            {
+            Block B(*it);
+            long j = it.pos();
+            for(int n = 0; n < is.r(); ++n)
+                {
+                const long N = is[n].nindex();
+                const long w = (j%N)*nl[ni[n]];
+                if(common[n]) B.cm *= is[n].index(1+j%N).m();
+                j /= N;
+                if(common[n]) B.key += w;
+                if(!(common[n] && skip_common)) B.pos += w;
+                }
+            res.push_back(B);
+            }
+        return res;
+        };
+    const vector<Block> Lb = blockList(*d_,is_,li,commonL,false),
+                        Rb = blockList(*(other.d_),other.is_,ri,commonR,true);
+
+    //Blocks of *this grouped by their shared sectors,
+    //so that each block of other only visits its partner
+    std::unordered_map<long,vector<const Block*>> Lkey;
+    for(const Block& l : Lb) Lkey[l.key].push_back(&l);
+
+    //Each pair of matching blocks gives one block of the 
+    //result, computed as a separate task
+    struct OutBlock
+        {
+        long pos;
+        const ITensor *l, 
+                      *r;
+        ITensor res;
+        size_t size,
+               offset;
+        };
+    vector<OutBlock> out;
+    double work = 0;
+
+    for(const Block& r : Rb)
+        {
+        auto match = Lkey.find(r.key);
+        if(match == Lkey.end()) continue;
+        for(const Block* l : match->second)
             {
-            n = l;
-            n /= r;
+            const size_t size = l->b->indices().dim()*(r.b->indices().dim()/l->cm);
+            out.push_back(OutBlock{l->pos+r.pos,l->b,r.b,ITensor(),size,0});
+            work += double(l->b->indices().dim())*r.b->indices().dim();
             }
         }
 
+    vector<OutBlock*> order(out.size());
+    for(size_t k = 0; k < out.size(); ++k) order[k] = &out[k];
+    std::stable_sort(order.begin(),order.end(),[](const OutBlock* a, const OutBlock* b) 
+        { 
+        return double(a->l->indices().dim())*a->r->indices().dim() 
+             > double(b->l->indices().dim())*b->r->indices().dim();
+        });
+
+    const ITDat::Buffer buf = resultBuffer(*d_,*(other.d_),out);
+    std::atomic<bool> packed{bool(buf)};
+
+    runBlockTasks(order.size(),work,[&order,&buf,&packed](long k)
+        {
+        OutBlock& O = *order[k];
+        O.res = *O.l;
+        O.res /= *O.r;
+        if(buf && !IQTDat::moveInto(O.res,buf,O.offset,O.size)) packed = false;
+        });
+
+    IQTDatPtr nd_ = make_shared<IQTDat>();
+    for(OutBlock& O : out) nd_->insert(O.pos).swap(O.res);
+    if(packed) nd_->pack();
+
+    is_ = IndexSet<IQIndex>(newindex,nnew,0);
+
     d_.swap(nd_);
 
     return *this;
@@ -1353,6 +1617,8 @@ operator+=(const IQTensor& other)
 
     solo(); 
 
+    if(d_->sameLayout(*other.d_) && d_->addPacked(*other.d_)) return *this;
+
     for(const ITensor& t : *(other.d_))
         { 
         insertAdd(getBlock(t.indices()),t);
@@ -1438,6 +1704,39 @@ takeImagPart()
     return *this;
     }
 
+IQTensor& IQTensor::
+toSinglePrecision()
+    {
+    solo();
+    for(ITensor& t : *d_)
+        {
+        t.toSinglePrecision();
+        }
+    return *this;
+    }
+
+IQTensor& IQTensor::
+toDoublePrecision()
+    {
+    if(!isSinglePrecision()) return *this;
+    solo();
+    for(ITensor& t : *d_)
+        {
+        t.toDoublePrecision();
+        }
+    return *this;
+    }
+
+bool IQTensor::
+isSinglePrecision() const
+    {
+    for(const ITensor& t : *d_)
+        {
+        if(t.isSinglePrecision()) return true;
+        }
+    return false;
+    }
+
 void IQTensor::
 pseudoInvert(Real cutoff)
     {
@@ -1483,21 +1782,8 @@ const ITensor& IQTensor::
 getBlock(const IndexSet<Index>& inds) const
     {
     if(!valid()) Error("Default initialized IQTensor");
-#ifdef DEBUG
-    const int pos = blockPos(inds,is_);
-    if(pos < 0 || pos >= d_->size()) 
-        {
-        Print(inds);
-        Print(is_);
-        Print(blockPos(inds,is_));
-        Print(d_->size());
-        Error("blockPos out of range");
-        }
-    const ITensor& t = d_->at(pos);
-    return t;
-#else
-    return d_->at(blockPos(inds,is_));
-#endif
+    const IQTDat& store = *d_;
+    return store.at(blockPos(inds,is_));
     }
 
 ITensor& IQTensor::
@@ -1506,7 +1792,7 @@ getBlock(const IndexSet<Index>& inds)
 #ifdef DEBUG
     if(!valid()) Error("Default initialized IQTensor");
 #endif
-    ITensor& t = d_->at(blockPos(inds,is_));
+    ITensor& t = d_->insert(blockPos(inds,is_));
     return t;
     }
 
@@ -1523,9 +1809,86 @@ solo()
 	}
 
 
+Real IQTDat::
+dot(const IQTDat& other) const
+    {
+    const Real *px = buf_->data(),
+               *py = other.buf_->data();
+    Real res = 0;
+    size_t n = 0;
+    for(auto i = begin(), j = other.begin(); i != end(); ++i, ++j, ++n)
+        {
+        LogNumber f = i->scale();
+        f *= j->scale();
+        if(f.sign() == 0) continue;
+        const size_t o = offsets_[n];
+        res += f.real0()*ddot_wrapper(offsets_[n+1]-o,px+o,1,py+o,1);
+        }
+    return res;
+    }
+
+bool IQTDat::
+addPacked(const IQTDat& other)
+    {
+    //In place if only this and its blocks hold the buffer
+    bool inplace = (buf_.use_count() == long(offsets_.size()));
+    for(const ITensor& t : *this)
+        {
+        if(t.scale().sign() == 0) return false;
+        inplace = inplace && t.r_.unique();
+        }
+
+    ITDat::Buffer buf = (inplace ? buf_ : std::make_shared<ITDat::Storage>(offsets_.back()));
+    const Real *px = other.buf_->data(),
+               *py = buf_->data();
+    Real* pz = buf->data();
+    auto j = other.begin();
+    size_t n = 0;
+    for(auto i = begin(); i != end(); ++i, ++j, ++n)
+        {
+        LogNumber f = j->scale();
+        f /= i->scale();
+        const Real b = f.real0();
+        const size_t o = offsets_[n];
+        const long len = offsets_[n+1]-o;
+        if(inplace) 
+            {
+            daxpy_wrapper(len,b,px+o,1,pz+o,1);
+            }
+        else
+            {
+            for(long k = 0; k < len; ++k) pz[o+k] = py[o+k]+b*px[o+k];
+            i->r_ = std::make_shared<ITDat>(buf,o,len);
+            }
+        }
+    buf_ = buf;
+    return true;
+    }
+
+//True if each IQIndex of x is the one of y at the same
+//place, with the same arrow (same == true) or with the 
+//opposite one (same == false)
+bool static
+arrowsMatch(const IQTensor& x, const IQTensor& y, bool same)
+    {
+    const IndexSet<IQIndex>& xs = x.indices();
+    const IndexSet<IQIndex>& ys = y.indices();
+    if(xs.r() != ys.r()) return false;
+    for(int j = 0; j < xs.r(); ++j)
+        {
+        if(xs[j] != ys[j] || (xs[j].dir() == ys[j].dir()) != same) return false;
+        }
+    return true;
+    }
+
 Real 
 Dot(IQTensor x, const IQTensor& y)
     {
+    if(x.blocks().sameLayout(y.blocks()) 
+       && (arrowsMatch(x,y,true) || arrowsMatch(x,y,false)))
+        {
+        return x.blocks().dot(y.blocks());
+        }
     IQIndex I = commonIndex(x,y);
     if(I.dir() == dir(y.indices(),I))
         {
@@ -1538,6 +1901,10 @@ Dot(IQTensor x, const IQTensor& y)
 Complex 
 BraKet(IQTensor x, const IQTensor& y)
     {
+    if(x.blocks().sameLayout(y.blocks()) && arrowsMatch(x,y,true))
+        {
+        return Complex(x.blocks().dot(y.blocks()),0);
+        }
     x.dag();
     x *= y;
     return x.toComplex();
@@ -1658,19 +2025,16 @@ void
 checkStorage(const IQTensor& T)
     {
     const IQTDat& store = T.blocks();
-    for(int n = 0; n < store.maxSize(); ++n)
+    for(auto it = store.begin(); it != store.end(); ++it)
         {
-        const ITensor& b = store.at(n);
-        if(b.valid())
+        const ITensor& b = *it;
+        const long pos = blockPos(b.indices(),T.indices());
+        if(pos != it.pos())
             {
-            const int pos = blockPos(b.indices(),T.indices());
-            if(pos != n)
-                {
-                printfln("T.indices() = %s",T.indices());
-                printfln("b = %s",b);
-                printfln("pos=%d, n=%d",pos,n);
-                throw ITError("ITensor block in wrong storage position.");
-                }
+            printfln("T.indices() = %s",T.indices());
+            printfln("b = %s",b);
+            printfln("pos=%d, n=%d",pos,it.pos());
+            throw ITError("ITensor block in wrong storage position.");
             }
         }
     }
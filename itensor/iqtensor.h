@@ -273,13 +273,13 @@ class IQTensor
 
 
     void
-    tieIndices(const array<IQIndex,NMAX>& indices, int nind, const IQIndex& tied);
+    tieIndices(const IndexSet<IQIndex>::Storage& indices, int nind, const IQIndex& tied);
 
     void
     tieIndices(const IQIndex& i1, const IQIndex& i2, const IQIndex& tied);
 
     IQTensor&
-    trace(const array<IQIndex,NMAX>& indices, int niqind = -1);
+    trace(const IndexSet<IQIndex>::Storage& indices, int niqind = -1);
 
     IQTensor&
     trace(const IQIndex& i1, 
@@ -300,6 +300,18 @@ class IQTensor
     IQTensor&
     takeImagPart();
 
+    //Stores the data of every block in single
+    //precision (see ITensor::toSinglePrecision)
+    IQTensor&
+    toSinglePrecision();
+
+    IQTensor&
+    toDoublePrecision();
+
+    //True if any block is held in single precision
+    bool
+    isSinglePrecision() const;
+
     Vector
     diag() const;
 
@@ -362,8 +374,10 @@ class IQTensor
 
     /////////////////
 
+    //Block with the given indices, or a null ITensor if not present
     const ITensor&
     getBlock(const IndexSet<Index>& inds) const;
+    //Block with the given indices, adding a null ITensor if not present
     ITensor&
     getBlock(const IndexSet<Index>& inds);
 
@@ -373,6 +387,9 @@ class IQTensor
     void 
     solo();
 
+    //Places blocks directly by their position
+    friend class IQCombiner;
+
     }; //class IQTensor
 
 
@@ -480,6 +497,39 @@ Dot(IQTensor x, const IQTensor& y);
 Complex 
 BraKet(IQTensor x, const IQTensor& y);
 
+//
+// Work done by IQTensor contractions (operator*=),
+// summed over all threads. Blocks are matched by
+// hashing their contracted sectors, so only pairs 
+// which share them are visited (and multiplied);
+// pairs counts all block pairs for comparison.
+//
+struct IQContractionStats
+    {
+    long contractions = 0, //calls to operator*=
+         pairs = 0,        //products of numbers of blocks
+         products = 0,     //block pairs multiplied
+         batched = 0;      //of which by batched GEMM
+    };
+
+IQContractionStats
+iqContractionStats();
+
+void
+clearIQContractionStats();
+
+//
+// With batching on, the block products of an IQTensor 
+// contraction which are real and need no permuting are made
+// by batched GEMM calls, one per product shape (see
+// multiplyBatch); the others are still made by parallel
+// tasks. On by default with MKL, whose cblas_dgemm_batch
+// runs a whole batch at once; elsewhere a batch is a loop
+// of dgemm calls, so batching is off by default.
+//
+void
+batchBlockProducts(bool on = true);
+
 //Compute divergence of IQTensor T
 //
 //If DEBUG defined and all blocks do not have
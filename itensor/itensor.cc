@@ -5,6 +5,13 @@
 #include "itensor.h"
 #include "lapack_wrap.h"
 #include "simplematrix.h"
+#include "transpose.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <unordered_map>
 
 namespace itensor {
 
@@ -21,15 +28,15 @@ using std::vector;
 #endif
 
 void
-vectormult(std::vector<Real>& v, Real fac)
+vectormult(ITDat::Storage& v, Real fac)
     {
     dscal_wrapper(v.size(),fac,v.data());
     }
 
 // Y += fac*X
 void
-vectordaxpy(std::vector<Real>& Y, 
-            const std::vector<Real>& X,
+vectordaxpy(ITDat::Storage& Y, 
+            const ITDat::Storage& X,
             Real fac = 1)
     {
 #ifdef DEBUG
@@ -45,6 +52,17 @@ _ind(const IndexSet<Index>& is,
      int i1, int i2, int i3, int i4, 
      int i5, int i6, int i7, int i8);
 
+//Pointers to the (zero-indexed) values of the m!=1 
+//indices of a tensor; one-indexed, ii[1]...ii[rn].
+//Always has at least NMAX+1 elements, unused ones
+//pointing to a zero.
+using IndPtrs = SmallVector<const int*,NMAX+1>;
+
+//Offset of the element with index values *ii[1],...
+int
+_ind(const IndexSet<Index>& is,
+     const IndPtrs& ii);
+
 
 int static
 IT_TypeToInt(ITensor::Type t)
@@ -98,168 +116,18 @@ namespace detail {
 void
 reshape(const Permutation& P, 
         const IndexSet<Index>& is, 
-        const vector<Real>& dat, 
+        const ITDat::Storage& dat, 
         Real *res)
     {
-
-    const auto& ind = P.store();
-
-    //Make a counter for dat
-    Counter c(is);
-    array<int,NMAX+1> n;
-    for(int j = 1; j <= c.rn; ++j) n[ind[j]] = c.n[j];
-
-    //Special case loops
-#define Loop6(q,z,w,k,y,s) {for(int i1 = 0; i1 < n[1]; ++i1) for(int i2 = 0; i2 < n[2]; ++i2)\
-	for(int i3 = 0; i3 < n[3]; ++i3) for(int i4 = 0; i4 < n[4]; ++i4) for(int i5 = 0; i5 < n[5]; ++i5)\
-    for(int i6 = 0; i6 < n[6]; ++i6)\
-    res[ (((((i6)*n[5]+i5)*n[4]+i4)*n[3]+i3)*n[2]+i2)*n[1]+i1 ] =\
-    dat[ (((((s)*c.n[5]+y)*c.n[4]+k)*c.n[3]+w)*c.n[2]+z)*c.n[1]+q ]; return; }
-
-#define Loop5(q,z,w,k,y) {for(int i1 = 0; i1 < n[1]; ++i1) for(int i2 = 0; i2 < n[2]; ++i2)\
-	for(int i3 = 0; i3 < n[3]; ++i3) for(int i4 = 0; i4 < n[4]; ++i4) for(int i5 = 0; i5 < n[5]; ++i5)\
-    res[ ((((i5)*n[4]+i4)*n[3]+i3)*n[2]+i2)*n[1]+i1 ] = dat[ ((((y)*c.n[4]+k)*c.n[3]+w)*c.n[2]+z)*c.n[1]+q ]; return; }
-
-#define Loop4(q,z,w,k) {for(int i1 = 0; i1 < n[1]; ++i1)  for(int i2 = 0; i2 < n[2]; ++i2)\
-	for(int i3 = 0; i3 < n[3]; ++i3) for(int i4 = 0; i4 < n[4]; ++i4)\
-	res[ (((i4)*n[3]+i3)*n[2]+i2)*n[1]+i1 ] = dat[ (((k)*c.n[3]+w)*c.n[2]+z)*c.n[1]+q ]; return; }
-
-#define Loop3(q,z,w) {for(int i1 = 0; i1 < n[1]; ++i1)  for(int i2 = 0; i2 < n[2]; ++i2)\
-	for(int i3 = 0; i3 < n[3]; ++i3) res[ ((i3)*n[2]+i2)*n[1]+i1 ] = dat[ ((w)*c.n[2]+z)*c.n[1]+q ]; return; }
-
-#define Bif3(a,b,c) if(ind[1] == a && ind[2] == b && ind[3] == c)
-
-#define Bif4(a,b,c,d) if(ind[1] == a && ind[2] == b && ind[3] == c && ind[4] == d)
-
-#define Bif5(a,b,c,d,e) if(ind[1] == a && ind[2] == b && ind[3] == c && ind[4]==d && ind[5] == e)
-
-#define Bif6(a,b,c,d,e,g) if(ind[1] == a && ind[2] == b && ind[3] == c && ind[4]==d && ind[5] == e && ind[6] == g)
-
-    if(is.rn() == 3)
-        {
-        //DO_IF_PS(int idx = ((ind[1])*3+ind[2])*3+ind[3]; Prodstats::stats().perms_of_3[idx] += 1; )
-        //Arranged loosely in order of frequency of occurrence
-        Bif3(2,1,3) Loop3(i2,i1,i3)
-        Bif3(2,3,1) Loop3(i2,i3,i1) //cyclic
-        Bif3(3,1,2) Loop3(i3,i1,i2)
-        //Bif3(1,3,2) Loop3(i1,i3,i2)
-        //Bif3(3,2,1) Loop3(i3,i2,i1)
-        }
-    else if(is.rn() == 4)
-        {
-        //DO_IF_PS(int idx = (((ind[1])*4+ind[2])*4+ind[3])*4+ind[4]; Prodstats::stats().perms_of_4[idx] += 1; )
-        //Arranged loosely in order of frequency of occurrence
-        Bif4(1,2,4,3) Loop4(i1,i2,i4,i3)
-        Bif4(1,3,2,4) Loop4(i1,i3,i2,i4)
-        Bif4(2,3,1,4) Loop4(i2,i3,i1,i4)
-        Bif4(2,3,4,1) Loop4(i2,i3,i4,i1) //cyclic
-        Bif4(1,4,2,3) Loop4(i1,i4,i2,i3)
-        Bif4(2,1,3,4) Loop4(i2,i1,i3,i4)
-        Bif4(2,1,4,3) Loop4(i2,i1,i4,i3)
-        Bif4(3,4,1,2) Loop4(i3,i4,i1,i2)
-        }
-    else if(is.rn() == 5)
-        {
-        //DO_IF_PS(int idx = ((((ind[1])*5+ind[2])*5+ind[3])*5+ind[4])*5+ind[5]; Prodstats::stats().perms_of_5[idx] += 1; )
-        //Arranged loosely in order of frequency of occurrence
-        Bif5(3,1,4,5,2) Loop5(i3,i1,i4,i5,i2)
-        Bif5(1,4,2,5,3) Loop5(i1,i4,i2,i5,i3)
-        Bif5(1,4,2,3,5) Loop5(i1,i4,i2,i3,i5)
-        Bif5(3,1,4,2,5) Loop5(i3,i1,i4,i2,i5)
-        Bif5(2,4,1,3,5) Loop5(i2,i4,i1,i3,i5)
-        Bif5(2,4,3,5,1) Loop5(i2,i4,i3,i5,i1)
-        Bif5(3,1,4,5,2) Loop5(i3,i1,i4,i5,i2)
-        Bif5(3,4,1,2,5) Loop5(i3,i4,i1,i2,i5)
-        Bif5(2,1,3,4,5) Loop5(i2,i1,i3,i4,i5)
-        Bif5(2,3,4,5,1) Loop5(i2,i3,i4,i5,i1)
-        Bif5(2,3,4,1,5) Loop5(i2,i3,i4,i1,i5)
-        Bif5(2,3,1,4,5) Loop5(i2,i3,i1,i4,i5)
-        Bif5(2,3,4,1,5) Loop5(i2,i3,i4,i1,i5)
-        Bif5(3,4,1,5,2) Loop5(i3,i4,i1,i5,i2)
-        Bif5(5,1,4,2,3) Loop5(i5,i1,i4,i2,i3)
-        }
-    else if(is.rn() == 6)
-        {
-        //DO_IF_PS(int idx = (((((ind[1])*6+ind[2])*6+ind[3])*6+ind[4])*6+ind[5])*6+ind[6]; Prodstats::stats().perms_of_6[idx] += 1; )
-        //Arranged loosely in order of frequency of occurrence
-        Bif6(2,4,1,3,5,6) Loop6(i2,i4,i1,i3,i5,i6)
-        Bif6(1,4,2,3,5,6) Loop6(i1,i4,i2,i3,i5,i6)
-        Bif6(2,4,1,5,3,6) Loop6(i2,i4,i1,i5,i3,i6)
-        Bif6(1,2,4,5,3,6) Loop6(i1,i2,i4,i5,i3,i6)
-        Bif6(3,4,1,5,6,2) Loop6(i3,i4,i1,i5,i6,i2)
-        }
-    //DO_IF_PS(Prodstats::stats().c4 += 1;)
-
-    //The j's are pointers to the i's of xdat's Counter,
-    //but reordered in a way appropriate for res
-    array<int*,NMAX+1> j;
-    for(int k = 1; k <= NMAX; ++k) 
-        { 
-        j[ind[k]] = &(c.i[k]); 
-        }
-
-    //Catch-all loops that work for any tensor
-    switch(c.rn)
-    {
-    case 2:
-        for(; c.notDone(); ++c)
-            {
-            res[(*j[2])*n[1]+*j[1]]
-                = dat[c.ind];
-            }
-        return;
-    case 3:
-        for(; c.notDone(); ++c)
-            {
-            res[((*j[3])*n[2]+*j[2])*n[1]+*j[1]]
-                = dat[c.ind];
-            }
-        return;
-    case 4:
-        for(; c.notDone(); ++c)
-            {
-            res[(((*j[4])*n[3]+*j[3])*n[2]+*j[2])*n[1]+*j[1]]
-                = dat[c.ind];
-            }
-        return;
-    case 5:
-        for(; c.notDone(); ++c)
-            {
-            res[((((*j[5])*n[4]+*j[4])*n[3]+*j[3])*n[2]+*j[2])*n[1]+*j[1]]
-                = dat[c.ind];
-            }
-        return;
-    case 6:
-        for(; c.notDone(); ++c)
-            {
-            res[(((((*j[6])*n[5]+*j[5])*n[4]+*j[4])*n[3]+*j[3])*n[2]+*j[2])*n[1]+*j[1]]
-                = dat[c.ind];
-            }
-        return;
-    case 7:
-        for(; c.notDone(); ++c)
-            {
-            res[((((((*j[7])*n[6]+*j[6])*n[5]+*j[5])*n[4]+*j[4])*n[3]+*j[3])*n[2]+*j[2])*n[1]+*j[1]]
-                = dat[c.ind];
-            }
-        return;
-    default:
-        for(; c.notDone(); ++c)
-            {
-            res[(((((((*j[8])*n[7]+*j[7])*n[6]+*j[6])*n[5]+*j[5])*n[4]+*j[4])*n[3]+*j[3])*n[2]+*j[2])*n[1]+*j[1]]
-                = dat[c.ind];
-            }
-        return;
-    } //switch(c.rn)
-
-    } // reshape
+    TransposePlan(P,is)(dat.data(),res);
+    }
 };
 
 void
 reshape(const Permutation& P, 
         const IndexSet<Index>& is, 
-        const vector<Real>& dat, 
-        vector<Real>& res)
+        const ITDat::Storage& dat, 
+        ITDat::Storage& res)
     {
     if(P.isTrivial())
         {
@@ -273,7 +141,7 @@ reshape(const Permutation& P,
 void
 reshape(const Permutation& P, 
         const IndexSet<Index>& is, 
-        const vector<Real>& dat, 
+        const ITDat::Storage& dat, 
         Vector& res)
     {
     if(P.isTrivial())
@@ -410,9 +278,9 @@ ITensor(const Index& i1, const Index& i2, const Index& i3,
     if(i3 == Index::Null())
         Error("i3 is null");
 #endif
-	array<Index,NMAX> ii = {{ i1, i2, i3, i4, i5, i6, i7, i8 }};
+	const array<Index,8> ii = {{ i1, i2, i3, i4, i5, i6, i7, i8 }};
 	int size = 3;
-	while(ii[size] != Index::Null()) ++size;
+	while(size < int(ii.size()) && ii[size] != Index::Null()) ++size;
 	int alloc_size = -1; 
     is_ = IndexSet<Index>(ii,size,alloc_size,0);
 	allocate(alloc_size);
@@ -434,7 +302,7 @@ ITensor(const IndexVal& iv)
         Error("IndexVal out of range");
         }
 #endif
-	r_->v[iv.i-1] = 1; 
+	r_->v()[iv.i-1] = 1; 
 	}
 
 ITensor::
@@ -449,7 +317,7 @@ ITensor(const IndexVal& iv1, const IndexVal& iv2)
 #ifdef DEBUG
     if(offset < 0 || offset > int(r_->size())) Error("IndexVal out of range");
 #endif
-	r_->v[offset] = 1; 
+	r_->v()[offset] = 1; 
 	}
 
 ITensor::
@@ -483,7 +351,7 @@ ITensor(const IndexVal& iv1, const IndexVal& iv2,
             { ja[k] = iv[j]-1; break; }
         }
 
-    r_->v[_ind(is_,ja[0],ja[1],ja[2],ja[3],ja[4],ja[5],ja[6],ja[7])] = 1;
+    r_->v()[_ind(is_,ja[0],ja[1],ja[2],ja[3],ja[4],ja[5],ja[6],ja[7])] = 1;
     }
 
 ITensor::
@@ -544,13 +412,14 @@ ITensor(const IndexSet<Index>& I, const ITensor& other, const Permutation& P)
         }
     else               
         { 
-        allocate(); 
-        reshape(P,other.is_,other.r_->v,r_->v); 
+        const TransposePlan plan(P,other.is_);
+        allocate(other.r_->size());
+        plan(other.r_->data(),r_->data());
 
         if(other.i_)
             {
-            allocateImag();
-            reshape(P,other.is_,other.i_->v,i_->v); 
+            allocateImag(other.i_->size());
+            plan(other.i_->data(),i_->data());
             }
         }
     }
@@ -585,7 +454,7 @@ diag() const
     Vector res;
     if(type_ == Diag)
         {
-        res = Vector(r_->v);
+        res = Vector(r_->v());
         }
     else
     if(type_ == Dense)
@@ -593,7 +462,7 @@ diag() const
         res = Vector(minM(is_));
         for(int i = 0; i < res.Length(); ++i)
             {
-            res(1+i) = r_->v[_ind(is_,i,i,i,i,i,i,i,i)];
+            res(1+i) = r_->v()[_ind(is_,i,i,i,i,i,i,i,i)];
             }
         }
     else
@@ -646,6 +515,97 @@ write(std::ostream& s) const
     if(is_cplx) i_->write(s);
     }
 
+void
+writeBlocks(std::ostream& s, const std::vector<const ITensor*>& T)
+    {
+    size_t n = T.size();
+    s.write((char*) &n,sizeof(n));
+    size_t total = 0;
+    for(const ITensor* t : T)
+        {
+        int tint = IT_TypeToInt(t->type_);
+        s.write((char*) &tint,sizeof(tint));
+        t->is_.write(s);
+        t->scale_.write(s);
+        size_t size = t->r_->size();
+        s.write((char*) &size,sizeof(size));
+        bool is_cplx = t->isComplex();
+        s.write((char*) &is_cplx,sizeof(is_cplx));
+        total += (is_cplx ? 2 : 1)*size;
+        }
+
+    //The data is written straight from the ITensors: with one
+    //call if it lies in one buffer in the order written (as for 
+    //the blocks of a packed IQTDat), else with one per part
+    const ITDat* first = (n > 0 ? T.front()->r_.get() : nullptr);
+    if(first && first->isView())
+        {
+        const ITDat::Buffer& buf = first->buffer();
+        size_t off = first->offset();
+        bool contiguous = true;
+        for(const ITensor* t : T)
+            {
+            contiguous = contiguous && t->r_->views(buf,off);
+            off += t->r_->size();
+            if(!t->isComplex()) continue;
+            contiguous = contiguous && t->i_->views(buf,off);
+            off += t->i_->size();
+            }
+        if(contiguous)
+            {
+            s.write((char*) first->data(),sizeof(Real)*total);
+            return;
+            }
+        }
+    for(const ITensor* t : T)
+        {
+        s.write((char*) t->r_->data(),sizeof(Real)*t->r_->size());
+        if(t->isComplex()) s.write((char*) t->i_->data(),sizeof(Real)*t->i_->size());
+        }
+    }
+
+std::vector<ITensor>
+readBlocks(std::istream& s)
+    {
+    size_t n = 0;
+    s.read((char*) &n,sizeof(n));
+    std::vector<ITensor> T(n);
+    std::vector<size_t> size(n);
+    size_t total = 0;
+    for(size_t j = 0; j < n; ++j)
+        {
+        ITensor& t = T[j];
+        int tint = 0;
+        s.read((char*) &tint,sizeof(tint));
+        t.type_ = IT_IntToType(tint);
+        t.is_.read(s);
+        t.scale_.read(s);
+        s.read((char*) &size[j],sizeof(size[j]));
+        bool is_cplx = false;
+        s.read((char*) &is_cplx,sizeof(is_cplx));
+        total += (is_cplx ? 2 : 1)*size[j];
+        if(is_cplx) t.i_ = make_shared<ITDat>();
+        }
+
+    //Read the data of all of the blocks into one buffer,
+    //each block viewing its part of it
+    auto buf = make_shared<ITDat::Storage>(total);
+    s.read((char*) buf->data(),sizeof(Real)*total);
+    size_t off = 0;
+    for(size_t j = 0; j < n; ++j)
+        {
+        ITensor& t = T[j];
+        t.r_ = make_shared<ITDat>(buf,off,size[j]);
+        off += size[j];
+        if(t.i_)
+            {
+            t.i_ = make_shared<ITDat>(buf,off,size[j]);
+            off += size[j];
+            }
+        }
+    return T;
+    }
+
 
 Real ITensor::
 toReal() const 
@@ -665,12 +625,12 @@ toReal() const
         }
 
 	try {
-	    return r_->v.at(0)*scale_.real(); 
+	    return r_->data()[0]*scale_.real(); 
 	    }
 	catch(const TooBigForReal& e)
 	    {
 	    println("too big for real() in toReal");
-	    println("r_->v[0] is ",r_->v.at(0));
+	    println("r_->v[0] is ",r_->v().at(0));
 	    println("scale is ",scale());
 	    println("rethrowing");
 	    throw e;
@@ -692,12 +652,12 @@ toComplex() const
         {
         Real re, im;
         try {
-            re = r_->v.at(0)*scale_.real(); 
+            re = r_->data()[0]*scale_.real(); 
             }
         catch(const TooBigForReal& e)
             {
             println("too big for real() in toReal");
-            println("r_->v[0] is ",r_->v.at(0));
+            println("r_->v[0] is ",r_->v().at(0));
             println("scale is ",scale());
             println("rethrowing");
             throw e;
@@ -708,12 +668,12 @@ toComplex() const
             }
 
         try {
-            im = i_->v.at(0)*scale_.real(); 
+            im = i_->data()[0]*scale_.real(); 
             }
         catch(const TooBigForReal& e)
             {
             println("too big for real() in toReal");
-            println("i_->v[0] is ",i_->v.at(0));
+            println("i_->v[0] is ",i_->v().at(0));
             println("scale is ",scale());
             println("rethrowing");
             throw e;
@@ -772,7 +732,7 @@ operator()(const IndexVal& iv1)
 #endif
     solo(); 
     scaleTo(1);
-    return r_->v.at(iv1.i-1);
+    return r_->v().at(iv1.i-1);
 	}
 
 Real ITensor::
@@ -791,7 +751,7 @@ operator()(const IndexVal& iv1) const
         Error("Incorrect IndexVal argument to ITensor");
         }
 #endif
-    return scale_.real()*r_->v.at(iv1.i-1);
+    return scale_.real()*r_->data()[iv1.i-1];
 	}
 
 Real& ITensor::
@@ -807,10 +767,10 @@ operator()(const IndexVal& iv1, const IndexVal& iv2)
 
     if(type_ == Diag)
         {
-        return r_->v.at(iv1.i-1);
+        return r_->v().at(iv1.i-1);
         }
 
-    return r_->v[_ind2(iv1,iv2)];
+    return r_->v()[_ind2(iv1,iv2)];
     }
 
 Real ITensor::
@@ -820,9 +780,9 @@ operator()(const IndexVal& iv1, const IndexVal& iv2) const
     if(type_ == Diag)
         {
         if(iv1.i != iv2.i) return 0;
-        return r_->v.at(iv1.i-1);
+        return r_->data()[iv1.i-1];
         }
-    return scale_.real()*r_->v[_ind2(iv1,iv2)];
+    return scale_.real()*r_->data()[_ind2(iv1,iv2)];
     }
 
 Real& ITensor::
@@ -839,9 +799,9 @@ operator()(const IndexVal& iv1, const IndexVal& iv2,
         if(di == -1)
             convertToDense();
         else
-            return r_->v.at(di-1);
+            return r_->v().at(di-1);
         }
-    return r_->v[_ind8(iv1,iv2,iv3,iv4,iv5,iv6,iv7,iv8)];
+    return r_->v()[_ind8(iv1,iv2,iv3,iv4,iv5,iv6,iv7,iv8)];
     }
 
 Real ITensor::
@@ -855,9 +815,9 @@ operator()(const IndexVal& iv1, const IndexVal& iv2,
         {
         const int di = _diag_ind8(iv1,iv2,iv3,iv4,iv5,iv6,iv7,iv8);
         if(di == -1) return 0;
-        return scale_.real()*r_->v.at(di-1);
+        return scale_.real()*r_->data()[di-1];
         }
-    return scale_.real()*r_->v[_ind8(iv1,iv2,iv3,iv4,iv5,iv6,iv7,iv8)];
+    return scale_.real()*r_->data()[_ind8(iv1,iv2,iv3,iv4,iv5,iv6,iv7,iv8)];
     }
 
 //Process IndexVals for element access when ITensor
@@ -887,7 +847,7 @@ _diag_ind8(const IndexVal& iv1, const IndexVal& iv2,
 
 
 void ITensor::
-groupIndices(const array<Index,NMAX+1>& indices, int nind, 
+groupIndices(const SmallVector<Index,NMAX+1>& indices, int nind, 
              const Index& grouped, ITensor& res) const
     {
     if(type_ == Diag)
@@ -895,8 +855,7 @@ groupIndices(const array<Index,NMAX+1>& indices, int nind,
         Error("groupIndices not yet defined for type() == Diag");
         }
 
-    array<int,NMAX+1> isReplaced; 
-    isReplaced.fill(0);
+    SmallVector<int,NMAX+1> isReplaced(r()+1,0); 
 
     //Print(*this);
 
@@ -935,7 +894,7 @@ groupIndices(const array<Index,NMAX+1>& indices, int nind,
     const int res_rn_ = is_.rn() - nn + (nn == 0 ? 0 : 1);
 
     IndexSet<Index> nindices; 
-    Permutation P(NMAX+1);
+    Permutation P(r()+1);
     int nkept = 0; 
     for(int j = 1; j <= is_.rn(); ++j)
         {
@@ -962,7 +921,7 @@ groupIndices(const array<Index,NMAX+1>& indices, int nind,
     }
 
 void ITensor::
-tieIndices(const array<Index,NMAX>& indices, int nind,
+tieIndices(const IndexSet<Index>::Storage& indices, int nind,
            const Index& tied)
     {
     if(type_ == Diag)
@@ -974,14 +933,13 @@ tieIndices(const array<Index,NMAX>& indices, int nind,
 
     const int tm = tied.m();
     
-    array<Index,NMAX+1> new_index_;
+    SmallVector<Index,NMAX+1> new_index_(r()+1);
     new_index_[1] = tied;
     //will count these up below
     int new_r_ = 1;
     int alloc_size = tm;
 
-    array<bool,NMAX+1> is_tied;
-    is_tied.fill(false);
+    SmallVector<bool,NMAX+1> is_tied(r()+1,false);
 
     int nmatched = 0;
     for(int k = 1; k <= r(); ++k)
@@ -1030,7 +988,8 @@ tieIndices(const array<Index,NMAX>& indices, int nind,
     //Set up ii pointers to link
     //elements of res to appropriate
     //elements of *this
-    array<const int*,NMAX+1> ii;
+    const int zero = 0;
+    IndPtrs ii(std::max(r(),NMAX)+1,&zero);
     int n = 2;
     for(int j = 1; j <= r(); ++j)
         {
@@ -1039,38 +998,26 @@ tieIndices(const array<Index,NMAX>& indices, int nind,
         else
             ii[j] = &(nc.i[n++]);
         }
-
-    const int zero = 0;
-    for(int j = r()+1; j <= NMAX; ++j)
-        ii[j] = &zero;
     
     //Create the new dat
-    auto np = make_shared<ITDat>(alloc_size,0);
-    const auto& thisdat = r_->v;
-    auto& newdat = np->v;
+    auto np = make_shared<ITDat>(alloc_size,ITDat::noInit);
+    const Real* thisdat = r_->data();
+    auto& newdat = np->v();
     for(; nc.notDone(); ++nc)
         {
-        newdat[nc.ind] =
-        thisdat[_ind(is_,*ii[1],*ii[2],
-                         *ii[3],*ii[4],
-                         *ii[5],*ii[6],
-                         *ii[7],*ii[8])];
+        newdat[nc.ind] = thisdat[_ind(is_,ii)];
         }
 
     r_.swap(np);
 
     if(this->isComplex())
         {
-        np = make_shared<ITDat>(alloc_size,0);
-        const auto& thisidat = i_->v;
-        auto& newdat = np->v;
+        np = make_shared<ITDat>(alloc_size,ITDat::noInit);
+        const Real* thisidat = i_->data();
+        auto& newdat = np->v();
         for(nc.reset(); nc.notDone(); ++nc)
             {
-            newdat[nc.ind] =
-            thisidat[_ind(is_,*ii[1],*ii[2],
-                              *ii[3],*ii[4],
-                              *ii[5],*ii[6],
-                              *ii[7],*ii[8])];
+            newdat[nc.ind] = thisidat[_ind(is_,ii)];
             }
         i_.swap(np);
         }
@@ -1083,11 +1030,7 @@ void ITensor::
 tieIndices(const Index& i1, const Index& i2,
            const Index& tied)
     {
-    array<Index,NMAX> inds =
-        {{ i1, i2, 
-           Index::Null(), Index::Null(), 
-           Index::Null(), Index::Null(), 
-           Index::Null(), Index::Null() }};
+    const IndexSet<Index>::Storage inds = { i1, i2 };
 
     tieIndices(inds,2,tied);
     }
@@ -1097,10 +1040,7 @@ tieIndices(const Index& i1, const Index& i2,
            const Index& i3,
            const Index& tied)
     {
-    array<Index,NMAX> inds =
-        {{ i1, i2, i3,
-           Index::Null(), Index::Null(), 
-           Index::Null(), Index::Null(), Index::Null() }};
+    const IndexSet<Index>::Storage inds = { i1, i2, i3 };
 
     tieIndices(inds,3,tied);
     }
@@ -1110,16 +1050,13 @@ tieIndices(const Index& i1, const Index& i2,
            const Index& i3, const Index& i4,
            const Index& tied)
     {
-    array<Index,NMAX> inds =
-        {{ i1, i2, i3, i4,
-           Index::Null(), Index::Null(), 
-           Index::Null(), Index::Null() }};
+    const IndexSet<Index>::Storage inds = { i1, i2, i3, i4 };
 
     tieIndices(inds,4,tied);
     }
 
 ITensor& ITensor::
-trace(const array<Index,NMAX>& indices, int nind)
+trace(const IndexSet<Index>::Storage& indices, int nind)
     {
     if(type_ == Diag)
         {
@@ -1129,21 +1066,20 @@ trace(const array<Index,NMAX>& indices, int nind)
     if(nind < 0)
         {
         nind = 0;
-        while(indices[nind] != Index::Null()) ++nind;
+        while(nind < int(indices.size()) && indices[nind] != Index::Null()) ++nind;
         }
 
     if(nind == 0) Error("No indices given");
 
     const int tm = indices[0].m();
     
-    array<Index,NMAX+1> new_index_;
+    SmallVector<Index,NMAX+1> new_index_(r()+1);
 
     //will count these up below
     int new_r_ = 0;
     int alloc_size = 1;
 
-    array<bool,NMAX+1> traced;
-    traced.fill(false);
+    SmallVector<bool,NMAX+1> traced(r()+1,false);
 
     int nmatched = 0;
     for(int k = 1; k <= r(); ++k)
@@ -1200,7 +1136,8 @@ trace(const array<Index,NMAX>& indices, int nind)
     //elements of res to appropriate
     //elements of *this
     int trace_ind = 0;
-    array<const int*,NMAX+1> ii;
+    const int zero = 0;
+    IndPtrs ii(std::max(r(),NMAX)+1,&zero);
     int n = 1;
     for(int j = 1; j <= r(); ++j)
         {
@@ -1210,51 +1147,26 @@ trace(const array<Index,NMAX>& indices, int nind)
             ii[j] = &(nc.i[n++]);
         }
 
-    const int zero = 0;
-    for(int j = r()+1; j <= NMAX; ++j)
-        ii[j] = &zero;
-    
-    //Create the new dat
-    shared_ptr<ITDat> np = make_shared<ITDat>(alloc_size,0);
-    auto& resdat = np->v;
-
-    const auto& thisdat = r_->v;
-    for(; nc.notDone(); ++nc)
-        {
-        Real newval = 0;
-        for(trace_ind = 0; trace_ind < tm; ++trace_ind)
-            {
-            newval += 
-            thisdat[_ind(is_,*ii[1],*ii[2],
-                             *ii[3],*ii[4],
-                             *ii[5],*ii[6],
-                             *ii[7],*ii[8])];
-            }
-        resdat[nc.ind] = newval;
-        }
-
-    is_.swap(new_is_);
-    r_.swap(np);
-
-    if(this->isComplex())
+    auto traceDat = [&](const ITDat& thisdat) -> shared_ptr<ITDat>
         {
-        const auto& thisidat = i_->v;
+        auto np = make_shared<ITDat>(alloc_size,ITDat::noInit);
+        auto& resdat = np->v();
         for(nc.reset(); nc.notDone(); ++nc)
             {
             Real newval = 0;
             for(trace_ind = 0; trace_ind < tm; ++trace_ind)
                 {
-                newval += 
-                thisidat[_ind(is_,*ii[1],*ii[2],
-                                  *ii[3],*ii[4],
-                                  *ii[5],*ii[6],
-                                  *ii[7],*ii[8])];
+                newval += thisdat.data()[_ind(is_,ii)];
                 }
             resdat[nc.ind] = newval;
             }
+        return np;
+        };
 
-        i_.swap(np);
-        }
+    r_ = traceDat(*r_);
+    if(this->isComplex()) i_ = traceDat(*i_);
+
+    is_.swap(new_is_);
 
     return *this;
     } //ITensor::trace
@@ -1266,8 +1178,8 @@ trace(const Index& i1, const Index& i2,
       const Index& i5, const Index& i6,
       const Index& i7, const Index& i8)
     {
-    array<Index,NMAX> inds = {{ i1, i2, i3, i4,
-                                i5, i6, i7, i8 }};
+    const IndexSet<Index>::Storage inds = { i1, i2, i3, i4,
+                                            i5, i6, i7, i8 };
     trace(inds);
     return *this;
     }
@@ -1363,7 +1275,7 @@ expandIndex(const Index& small, const Index& big, int start)
     shared_ptr<ITDat> oldr(r_);
     allocate(newinds.dim());
 
-    auto omax = int(oldr->v.size());
+    auto omax = int(oldr->size());
     const Real* const olddat = oldr->data();
     Real* const newdat = r_->data();
 
@@ -1412,7 +1324,7 @@ assignToVec() const
     ITENSOR_CHECK_NULL
     if(this->isComplex())
         Error("assignToVec defined only for real ITensor");
-    Vector rv(r_->v);
+    Vector rv(r_->v());
     if(scale_.isRealZero()) 
         {
         rv *= 0;
@@ -1433,10 +1345,10 @@ pseudoInvert(Real cutoff)
     scale_.pow(-1); //succeeds even if scale_ == 0
     for(int j = 1; j <= int(r_->size()); ++j)
         {
-        if(r_->v.at(j-1) > cutoff)
-            r_->v.at(j-1) = 1./r_->v.at(j-1);
+        if(r_->v().at(j-1) > cutoff)
+            r_->v().at(j-1) = 1./r_->v().at(j-1);
         else
-            r_->v.at(j-1) = 0;
+            r_->v().at(j-1) = 0;
         }
     }
 
@@ -1450,13 +1362,15 @@ reshapeDat(const Permutation& P)
         }
     if(P.isTrivial()) return;
     solo();
-    std::vector<Real> newdat;
-    reshape(P,is_,r_->v,newdat);
-    r_->v = std::move(newdat);
+    const TransposePlan plan(P,is_);
+    ITDat::Storage newdat(r_->size());
+    plan(r_->data(),newdat.data());
+    r_->v().swap(newdat);
     if(i_)
         {
-        reshape(P,is_,i_->v,newdat);
-        i_->v = std::move(newdat);
+        newdat.resize(i_->size());
+        plan(i_->data(),newdat.data());
+        i_->v().swap(newdat);
         }
     }
 
@@ -1493,16 +1407,16 @@ randomize(const Args& args)
     { 
     solo(); 
     convertToDense();
-    for(size_t j = 0; j < r_->v.size(); ++j)
+    for(size_t j = 0; j < r_->v().size(); ++j)
         {
-        r_->v[j] = Global::random();
+        r_->v()[j] = Global::random();
         }
     if(i_ || args.getBool("Complex",false))
         {
-        allocateImag(r_->v.size());
-        for(size_t j = 0; j < i_->v.size(); ++j)
+        allocateImag(r_->v().size());
+        for(size_t j = 0; j < i_->v().size(); ++j)
             {
-            i_->v[j] = Global::random();
+            i_->v()[j] = Global::random();
             }
         }
     }
@@ -1513,7 +1427,7 @@ conj()
     if(i_)
         {
         soloImag();
-        vectormult(i_->v,-1);
+        vectormult(i_->v(),-1);
         }
     }
 
@@ -1529,6 +1443,13 @@ Real ITensor::
 normNoScale() const 
     { 
     ITENSOR_CHECK_NULL
+    if(r_->isSingle() && !this->isComplex())
+        {
+        const float* p = r_->singleData();
+        Real nrm2 = 0;
+        for(size_t j = 0; j < r_->size(); ++j) nrm2 += Real(p[j])*p[j];
+        return sqrt(nrm2);
+        }
     if(!this->isComplex())
         {
         return Norm(VectorRefNoLink(r_->data(),r_->size()));
@@ -1570,9 +1491,18 @@ scaleOutNorm()
 
     if(f != 0) 
         { 
-        solo();
-        vectormult(r_->v,1./f);
-        if(i_) vectormult(i_->v,1./f);
+        if(r_->isSingle() && !i_ && r_.unique())
+            {
+            //Rescale in place, keeping single precision
+            const float s = 1./f;
+            for(auto& el : r_->f_) el *= s;
+            }
+        else
+            {
+            solo();
+            vectormult(r_->v(),1./f);
+            if(i_) vectormult(i_->v(),1./f);
+            }
         scale_ *= f; 
         }
     else //norm == zero
@@ -1590,8 +1520,8 @@ scaleTo(const LogNumber& newscale)
     if(scale_ == newscale) return;
     solo();
     scale_ /= newscale;
-    vectormult(r_->v,scale_.real0());
-    if(i_) vectormult(i_->v,scale_.real0());
+    vectormult(r_->v(),scale_.real0());
+    if(i_) vectormult(i_->v(),scale_.real0());
     scale_ = newscale;
     }
 
@@ -1620,16 +1550,40 @@ allocateImag()
     i_ = make_shared<ITDat>(); 
     }
 
+ITensor& ITensor::
+toSinglePrecision()
+    {
+    ITENSOR_CHECK_NULL
+    if(!r_.unique()) r_ = make_shared<ITDat>(*r_);
+    r_->makeSingle();
+    if(i_)
+        {
+        if(!i_.unique()) i_ = make_shared<ITDat>(*i_);
+        i_->makeSingle();
+        }
+    return *this;
+    }
+
+ITensor& ITensor::
+toDoublePrecision()
+    {
+    ITENSOR_CHECK_NULL
+    solo();
+    return *this;
+    }
+
 void ITensor::
 soloReal()
 	{
     ITENSOR_CHECK_NULL
     if(!r_.unique())
         { 
-        shared_ptr<ITDat> newr = make_shared<ITDat>();
-        newr->v = r_->v;
+        shared_ptr<ITDat> newr = make_shared<ITDat>(*r_);
         r_.swap(newr);
         }
+    //About to be modified: data held in 
+    //single precision is promoted
+    r_->makeDouble();
     }
 
 void ITensor::
@@ -1639,10 +1593,10 @@ soloImag()
 
     if(!i_.unique())
         { 
-        shared_ptr<ITDat> newi = make_shared<ITDat>();
-        newi->v = i_->v;
+        shared_ptr<ITDat> newi = make_shared<ITDat>(*i_);
         i_.swap(newi);
         }
+    i_->makeDouble();
 	}
 
 void ITensor::
@@ -1662,7 +1616,7 @@ equalizeScales(ITensor& other)
     else //*this is equivalent to zero
         {
         soloReal();
-        std::fill(r_->v.begin(),r_->v.end(),0.);
+        std::fill(r_->v().begin(),r_->v().end(),0.);
         scale_ = other.scale_;
         }
     }
@@ -1673,8 +1627,8 @@ operator*=(Real fac)
     if(fac == 0)
         {
         solo();
-        std::fill(r_->v.begin(),r_->v.end(),0.);
-        if(i_) std::fill(i_->v.begin(),i_->v.end(),0);
+        std::fill(r_->v().begin(),r_->v().end(),0.);
+        if(i_) std::fill(i_->v().begin(),i_->v().end(),0);
         return *this;
         }
 
@@ -1688,9 +1642,9 @@ operator*=(Complex z)
     if(z.real() == 0)
         {
         r_.swap(i_);
-        if(!r_) allocate(i_->v.size());
+        if(!r_) allocate(i_->v().size());
         soloReal();
-        vectormult(r_->v,-1);
+        vectormult(r_->v(),-1);
         scale_ *= z.imag();
         return *this;
         }
@@ -1704,16 +1658,16 @@ operator*=(Complex z)
     if(!this->isComplex())
         {
         allocateImag();
-        i_->v = r_->v;
+        i_->v() = r_->v();
         if(fabs(z.real()) > fabs(z.imag()))
             {
             scale_ *= z.real();
-            vectormult(i_->v,(z.imag()/z.real()));
+            vectormult(i_->v(),(z.imag()/z.real()));
             }
         else
             {
             soloReal();
-            vectormult(r_->v,(z.real()/z.imag()));
+            vectormult(r_->v(),(z.real()/z.imag()));
             scale_ *= z.imag();
             }
         return *this;
@@ -1723,12 +1677,12 @@ operator*=(Complex z)
     solo();
     VectorRefNoLink rref(r_->data(),r_->size());
     VectorRefNoLink iref(i_->data(),i_->size());
-    //Vector newr = r_->v*z.real() - i_->v*z.imag();
-    //Vector newi = r_->v*z.imag() + i_->v*z.real();
+    //Vector newr = r_->v()*z.real() - i_->v()*z.imag();
+    //Vector newi = r_->v()*z.imag() + i_->v()*z.real();
     Vector newr = rref*z.real()-iref*z.imag();
     Vector newi = rref*z.imag()+iref*z.real();
-    r_->v.assign(newr.begin(),newr.end());
-    i_->v.assign(newi.begin(),newi.end());
+    r_->v().assign(newr.begin(),newr.end());
+    i_->v().assign(newi.begin(),newi.end());
 
     return *this;
     }
@@ -1768,6 +1722,23 @@ _ind(const IndexSet<Index>& is,
     return 0;
     }
 
+int
+_ind(const IndexSet<Index>& is,
+     const IndPtrs& ii)
+    {
+    if(is.rn() <= NMAX)
+        {
+        return _ind(is,*ii[1],*ii[2],*ii[3],*ii[4],
+                       *ii[5],*ii[6],*ii[7],*ii[8]);
+        }
+    int ind = 0;
+    for(int j = is.rn(); j >= 1; --j)
+        {
+        ind = ind*is[j-1].m() + *ii[j];
+        }
+    return ind;
+    }
+
 
 int ITensor::
 _ind2(const IndexVal& iv1, const IndexVal& iv2) const
@@ -1797,13 +1768,12 @@ _ind8(const IndexVal& iv1, const IndexVal& iv2,
       const IndexVal& iv5,const IndexVal& iv6,
       const IndexVal& iv7,const IndexVal& iv8) const
     {
-    array<const IndexVal*,NMAX> iv = 
+    const array<const IndexVal*,8> iv = 
         {{ &iv1, &iv2, &iv3, &iv4, &iv5, &iv6, &iv7, &iv8 }};
-    array<int,NMAX> ja; 
-    ja.fill(0);
+    SmallVector<int,NMAX> ja(std::max(is_.r(),NMAX),0); 
     //Loop over the given IndexVals
     int nn = 0;
-    for(int j = 0; j < is_.r(); ++j)
+    for(int j = 0; j < std::min(is_.r(),int(iv.size())); ++j)
         {
         const IndexVal& J = *iv[j];
         if(J == IndexVal::Null()) break;
@@ -1847,7 +1817,7 @@ struct ProductProps
     ProductProps(const ITensor& L, const ITensor& R);
 
     //arrays specifying which indices match
-    array<bool,NMAX+1> contractedL, contractedR; 
+    SmallVector<bool,NMAX+1> contractedL, contractedR; 
 
     int nsamen, //number of m !=1 indices that match
         cdim,   //total dimension of contracted inds
@@ -1870,6 +1840,8 @@ struct ProductProps
 ProductProps::
 ProductProps(const ITensor& L, const ITensor& R) 
     :
+    contractedL(std::max(L.is_.rn(),NMAX)+1,false),
+    contractedR(std::max(R.is_.rn(),NMAX)+1,false),
     nsamen(0), 
     cdim(1), 
     odimL(-1), 
@@ -1879,8 +1851,6 @@ ProductProps(const ITensor& L, const ITensor& R)
     pl(NMAX+1),
     pr(NMAX+1)
     {
-    for(int j = 1; j <= NMAX; ++j) 
-        contractedL[j] = contractedR[j] = false;
 
     for(int j = 1; j <= L.is_.rn(); ++j)
 	for(int k = 1; k <= R.is_.rn(); ++k)
@@ -1917,69 +1887,247 @@ ProductProps(const ITensor& L, const ITensor& R)
     odimR = R.r_->size()/cdim;
     }
 
-//Converts ITensor dats into MatrixRef's that can be multiplied as rref*lref
-//contractedL/R[j] == true if L/R.indexn(j) contracted
-void 
-toMatrixProd(const ITensor& L, const ITensor& R, 
-             std::vector<Real>& newLdat,
-             std::vector<Real>& newRdat,
-             ProductProps& props,
-             SimpleMatrixRef& lref, SimpleMatrixRef& rref, 
-             bool& L_is_matrix, bool& R_is_matrix, bool doReshape)
+//
+// Everything about the product of two Dense
+// ITensors which only depends on their m!=1 indices.
+// Built once for each shape of product, then
+// looked up in a (per thread) cache.
+//
+struct ContractionPlan
     {
-#ifdef DEBUG
-    if(L.type() == ITensor::Diag)
-        Error("toMatrixProd not implemented for ITensor of type Diag (L)");
-    if(R.type() == ITensor::Diag)
-        Error("toMatrixProd not implemented for ITensor of type Diag (R)");
-    if(!L) Error("L null in toMatrixProd");
-    if(!R) Error("R null in toMatrixProd");
-#endif
-    const auto &Ldat = L.r_->v;
-    const auto &Rdat = R.r_->v;
+    ContractionPlan(const ITensor& L, const ITensor& R);
 
-    //Initially, assume both L & R are matrix-like
-    L_is_matrix = true, 
-    R_is_matrix = true;
+    ProductProps props;
+
+    //True if the data of L (R) can be used as
+    //a matrix without being permuted first
+    bool L_is_matrix,
+         R_is_matrix;
+
+    //Move the contracted indices of L (R) to the
+    //front, in matching order (see props.pl, props.pr)
+    TransposePlan tl,
+                  tr;
+
+    //Offsets into the data of L (R) of each combined value
+    //of its contracted indices (lcoff, rcoff) and of its
+    //uncontracted indices (looff, rooff), ordered as in the
+    //matrix product.
+    std::vector<long> lcoff,
+                      looff,
+                      rcoff,
+                      rooff;
+
+    //Memory held by the offset tables
+    size_t
+    tableBytes() const
+        {
+        return sizeof(long)*(lcoff.size()+looff.size()+rcoff.size()+rooff.size());
+        }
+
+    static std::shared_ptr<const ContractionPlan>
+    get(const ITensor& L, const ITensor& R);
+    };
 
-    if(props.nsamen != 0)
+//True if contracted indices are contiguous, in the
+//order given by P and all at the beginning or end
+bool static
+isMatrixLike(const IndexSet<Index>& is,
+             const SmallVector<bool,NMAX+1>& contracted,
+             const Permutation& P,
+             int cstart,
+             int nsamen)
+    {
+    if(nsamen == 0) return true;
+    for(int i = 0; i < nsamen; ++i) 
         {
-        //Check that contracted inds are contiguous
-        //and in the same order
-        for(int i = 0; i < props.nsamen; ++i) 
+        if(!contracted[cstart+i] || P.dest(cstart+i) != (i+1)) 
             {
-            if(!props.contractedL[props.lcstart+i] ||
-                props.pl.dest(props.lcstart+i) != (i+1)) 
-                {
-                L_is_matrix = false;
-                }
-            if(!props.contractedR[props.rcstart+i] ||
-                props.pr.dest(props.rcstart+i) != (i+1)) 
-                { 
-                R_is_matrix = false; 
-                }
+            return false;
+            }
+        }
+    return contracted[1] || contracted[is.rn()];
+    }
+
+//Offsets into the data of a tensor with indices is of
+//each combined value of the indices sent by P to the
+//positions first..last (the one sent to first varying fastest)
+vector<long> static
+indexOffsets(const IndexSet<Index>& is,
+             const Permutation& P,
+             int first,
+             int last)
+    {
+    const int rn = is.rn();
+    vector<long> stride(rn+1,1);
+    vector<int> slot(rn+1,0);
+    for(int j = 1; j <= rn; ++j)
+        {
+        if(j > 1) stride[j] = stride[j-1]*is.index(j-1).m();
+        slot[P.dest(j)] = j;
+        }
+    vector<long> off(1,0);
+    for(int p = first; p <= last; ++p)
+        {
+        const int j = slot[p];
+        const long m = is.index(j).m(),
+                   n = off.size();
+        off.resize(n*m);
+        for(long t = 1; t < m; ++t)
+        for(long q = 0; q < n; ++q)
+            {
+            off[t*n+q] = off[q]+t*stride[j];
             }
-        //Check that contracted inds are all at beginning or end of _indexn
-        if(!(props.contractedL[1] || props.contractedL[L.is_.rn()])) 
+        }
+    return off;
+    }
+
+ContractionPlan::
+ContractionPlan(const ITensor& L, const ITensor& R)
+    :
+    props(L,R),
+    L_is_matrix(isMatrixLike(L.is_,props.contractedL,props.pl,props.lcstart,props.nsamen)),
+    R_is_matrix(isMatrixLike(R.is_,props.contractedR,props.pr,props.rcstart,props.nsamen)),
+    tl(props.pl,L.is_),
+    tr(props.pr,R.is_)
+    { 
+    const int ns = props.nsamen;
+    lcoff = indexOffsets(L.is_,props.pl,1,ns);
+    looff = indexOffsets(L.is_,props.pl,ns+1,L.is_.rn());
+    rcoff = indexOffsets(R.is_,props.pr,1,ns);
+    rooff = indexOffsets(R.is_,props.pr,ns+1,R.is_.rn());
+    }
+
+//Shape of a product: the dimensions of the m!=1 indices of
+//both tensors and, for each index of L, the position of the 
+//index of R it is contracted with (0 if none). A plan only
+//depends on these, so tensors with different indices of the
+//same dimensions, contracted in the same pattern, share one
+//(as do the blocks of IQTensor products with equal sector sizes).
+using PlanKey = SmallVector<unsigned long long,2*NMAX+2>;
+
+struct PlanKeyHash
+    {
+    size_t
+    operator()(const PlanKey& key) const
+        {
+        size_t h = key.size();
+        for(auto k : key) 
             {
-            L_is_matrix = false; 
+            h ^= std::hash<unsigned long long>()(k) + 0x9e3779b9 + (h << 6) + (h >> 2);
             }
-        if(!(props.contractedR[1] || props.contractedR[R.is_.rn()]))
+        return h;
+        }
+    };
+
+struct PlanCache
+    {
+    std::unordered_map<PlanKey,std::shared_ptr<const ContractionPlan>,PlanKeyHash> plans;
+    size_t bytes = 0;
+
+    void
+    clear()
+        {
+        plans.clear();
+        bytes = 0;
+        }
+    };
+
+//Once the cache of a thread holds this many plans, or
+//offset tables taking up this many bytes, it is emptied
+//before adding another. Plans whose tables alone exceed
+//the byte limit (such as for the full contraction of a
+//large tensor) are not cached.
+const size_t MaxCachedPlans = 1024,
+             MaxCachedPlanBytes = 1ul << 26;
+
+PlanCache static&
+planCache()
+    {
+    thread_local PlanCache cache;
+    return cache;
+    }
+
+std::atomic<long> static plan_hits(0),
+                         plan_misses(0);
+
+std::shared_ptr<const ContractionPlan> ContractionPlan::
+get(const ITensor& L, const ITensor& R)
+    {
+    PlanKey key;
+    key.reserve(L.is_.rn()+R.is_.rn()+2);
+    key.push_back(L.is_.rn());
+    key.push_back(R.is_.rn());
+    for(int j = 1; j <= L.is_.rn(); ++j)
+        {
+        unsigned long long match = 0;
+        for(int k = 1; k <= R.is_.rn(); ++k)
             {
-            R_is_matrix = false; 
+            if(L.is_.index(j) == R.is_.index(k)) 
+                {
+                match = k;
+                break;
+                }
             }
+        key.push_back((match << 48) | static_cast<unsigned>(L.is_.index(j).m()));
+        }
+    for(int k = 1; k <= R.is_.rn(); ++k)
+        {
+        key.push_back(R.is_.index(k).m());
         }
 
-    if(!doReshape && (!L_is_matrix || !R_is_matrix))
+    auto& cache = planCache();
+    auto it = cache.plans.find(key);
+    if(it != cache.plans.end())
         {
-        return;
+        ++plan_hits;
+        return it->second;
+        }
+    ++plan_misses;
+    auto plan = std::make_shared<const ContractionPlan>(L,R);
+    const size_t bytes = plan->tableBytes();
+    if(bytes > MaxCachedPlanBytes) return plan;
+    if(cache.plans.size() >= MaxCachedPlans 
+       || cache.bytes+bytes > MaxCachedPlanBytes) 
+        {
+        cache.clear();
         }
+    cache.plans.emplace(std::move(key),plan);
+    cache.bytes += bytes;
+    return plan;
+    }
+
+ContractionCacheStats
+contractionCacheStats()
+    {
+    ContractionCacheStats stats;
+    stats.hits = plan_hits;
+    stats.misses = plan_misses;
+    return stats;
+    }
+
+void
+clearContractionCache()
+    {
+    planCache().clear();
+    plan_hits = 0;
+    plan_misses = 0;
+    }
 
-    if(L_is_matrix)  
+//Makes lref, the matrix form of the data Ldat of the
+//left tensor of plan, reshaping it into newLdat if needed
+void static
+leftMatrixRef(const Real* Ldat,
+              const ContractionPlan& plan,
+              std::vector<Real>& newLdat,
+              SimpleMatrixRef& lref)
+    {
+    const ProductProps& props = plan.props;
+    if(plan.L_is_matrix)  
         {
         if(props.contractedL[1]) 
             { 
-            lref = SimpleMatrixRef(Ldat.data(),props.odimL,props.cdim);
+            lref = SimpleMatrixRef(Ldat,props.odimL,props.cdim);
 #ifdef DEBUG
             if(not lref.readOnly()) Error("lref should be readOnly");
 #endif
@@ -1987,7 +2135,7 @@ toMatrixProd(const ITensor& L, const ITensor& R,
             }
         else 
             { 
-            lref = SimpleMatrixRef(Ldat.data(),props.cdim,props.odimL);
+            lref = SimpleMatrixRef(Ldat,props.cdim,props.odimL);
 #ifdef DEBUG
             if(not lref.readOnly()) Error("lref should be readOnly");
 #endif
@@ -1995,26 +2143,36 @@ toMatrixProd(const ITensor& L, const ITensor& R,
         }
     else //L not matrix, need to reshape to make lref
         {
-        reshape(props.pl,L.is_,L.r_->v,newLdat);
+        newLdat.resize(plan.tl.size());
+        plan.tl(Ldat,newLdat.data());
         lref = SimpleMatrixRef(newLdat.data(),props.odimL,props.cdim);
         lref.ApplyTrans(); 
 #ifdef DEBUG
             if(lref.readOnly()) Error("lref should not be readOnly");
 #endif
         }
+    }
 
-    if(R_is_matrix) 
+//Same as leftMatrixRef for the right tensor of plan
+void static
+rightMatrixRef(const Real* Rdat,
+               const ContractionPlan& plan,
+               std::vector<Real>& newRdat,
+               SimpleMatrixRef& rref)
+    {
+    const ProductProps& props = plan.props;
+    if(plan.R_is_matrix) 
         {
         if(props.contractedR[1]) 
             { 
-            rref = SimpleMatrixRef(Rdat.data(),props.odimR,props.cdim);
+            rref = SimpleMatrixRef(Rdat,props.odimR,props.cdim);
 #ifdef DEBUG
             if(not rref.readOnly()) Error("rref should be readOnly");
 #endif
             }
         else                    
             { 
-            rref = SimpleMatrixRef(Rdat.data(),props.cdim,props.odimR);
+            rref = SimpleMatrixRef(Rdat,props.cdim,props.odimR);
             rref.ApplyTrans(); 
 #ifdef DEBUG
             if(not rref.readOnly()) Error("rref should be readOnly");
@@ -2023,53 +2181,265 @@ toMatrixProd(const ITensor& L, const ITensor& R,
         }
     else //R not matrix, need to reshape to make rref
         {
-        reshape(props.pr,R.is_,R.r_->v,newRdat);
+        newRdat.resize(plan.tr.size());
+        plan.tr(Rdat,newRdat.data());
         rref = SimpleMatrixRef(newRdat.data(),props.odimR,props.cdim);
 #ifdef DEBUG
             if(rref.readOnly()) Error("rref should not be readOnly");
 #endif
         }
+    }
 
-#ifdef COLLECT_PRODSTATS
-    /*
-    if(L.is_.rn() > R.is_.rn()) 
-        {
-        ++(Prodstats::stats().global[std::make_pair(L.is_.rn(),R.is_.rn())]);
-        }
-    else 
+//Converts ITensor dats into MatrixRef's that can be multiplied as rref*lref
+//If doReshape is false and either tensor would need to
+//be reshaped first, lref and rref are left unset
+void 
+toMatrixProd(const ITensor& L, const ITensor& R, 
+             const ContractionPlan& plan,
+             std::vector<Real>& newLdat,
+             std::vector<Real>& newRdat,
+             SimpleMatrixRef& lref, SimpleMatrixRef& rref, 
+             bool doReshape)
+    {
+#ifdef DEBUG
+    if(L.type() == ITensor::Diag)
+        Error("toMatrixProd not implemented for ITensor of type Diag (L)");
+    if(R.type() == ITensor::Diag)
+        Error("toMatrixProd not implemented for ITensor of type Diag (R)");
+    if(!L) Error("L null in toMatrixProd");
+    if(!R) Error("R null in toMatrixProd");
+#endif
+    if(!doReshape && (!plan.L_is_matrix || !plan.R_is_matrix))
         {
-        ++(Prodstats::stats().global[std::make_pair(R.is_.rn(),L.is_.rn())]);
+        return;
         }
-    ++Prodstats::stats().total;
-    if(L_is_matrix) ++Prodstats::stats().did_matrix;
-    if(R_is_matrix) ++Prodstats::stats().did_matrix;
-    */
-#endif
+    leftMatrixRef(L.r_->data(),plan,newLdat,lref);
+    rightMatrixRef(R.r_->data(),plan,newRdat,rref);
     }
 
+//Depth (along the contracted indices) of the panels
+//used by panelMultiply and the largest number of
+//elements of each operand it packs at a time
+const long PanelDepth = 256,
+           PanelWorkspace = 1l << 20;
 
-//Non-contracting product: Cikj = Aij Bkj (no sum over j)
-ITensor& ITensor::
-operator/=(const ITensor& other)
+//
+// Computes the product of two Dense tensors as described
+// by plan, writing the odimL x odimR result into C
+// (column-major, so the uncontracted indices of L
+// vary fastest).
+//
+// The contracted indices are split into panels and the
+// uncontracted ones into blocks. Blocks of an operand
+// which is not matrix-like are gathered ("packed")
+// straight from its own layout into a small workspace,
+// using the offset tables of the plan, so the operand
+// is never permuted as a whole. Matrix-like operands
+// are handed to dgemm in place.
+//
+void static
+panelMultiply(const Real* Ldat,
+              const Real* Rdat,
+              const ContractionPlan& plan,
+              Real* C)
     {
-    if(type_ == Diag)
-        Error("Non-contracting product not yet implemented for type Diag (this)");
-    if(other.type_ == Diag)
-        Error("Non-contracting product not yet implemented for type Diag (other)");
+    const ProductProps& props = plan.props;
+    const long cdim = props.cdim,
+               odimL = props.odimL,
+               odimR = props.odimR;
+
+    const long kc = std::min(cdim,std::max(PanelDepth,PanelWorkspace/std::max(odimL,odimR))),
+               mc = std::min(odimL,std::max(1l,PanelWorkspace/kc)),
+               nc = std::min(odimR,std::max(1l,PanelWorkspace/kc));
+
+    //Where dgemm finds the block of an operand for contracted
+    //values k0..k0+nk-1 and uncontracted values o0..o0+no-1;
+    //kfast is true if the contracted values are adjacent in memory
+    struct Block
+        {
+        const Real* p;
+        long ld;
+        bool kfast;
+        };
+
+    auto getBlock = [cdim](const Real* dat, 
+                           bool is_matrix, 
+                           bool cfirst, 
+                           const vector<long>& coff, 
+                           const vector<long>& ooff, 
+                           long odim,
+                           long k0, long nk, 
+                           long o0, long no,
+                           vector<Real>& pack)
+        {
+        if(is_matrix)
+            {
+            if(cfirst) return Block{dat+k0+cdim*o0,cdim,true};
+            return Block{dat+o0+odim*k0,odim,false};
+            }
+        pack.resize(nk*no);
+        Real* pp = pack.data();
+        for(long o = 0; o < no; ++o)
+            {
+            const Real* po = dat+ooff[o0+o];
+            const long* pc = coff.data()+k0;
+            for(long k = 0; k < nk; ++k) pp[k] = po[pc[k]];
+            pp += nk;
+            }
+        return Block{pack.data(),nk,true};
+        };
 
-    if(this == &other)
+    vector<Real> lpack,
+                 rpack;
+    for(long k0 = 0; k0 < cdim; k0 += kc)
         {
-        ITensor cp_oth(other);
-        return operator/=(cp_oth);
+        const long nk = std::min(kc,cdim-k0);
+        const Real beta = (k0 == 0 ? 0 : 1);
+        for(long n0 = 0; n0 < odimR; n0 += nc)
+            {
+            const long nn = std::min(nc,odimR-n0);
+            const Block rb = getBlock(Rdat,plan.R_is_matrix,props.contractedR[1],
+                                      plan.rcoff,plan.rooff,odimR,k0,nk,n0,nn,rpack);
+            for(long m0 = 0; m0 < odimL; m0 += mc)
+                {
+                const long nm = std::min(mc,odimL-m0);
+                const Block lb = getBlock(Ldat,plan.L_is_matrix,props.contractedL[1],
+                                          plan.lcoff,plan.looff,odimL,k0,nk,m0,nm,lpack);
+                dgemm_wrapper(lb.kfast,!rb.kfast,nm,nn,nk,
+                              1,lb.p,lb.ld,rb.p,rb.ld,
+                              beta,C+m0+odimL*n0,odimL);
+                }
+            }
         }
+    }
 
-    if(scale_.isZero() || other.scale_.isZero())
+
+//Edge length of the blocks of the result computed
+//at a time by panelMultiplySingle
+const long SingleBlock = 1024;
+
+//Packs the block of dat (double or single precision) with
+//contracted values k0..k0+nk-1 and uncontracted values 
+//o0..o0+no-1 into res, in single precision
+template<typename T>
+void static
+packSingle(const T* dat, 
+           const vector<long>& coff, 
+           const vector<long>& ooff, 
+           long k0, long nk, 
+           long o0, long no,
+           vector<float>& res)
+    {
+    res.resize(nk*no);
+    float* pp = res.data();
+    for(long o = 0; o < no; ++o)
         {
-        scale_ = LogNumber(0);
-        return *this;
+        const T* po = dat+ooff[o0+o];
+        const long* pc = coff.data()+k0;
+        for(long k = 0; k < nk; ++k) pp[k] = po[pc[k]];
+        pp += nk;
         }
+    }
 
-    if(this->isComplex())
+//
+// Same as panelMultiply, but each block is converted
+// to single precision (if the operand is not already)
+// while being packed and multiplied by sgemm. The 
+// partial results for each panel are added up in 
+// double precision.
+//
+template<typename TL, typename TR>
+void static
+panelMultiplySingle(const TL* Ldat,
+                    const TR* Rdat,
+                    const ContractionPlan& plan,
+                    Real* C)
+    {
+    const ProductProps& props = plan.props;
+    const long cdim = props.cdim,
+               odimL = props.odimL,
+               odimR = props.odimR;
+
+    const long kc = std::min(cdim,std::max(PanelDepth,PanelWorkspace/SingleBlock)),
+               mc = std::min(odimL,SingleBlock),
+               nc = std::min(odimR,SingleBlock);
+
+    vector<float> lpack,
+                  rpack,
+                  cblock(mc*nc);
+    for(long k0 = 0; k0 < cdim; k0 += kc)
+        {
+        const long nk = std::min(kc,cdim-k0);
+        for(long n0 = 0; n0 < odimR; n0 += nc)
+            {
+            const long nn = std::min(nc,odimR-n0);
+            packSingle(Rdat,plan.rcoff,plan.rooff,k0,nk,n0,nn,rpack);
+            for(long m0 = 0; m0 < odimL; m0 += mc)
+                {
+                const long nm = std::min(mc,odimL-m0);
+                packSingle(Ldat,plan.lcoff,plan.looff,k0,nk,m0,nm,lpack);
+                sgemm_wrapper(true,false,nm,nn,nk,
+                              1,lpack.data(),nk,rpack.data(),nk,
+                              0,cblock.data(),nm);
+                for(long j = 0; j < nn; ++j)
+                    {
+                    Real* pc = C+m0+odimL*(n0+j);
+                    const float* pb = cblock.data()+nm*j;
+                    if(k0 == 0) std::copy(pb,pb+nm,pc);
+                    else        for(long i = 0; i < nm; ++i) pc[i] += pb[i];
+                    }
+                }
+            }
+        }
+    }
+
+//Calls panelMultiplySingle with the data of L and R
+//in the precision each is held in
+void static
+panelMultiplySingle(const ITDat& L,
+                    const ITDat& R,
+                    const ContractionPlan& plan,
+                    Real* C)
+    {
+    if(L.isSingle())
+        {
+        if(R.isSingle()) panelMultiplySingle(L.singleData(),R.singleData(),plan,C);
+        else             panelMultiplySingle(L.singleData(),R.data(),plan,C);
+        }
+    else
+        {
+        if(R.isSingle()) panelMultiplySingle(L.data(),R.singleData(),plan,C);
+        else             panelMultiplySingle(L.data(),R.data(),plan,C);
+        }
+    }
+
+//Non-contracting product: Cikj = Aij Bkj (no sum over j)
+ITensor& ITensor::
+operator/=(const ITensor& other)
+    {
+    if(type_ == Diag)
+        Error("Non-contracting product not yet implemented for type Diag (this)");
+    if(other.type_ == Diag)
+        Error("Non-contracting product not yet implemented for type Diag (other)");
+
+    if(this == &other)
+        {
+        ITensor cp_oth(other);
+        return operator/=(cp_oth);
+        }
+
+    if(scale_.isZero() || other.scale_.isZero())
+        {
+        scale_ = LogNumber(0);
+        return *this;
+        }
+
+    //Complex products with a scalar-like (all m==1) tensor
+    //are made of the real ones; otherwise the real and
+    //imaginary parts are handled in one pass below
+    const bool scalar_like = (is_.rn() == 0 || other.is_.rn() == 0);
+
+    if(scalar_like && this->isComplex())
         {
         if(other.isComplex())
             {
@@ -2113,7 +2483,7 @@ operator/=(const ITensor& other)
             }
         }
     else
-    if(other.isComplex())
+    if(scalar_like && other.isComplex())
         {
         //This real, other complex
         ITensor ri = operator/(*this,imagPart(other));
@@ -2129,7 +2499,7 @@ operator/=(const ITensor& other)
     if(other.is_.rn() == 0)
         {
         scale_ *= other.scale_;
-        scale_ *= other.r_->v.at(0);
+        scale_ *= other.r_->data()[0];
         for(int j = other.is_.rn()+1; j <= other.r(); ++j)
             {
             const Index& J = other.is_.index(j);
@@ -2141,7 +2511,7 @@ operator/=(const ITensor& other)
     else if(is_.rn() == 0)
         {
         scale_ *= other.scale_;
-        scale_ *= r_->v.at(0);
+        scale_ *= r_->v().at(0);
         r_ = other.r_;
         IndexSet<Index> new_is(other.is_);
         for(int j = 1; j <= r(); ++j) 
@@ -2154,21 +2524,20 @@ operator/=(const ITensor& other)
         return *this;
         }
 
-    ProductProps props(*this,other);
+    auto plan = ContractionPlan::get(*this,other);
+    const ProductProps& props = plan->props;
     SimpleMatrixRef lref, 
                     rref;
-    bool L_is_matrix = false,
-         R_is_matrix = false;
     vector<Real> newLdat,newRdat;
-    toMatrixProd(*this,other,newLdat,newRdat,props,lref,rref,L_is_matrix,R_is_matrix);
+    toMatrixProd(*this,other,*plan,newLdat,newRdat,lref,rref);
 
     const int ni = lref.Ncols(), 
               nj = lref.Nrows(), 
               nk = rref.Nrows();
 
     auto nsize = ni*nj*nk;
-    auto np = make_shared<ITDat>(nsize,0);
-    auto &thisdat = np->v; 
+    auto np = make_shared<ITDat>(nsize,ITDat::noInit);
+    auto &thisdat = np->v(); 
     for(int j = 1; j <= nj; ++j) 
     for(int k = 1; k <= nk; ++k) 
     for(int i = 1; i <= ni; ++i)
@@ -2176,7 +2545,45 @@ operator/=(const ITensor& other)
         thisdat[((j-1)*nk+k-1)*ni+i-1] =  rref(k,j) * lref(j,i); 
         }
 
+    //Imaginary part, reusing the plan (and any reshaped
+    //real part) rather than forming the four real products
+    shared_ptr<ITDat> nip;
+    const bool lcplx = this->isComplex(),
+               rcplx = other.isComplex();
+    if(lcplx || rcplx)
+        {
+        SimpleMatrixRef liref, 
+                        riref;
+        vector<Real> newLidat,newRidat;
+        if(lcplx) leftMatrixRef(i_->data(),*plan,newLidat,liref);
+        if(rcplx) rightMatrixRef(other.i_->data(),*plan,newRidat,riref);
+
+        nip = make_shared<ITDat>(nsize,ITDat::noInit);
+        auto &idat = nip->v(); 
+        for(int j = 1; j <= nj; ++j) 
+        for(int k = 1; k <= nk; ++k) 
+        for(int i = 1; i <= ni; ++i)
+            { 
+            const int n = ((j-1)*nk+k-1)*ni+i-1;
+            if(lcplx && rcplx)
+                {
+                thisdat[n] -= riref(k,j) * liref(j,i);
+                idat[n] = rref(k,j) * liref(j,i) + riref(k,j) * lref(j,i);
+                }
+            else
+            if(lcplx)
+                {
+                idat[n] = rref(k,j) * liref(j,i);
+                }
+            else
+                {
+                idat[n] = riref(k,j) * lref(j,i);
+                }
+            }
+        }
+
     r_.swap(np);
+    i_.swap(nip);
 
     IndexSet<Index> new_index;
 
@@ -2216,96 +2623,163 @@ operator/=(const ITensor& other)
     }
 
 
+//
+// Product of two Dense tensors as described by plan,
+// for tensors too small for dgemm to pay off. Writes
+// the odimL x odimR result into C (as panelMultiply).
+//
+// L is first gathered into a contiguous odimL x cdim
+// matrix (unless its data already is one), so that the
+// innermost loop runs over contiguous memory of both
+// it and C and can be vectorized.
+//
 void static
-directMultiply(const ITensor& L,
-               const ITensor& R, 
-               ProductProps& props, 
-               vector<Real>& newdat,
-               IndexSet<Index>& new_index)
+smallMultiply(const Real* Ldat,
+              const Real* Rdat,
+              const ContractionPlan& plan,
+              Real* C)
     {
-    Counter u,  //uncontracted indices
-            c;  //contracted indices
-
-    const int zero = 0;
+    const ProductProps& props = plan.props;
+    const long cdim = props.cdim,
+               odimL = props.odimL,
+               odimR = props.odimR;
+    const auto &lcoff = plan.lcoff,
+               &looff = plan.looff,
+               &rcoff = plan.rcoff,
+               &rooff = plan.rooff;
+
+    ITDat::Storage Lt;
+    const Real* pLt = Ldat;
+    if(!(plan.L_is_matrix && !props.contractedL[1]))
+        {
+        Lt.resize(odimL*cdim);
+        for(long c = 0; c < cdim; ++c)
+            {
+            Real* pl = Lt.data()+odimL*c;
+            const Real* ps = Ldat+lcoff[c];
+            for(long o = 0; o < odimL; ++o) pl[o] = ps[looff[o]];
+            }
+        pLt = Lt.data();
+        }
 
-    const int* li[NMAX];
-    const int* ri[NMAX];
-    for(int n = 0; n < NMAX; ++n)
+    for(long o = 0; o < odimR; ++o)
         {
-        li[n] = &zero;
-        ri[n] = &zero;
+        Real* pc = C+odimL*o;
+        std::fill(pc,pc+odimL,0.);
+        const Real* pr = Rdat+rooff[o];
+        for(long c = 0; c < cdim; ++c)
+            {
+            const Real r = pr[rcoff[c]];
+            const Real* pl = pLt+odimL*c;
+            for(long i = 0; i < odimL; ++i) pc[i] += r*pl[i];
+            }
         }
+    }
+
+//
+// Choice between smallMultiply and the dgemm based
+// kernels. Shapes are grouped into classes by the
+// binary logarithms of odimL, cdim and odimR; each
+// class can be set to use one kind of kernel, by
+// timing both (autotuning) or from a tuning file.
+// Classes not set use the kernel picked by the
+// default rule in ITensor::operator*=.
+//
+enum TuneChoice : unsigned char
+    {
+    Untuned = 0,
+    UseSmall = 1,
+    UseGemm = 2
+    };
 
-    array<int,NMAX> nl,
-                    nr;
-    std::fill(nl.begin(),nl.end(),0);
-    std::fill(nr.begin(),nr.end(),0);
+const int TuneBits = 16;
 
+std::atomic<unsigned char> static tune_table[TuneBits*TuneBits*TuneBits];
 
-    const IndexSet<Index>& Lis = L.indices();
-    const IndexSet<Index>& Ris = R.indices();
+std::atomic<bool> static autotune_on(false);
 
-    const int trn = Lis.rn();
-    const int orn = Ris.rn();
+int static
+log2Class(long n)
+    {
+    int b = 0;
+    while((n >> (b+1)) != 0 && b < TuneBits-1) ++b;
+    return b;
+    }
 
-    for(int j = 0; j < trn; ++j)
-        {
-        if(!props.contractedL[j+1])
+int static
+shapeClass(const ProductProps& props)
+    {
+    return (log2Class(props.odimL)*TuneBits+log2Class(props.cdim))*TuneBits
+           +log2Class(props.odimR);
+    }
+
+void
+autotuneContraction(bool on)
+    {
+    autotune_on = on;
+    }
+
+void
+clearContractionTuning()
+    {
+    for(auto& t : tune_table) t = Untuned;
+    }
+
+void
+readContractionTuning(const std::string& fname)
+    {
+    std::ifstream f(fname);
+    if(!f.good()) Error("Couldn't open tuning file " + fname);
+    int l = 0,
+        c = 0,
+        r = 0;
+    std::string kernel;
+    while(f >> l >> c >> r >> kernel)
+        {
+        if(l < 0 || l >= TuneBits || c < 0 || c >= TuneBits || r < 0 || r >= TuneBits)
             {
-            ++u.rn; //(++u.r);
-            u.n[u.rn] = Lis[j].m();
-            li[j] = &(u.i[u.rn]);
-            new_index.addindex(Lis[j]);
+            Error("Shape class out of range in tuning file " + fname);
             }
-        else
+        if(kernel != "small" && kernel != "gemm")
             {
-            for(int k = 0; k < orn; ++k)
-                {
-                if(Lis[j] == Ris[k])
-                    {
-                    ++c.rn; //(++c.r);
-                    c.n[c.rn] = Lis[j].m();
-                    li[j] = &(c.i[c.rn]);
-                    ri[k] = &(c.i[c.rn]);
-                    break;
-                    }
-                }
+            Error("Unknown kernel \"" + kernel + "\" in tuning file " + fname);
             }
-        nl[j] = Lis[j].m();
+        tune_table[(l*TuneBits+c)*TuneBits+r] = (kernel == "small" ? UseSmall : UseGemm);
         }
+    }
 
-    for(int j = 0; j < orn; ++j)
+void
+writeContractionTuning(const std::string& fname)
+    {
+    std::ofstream f(fname);
+    if(!f.good()) Error("Couldn't open tuning file " + fname);
+    f << "# log2(odimL) log2(cdim) log2(odimR) kernel\n";
+    for(int l = 0; l < TuneBits; ++l)
+    for(int c = 0; c < TuneBits; ++c)
+    for(int r = 0; r < TuneBits; ++r)
         {
-        if(!props.contractedR[j+1])
-            {
-            ++u.rn; //(++u.r);
-            u.n[u.rn] = Ris[j].m();
-            ri[j] = &(u.i[u.rn]);
-            new_index.addindex(Ris[j]);
-            }
-        nr[j] = Ris[j].m();
+        const auto t = tune_table[(l*TuneBits+c)*TuneBits+r].load();
+        if(t == Untuned) continue;
+        f << l << " " << c << " " << r << " " << (t == UseSmall ? "small" : "gemm") << "\n";
         }
+    }
 
-    newdat.resize(props.odimL*props.odimR);
-
-    const Real* pL = L.datStart();
-    const Real* pR = R.datStart();
-    Real* pN = newdat.data();
-
-    for(; u.notDone(); ++u)
+//Returns the shortest of several timings of f
+template<typename Func>
+double static
+bestTime(Func&& f, int nrep)
+    {
+    using Clock = std::chrono::steady_clock;
+    double best = -1;
+    for(int n = 0; n < nrep; ++n)
         {
-        Real& val = pN[u.ind];
-        val = 0;
-        for(c.reset(); c.notDone(); ++c)
-            {
-            val += pL[((((((((*li[7])*nl[6]+*li[6])*nl[5]+*li[5])*nl[4]+*li[4])
-                      *nl[3]+*li[3])*nl[2]+*li[2])*nl[1]+*li[1])*nl[0]+*li[0])]
-                 * pR[((((((((*ri[7])*nr[6]+*ri[6])*nr[5]+*ri[5])*nr[4]+*ri[4])
-                      *nr[3]+*ri[3])*nr[2]+*ri[2])*nr[1]+*ri[1])*nr[0]+*ri[0])];
-            }
+        const auto t0 = Clock::now();
+        f();
+        const double t = std::chrono::duration<double>(Clock::now()-t0).count();
+        if(best < 0 || t < best) best = t;
         }
-
-    } //directMultiply
+    return best;
+    }
 
 
 void
@@ -2332,14 +2806,8 @@ contractDiagDense(const ITensor& S, const ITensor& T, ITensor& res)
     //The ri pointer does the same
     //but for res
     const int zero = 0;
-    array<const int*,NMAX+1> ti,
-                             ri; 
-
-    for(int n = 0; n <= NMAX; ++n)
-        {
-        ti[n] = &zero;
-        ri[n] = &zero;
-        }
+    IndPtrs ti(std::max(T.r(),NMAX)+1,&zero),
+            ri(std::max(S.r()+T.r(),NMAX)+1,&zero); 
 
     //Index that will loop over 
     //the diagonal elems of S
@@ -2348,7 +2816,7 @@ contractDiagDense(const ITensor& S, const ITensor& T, ITensor& res)
 
     //Create a Counter that only loops
     //over the free Indices of T
-    Counter tc;
+    Counter tc(T.r());
 
     res.is_.clear();
     int alloc_size = 1;
@@ -2362,10 +2830,8 @@ contractDiagDense(const ITensor& S, const ITensor& T, ITensor& res)
     //
     // (scon is similar but for S)
     //
-    array<int,NMAX+1> tcon,
-                      scon;
-    tcon.fill(0);
-    scon.fill(0);
+    SmallVector<int,NMAX+1> tcon(T.r()+1,0),
+                            scon(S.r()+1,0);
     int ncon = 0; //number contracted
 
     //Analyze contracted Indices
@@ -2453,7 +2919,7 @@ contractDiagDense(const ITensor& S, const ITensor& T, ITensor& res)
         {
         res.r_ = T.r_;
         res.i_ = T.i_;
-        res *= S.r_->v.at(0);
+        res *= S.r_->data()[0];
         return;
         }
 
@@ -2464,33 +2930,18 @@ contractDiagDense(const ITensor& S, const ITensor& T, ITensor& res)
         }
     else
         {
-        res.r_->v.assign(alloc_size,0);
-        }
-
-    //Finish initting Counter tc
-    for(int k = tc.rn+1; k <= NMAX; ++k)
-        {
-        tc.n[k] = 1;
+        res.r_->v().assign(alloc_size,0);
         }
 
-
-    const auto &Tdat = T.r_->v;
-    auto &resdat = res.r_->v;
+    const Real* Tdat = T.r_->data();
+    auto &resdat = res.r_->v();
 
     if(res_has_Sind)
         {
         for(tc.reset(); tc.notDone(); ++tc)
         for(diag_ind = 0; diag_ind < dsize; ++diag_ind)
             {
-            resdat[_ind(res.is_,*ri[1],*ri[2],
-                                *ri[3],*ri[4],
-                                *ri[5],*ri[6],
-                                *ri[7],*ri[8])]
-             = S.r_->v[diag_ind] 
-               * Tdat[_ind(T.is_,*ti[1],*ti[2],
-                                 *ti[3],*ti[4],
-                                 *ti[5],*ti[6],
-                                 *ti[7],*ti[8])];
+            resdat[_ind(res.is_,ri)] = S.r_->data()[diag_ind] * Tdat[_ind(T.is_,ti)];
             }
         }
     else
@@ -2500,18 +2951,9 @@ contractDiagDense(const ITensor& S, const ITensor& T, ITensor& res)
             Real val = 0;
             for(diag_ind = 0; diag_ind < dsize; ++diag_ind)
                 {
-                val +=
-                S.r_->v[diag_ind] 
-                * Tdat[_ind(T.is_,*ti[1],*ti[2],
-                                  *ti[3],*ti[4],
-                                  *ti[5],*ti[6],
-                                  *ti[7],*ti[8])];
+                val += S.r_->data()[diag_ind] * Tdat[_ind(T.is_,ti)];
                 }
-            resdat[_ind(res.is_,*ri[1],*ri[2],
-                                *ri[3],*ri[4],
-                                *ri[5],*ri[6],
-                                *ri[7],*ri[8])]
-            = val;
+            resdat[_ind(res.is_,ri)] = val;
             }
         }
 
@@ -2535,10 +2977,10 @@ contractDiagDiag(const ITensor& A, const ITensor& B, ITensor& res)
         {
         res.type_ = ITensor::Diag;
         res.allocate();
-        auto& rdat = res.r_->v;
-        const auto& Adat = A.r_->v;
-        const auto& Bdat = B.r_->v;
-        rdat = Adat;
+        auto& rdat = res.r_->v();
+        const Real* Adat = A.r_->data();
+        const Real* Bdat = B.r_->data();
+        rdat.assign(Adat,Adat+A.r_->size());
         for(int j = 0; j < int(rdat.size()); ++j)
             {
             rdat[j] *= Bdat[j];
@@ -2554,6 +2996,163 @@ contractDiagDiag(const ITensor& A, const ITensor& B, ITensor& res)
 
     } // contractDiagDiag
 
+//
+// Contracts two Dense ITensors, at least one of them
+// complex, with a single pass of matrix multiplication:
+//
+// - if both are complex, their data are packed (and permuted
+//   so that contracted indices come first) into interleaved
+//   std::complex buffers and multiplied with one zgemm call
+// - if only one is complex, the real operand is permuted once 
+//   and multiplied into the real and imaginary parts of the 
+//   complex operand, without promoting it to complex
+//
+// Index order of res follows operator*=: uncontracted m!=1
+// indices of A, then of B, then uncontracted m==1 indices.
+//
+void
+contractComplexDense(const ITensor& A, const ITensor& B, ITensor& res)
+    {
+#ifdef DEBUG
+    if(!(A.type_ == ITensor::Dense && B.type_ == ITensor::Dense))
+        Error("contractComplexDense assumes both arguments Dense");
+    if(A.is_.rn() == 0 || B.is_.rn() == 0)
+        Error("contractComplexDense requires m!=1 indices");
+#endif
+    using Cplx = std::complex<Real>;
+
+    auto plan = ContractionPlan::get(A,B);
+    const ProductProps& props = plan->props;
+
+    IndexSet<Index> new_index;
+    for(int j = 0; j < A.is_.rn(); ++j)
+        if(!props.contractedL[j+1]) 
+            new_index.addindex(A.is_[j]);
+    for(int j = 0; j < B.is_.rn(); ++j)
+        if(!props.contractedR[j+1]) 
+            new_index.addindex(B.is_[j]);
+    for(int k = A.is_.rn(); k < A.r(); ++k)
+        if(!hasindex(B,A.is_[k])) 
+            new_index.addindex(A.is_[k]);
+    for(int k = B.is_.rn(); k < B.r(); ++k)
+        if(!hasindex(A,B.is_[k])) 
+            new_index.addindex(B.is_[k]);
+
+    const long cdim = props.cdim,
+               odimA = props.odimL,
+               odimB = props.odimR,
+               nsize = odimA*odimB;
+
+    //Plans bringing contracted indices to the front
+    //(in matching order) for A and B
+    const TransposePlan &PA = plan->tl,
+                        &PB = plan->tr;
+
+    auto nr = make_shared<ITDat>(nsize,ITDat::noInit),
+         ni = make_shared<ITDat>(nsize,ITDat::noInit);
+
+    if(A.isComplex() && B.isComplex())
+        {
+        auto packComplex = [](const TransposePlan& P, const ITensor& T, vector<Cplx>& z)
+            {
+            z.resize(P.size());
+            const Real *re = T.r_->data(),
+                       *im = T.i_->data();
+            Cplx* pz = z.data();
+            P.forEach([re,im,pz](long s, long d) { pz[d] = Cplx(re[s],im[s]); },
+                      Global::nthread());
+            };
+        vector<Cplx> zA,
+                     zB,
+                     zC(nsize);
+        packComplex(PA,A,zA);
+        packComplex(PB,B,zB);
+        zgemm_wrapper(true,false,odimA,odimB,cdim,1,zA.data(),zB.data(),0,zC.data());
+        Real *pr = nr->data(),
+             *pi = ni->data();
+        for(long n = 0; n < nsize; ++n)
+            {
+            pr[n] = zC[n].real();
+            pi[n] = zC[n].imag();
+            }
+        }
+    else
+        {
+        //Each real part can be used in place
+        //if its plan is a straight copy
+        auto realData = [](const TransposePlan& P, const shared_ptr<ITDat>& d, vector<Real>& store)
+            -> const Real*
+            {
+            if(P.isCopy()) return d->data();
+            store.resize(P.size());
+            P(d->data(),store.data());
+            return store.data();
+            };
+        vector<Real> sAr,sAi,
+                     sBr,sBi;
+        const Real *Ar = realData(PA,A.r_,sAr),
+                   *Br = realData(PB,B.r_,sBr);
+        if(A.isComplex())
+            {
+            const Real *Ai = realData(PA,A.i_,sAi);
+            dgemm_wrapper(true,false,odimA,odimB,cdim,1,Ar,Br,0,nr->data());
+            dgemm_wrapper(true,false,odimA,odimB,cdim,1,Ai,Br,0,ni->data());
+            }
+        else
+            {
+            const Real *Bi = realData(PB,B.i_,sBi);
+            dgemm_wrapper(true,false,odimA,odimB,cdim,1,Ar,Br,0,nr->data());
+            dgemm_wrapper(true,false,odimA,odimB,cdim,1,Ar,Bi,0,ni->data());
+            }
+        }
+
+    res.type_ = ITensor::Dense;
+    res.r_.swap(nr);
+    res.i_.swap(ni);
+    res.is_.swap(new_index);
+    res.scale_ = A.scale_;
+    res.scale_ *= B.scale_;
+    res.scaleOutNorm();
+
+    } // contractComplexDense
+
+
+//Adds to inds the m==1 indices of L and R which
+//are not shared by both, and so remain on their product
+void static
+addM1Indices(const ITensor& L, const ITensor& R, IndexSet<Index>& inds)
+    {
+    const IndexSet<Index>& Lis = L.indices();
+    const IndexSet<Index>& Ris = R.indices();
+    for(int k = Lis.rn(); k < Lis.r(); ++k)
+        {
+        if(!hasindex(R,Lis[k])) inds.addindex(Lis[k]);
+        }
+    for(int j = Ris.rn(); j < Ris.r(); ++j)
+        {
+        if(!hasindex(L,Ris[j])) inds.addindex(Ris[j]);
+        }
+    }
+
+//Indices of the product of L and R (with m!=1 indices 
+//of both) whose contraction is described by props
+IndexSet<Index> static
+productIndices(const ITensor& L, const ITensor& R, const ProductProps& props)
+    {
+    IndexSet<Index> res;
+    const IndexSet<Index>& Lis = L.indices();
+    const IndexSet<Index>& Ris = R.indices();
+    for(int j = 0; j < Lis.rn(); ++j)
+        {
+        if(!props.contractedL[j+1]) res.addindex(Lis[j]);
+        }
+    for(int j = 0; j < Ris.rn(); ++j)
+        {
+        if(!props.contractedR[j+1]) res.addindex(Ris[j]);
+        }
+    addM1Indices(L,R,res);
+    return res;
+    }
 
 ITensor& ITensor::
 operator*=(const ITensor& other)
@@ -2575,6 +3174,16 @@ operator*=(const ITensor& other)
         }
         */
 
+    if((this->isComplex() || other.isComplex())
+       && type_ == Dense && other.type_ == Dense
+       && is_.rn() > 0 && other.is_.rn() > 0)
+        {
+        ITensor res;
+        contractComplexDense(*this,other,res);
+        this->swap(res);
+        return *this;
+        }
+
     if(this->isComplex())
         {
         if(other.isComplex())
@@ -2651,135 +3260,108 @@ operator*=(const ITensor& other)
         return *this;
         }
     
-    //These hold  regular new indices and the m==1 indices that appear in the result
-    IndexSet<Index> new_index;
-
-    array<const Index*,NMAX+1> new_index1_;
-    int nr1_ = 0;
-
-    //
-    //Handle m==1 Indices
-    //
-    for(int k = is_.rn(); k < this->r(); ++k)
-        {
-        const Index& K = is_[k];
-        if(!hasindex(other,K))
-            new_index1_[++nr1_] = &K;
-        }
-
-    for(int j = other.is_.rn(); j < other.r(); ++j)
-        {
-        const Index& J = other.is_[j];
-        if(!hasindex(*this,J))
-            new_index1_[++nr1_] = &J;
-        }
-
     //
     //Special cases when one of the tensors
     //has only m==1 indices (effectively a scalar)
     //
     if(other.is_.rn() == 0)
         {
-        scale_ *= other.scale_;
-        scale_ *= other.r_->v.at(0);
-#ifdef DEBUG
-        if((is_.rn()+nr1_) > NMAX) 
-            {
-            println("new r_ would be = ",is_.r());
-            Error("ITensor::operator*=: too many uncontracted indices in product (max is 8)");
-            }
-#endif
+        IndexSet<Index> new_index;
+        //Keep current m!=1 indices, overwrite m==1 indices
         for(int j = 1; j <= is_.rn(); ++j)
             new_index.addindex(is_.index(j));
-        //Keep current m!=1 indices, overwrite m==1 indices
-        for(int j = 1; j <= nr1_; ++j) 
-            new_index.addindex( *(new_index1_[j]) );
+        addM1Indices(*this,other,new_index);
+        scale_ *= other.scale_;
+        scale_ *= other.r_->data()[0];
         is_.swap(new_index);
         return *this;
         }
     else if(is_.rn() == 0)
         {
-        scale_ *= other.scale_;
-        scale_ *= r_->v.at(0);
-        r_ = other.r_;
-#ifdef DEBUG
-        if((is_.rn()+nr1_) > NMAX) 
-            {
-            println("new r_ would be = ",is_.r());
-            Error("ITensor::operator*=: too many uncontracted indices in product (max is 8)");
-            }
-#endif
+        IndexSet<Index> new_index;
         for(int j = 1; j <= other.is_.rn(); ++j) 
             new_index.addindex( other.is_.index(j) );
-        for(int j = 1; j <= nr1_; ++j) 
-            new_index.addindex( *(new_index1_[j]) );
+        addM1Indices(*this,other,new_index);
+        scale_ *= other.scale_;
+        scale_ *= r_->v().at(0);
+        r_ = other.r_;
         is_.swap(new_index);
         return *this;
         }
 
-    ProductProps props(*this,other);
-
-#ifdef DEBUG
-    if((is_.rn() + other.is_.rn() - 2*props.nsamen + nr1_) > NMAX) 
-        {
-        Print(*this);
-        Print(other);
-        Print(props.nsamen);
-        println("new m==1 indices");
-        for(int j = 1; j <= nr1_; ++j) println(*(new_index1_.at(j)));
-        Error("ITensor::operator*=: too many uncontracted indices in product (max is 8)");
-        }
-#endif
+    auto plan = ContractionPlan::get(*this,other);
+    const ProductProps& props = plan->props;
 
     //Using a long int here because int was overflowing
     long int complexity = props.odimL;
     complexity *= props.cdim;
     complexity *= props.odimR;
-    
-    const
-    bool do_matrix_multiply = (complexity > 1000);
 
-    SimpleMatrixRef lref, 
-                    rref;
-    bool L_is_matrix = false,
-         R_is_matrix = false;
-    vector<Real> Lrs_store,Rrs_store; //storage in case reshape is needed
-    toMatrixProd(*this,other,Lrs_store,Rrs_store,props,lref,rref,
-                 L_is_matrix,R_is_matrix,do_matrix_multiply);
+    long nsize = props.odimL;
+    nsize *= props.odimR;
+    auto np = make_shared<ITDat>(nsize,ITDat::noInit);
 
-    if(do_matrix_multiply || (L_is_matrix && R_is_matrix))
+    auto gemmProduct = [this,&other,&plan](Real* C)
         {
-        //DO_IF_PS(++Prodstats::stats().c2;)
-
-        //Do the matrix multiplication
-        auto nsize = rref.Nrows()*lref.Ncols();
-        auto np = make_shared<ITDat>(nsize,0);
-
-        SimpleMatrixRef nref(np->data(),rref.Nrows(),lref.Ncols());
-        mult_add(rref,lref,nref,0);
+        if(plan->L_is_matrix && plan->R_is_matrix)
+            {
+            //Both data can be multiplied in place
+            SimpleMatrixRef lref, 
+                            rref;
+            vector<Real> Lrs_store,Rrs_store; //unused, no reshape needed
+            toMatrixProd(*this,other,*plan,Lrs_store,Rrs_store,lref,rref);
+            SimpleMatrixRef nref(C,rref.Nrows(),lref.Ncols());
+            mult_add(rref,lref,nref,0);
+            }
+        else
+            {
+            //Pack blocks of the operands which are not
+            //matrix-like straight from their data
+            panelMultiply(r_->data(),other.r_->data(),*plan,C);
+            }
+        };
+    auto smallProduct = [this,&other,&plan](Real* C)
+        {
+        smallMultiply(r_->data(),other.r_->data(),*plan,C);
+        };
 
-        r_.swap(np);
-        
-        //Handle m!=1 indices
-        for(int j = 0; j < this->is_.rn(); ++j)
-            if(!props.contractedL[j+1]) 
-                new_index.addindex( is_[j] );
-        for(int j = 0; j < other.is_.rn(); ++j)
-            if(!props.contractedR[j+1]) 
-                new_index.addindex( other.is_[j] );
+    const int sclass = shapeClass(props);
+    auto choice = TuneChoice(tune_table[sclass].load());
+    if(r_->isSingle() || other.r_->isSingle())
+        {
+        //Either operand is held in single precision: multiply
+        //in single precision (accumulating in double) and keep
+        //the result in single precision too
+        panelMultiplySingle(*r_,*other.r_,*plan,np->data());
+        np->makeSingle();
         }
     else
+    if(choice == Untuned && autotune_on)
         {
-        auto np = make_shared<ITDat>();
-        directMultiply(*this,other,props,np->v,new_index);
-        r_.swap(np);
+        //Time both kernels on this product, the 
+        //result is left in np by either of them
+        const int nrep = std::max(1l,std::min(20l,1000000l/(complexity+1)));
+        Real* C = np->data();
+        const double ts = bestTime([&]() { smallProduct(C); },nrep),
+                     tg = bestTime([&]() { gemmProduct(C); },nrep);
+        choice = (ts < tg ? UseSmall : UseGemm);
+        tune_table[sclass] = choice;
+        }
+    else
+        {
+        if(choice == Untuned)
+            {
+            const bool use_gemm = (complexity > 1000) 
+                                  || (plan->L_is_matrix && plan->R_is_matrix);
+            choice = (use_gemm ? UseGemm : UseSmall);
+            }
+        if(choice == UseGemm) gemmProduct(np->data());
+        else                  smallProduct(np->data());
         }
 
-
-    //Put in m==1 indices
-    for(int j = 1; j <= nr1_; ++j) 
-        new_index.addindex( *(new_index1_.at(j)) );
-
+    r_.swap(np);
+        
+    IndexSet<Index> new_index = productIndices(*this,other,props);
     is_.swap(new_index);
 
     scale_ *= other.scale_;
@@ -2789,6 +3371,93 @@ operator*=(const ITensor& other)
     return *this;
     } //ITensor::operator*=(ITensor)
 
+vector<bool>
+multiplyBatch(const vector<std::pair<const ITensor*,const ITensor*>>& prods,
+              const std::function<void(size_t,ITensor&)>& done)
+    {
+    vector<bool> batched(prods.size(),false);
+
+    //Shape of the GEMM call of a product: transposes of 
+    //the two operands, m, n, k and the leading dimensions
+    using GemmShape = std::array<long,7>;
+    std::map<GemmShape,vector<size_t>> groups;
+    vector<const Real*> A(prods.size()),
+                        B(prods.size());
+    vector<std::shared_ptr<const ContractionPlan>> plans(prods.size());
+
+    for(size_t p = 0; p < prods.size(); ++p)
+        {
+        const ITensor& L = *prods[p].first;
+        const ITensor& R = *prods[p].second;
+        const bool dense = L.type_ == ITensor::Dense && R.type_ == ITensor::Dense
+                        && !L.isComplex() && !R.isComplex()
+                        && L.is_.rn() > 0 && R.is_.rn() > 0
+                        && !L.r_->isSingle() && !R.r_->isSingle();
+        if(!dense) continue;
+        auto plan = ContractionPlan::get(L,R);
+        //Products needing permuting are left to the caller
+        if(!plan->L_is_matrix || !plan->R_is_matrix) continue;
+
+        //Same call as made by mult_add in ITensor::operator*=
+        SimpleMatrixRef lref,
+                        rref;
+        vector<Real> Lrs_store,Rrs_store; //unused, no reshape needed
+        toMatrixProd(L,R,*plan,Lrs_store,Rrs_store,lref,rref,false);
+        const GemmShape shape = {{ lref.transpose(), rref.transpose(),
+                                   lref.Ncols(), rref.Nrows(), lref.Nrows(),
+                                   lref.rowStride(), rref.rowStride() }};
+        groups[shape].push_back(p);
+        A[p] = lref.store();
+        B[p] = rref.store();
+        plans[p] = plan;
+        batched[p] = true;
+        }
+
+    //One batched call per shape, so that only the
+    //products of one group are held at a time
+    for(const auto& G : groups)
+        {
+        const GemmShape& sh = G.first;
+        const vector<size_t>& members = G.second;
+
+        vector<ITensor> P(members.size());
+        vector<const Real*> Ab,
+                            Bb;
+        vector<Real*> Cb;
+        for(size_t e = 0; e < members.size(); ++e)
+            {
+            const size_t p = members[e];
+            const ITensor& L = *prods[p].first;
+            const ITensor& R = *prods[p].second;
+            ITensor& T = P[e];
+            T.type_ = ITensor::Dense;
+            T.is_ = productIndices(L,R,plans[p]->props);
+            T.r_ = make_shared<ITDat>(sh[2]*sh[3],ITDat::noInit);
+            T.scale_ = L.scale_;
+            T.scale_ *= R.scale_;
+            Ab.push_back(A[p]);
+            Bb.push_back(B[p]);
+            Cb.push_back(T.r_->data());
+            }
+
+        const bool ta = sh[0],
+                   tb = sh[1];
+        LAPACK_INT m = sh[2], n = sh[3], k = sh[4], 
+                   lda = sh[5], ldb = sh[6], 
+                   gsize = members.size();
+        dgemm_batch_wrapper(1,&ta,&tb,&m,&n,&k,&lda,&ldb,&m,&gsize,
+                            Ab.data(),Bb.data(),Cb.data());
+
+        for(size_t e = 0; e < members.size(); ++e)
+            {
+            P[e].scaleOutNorm();
+            done(members[e],P[e]);
+            }
+        }
+
+    return batched;
+    }
+
 
 bool static
 checkSameIndOrder(const IndexSet<Index> is1,
@@ -2803,6 +3472,112 @@ checkSameIndOrder(const IndexSet<Index> is1,
     }
 
 
+//z += b*x, using BLAS for double precision x
+void static
+addScaled(long size, Real b, const Real* x, Real* z)
+    {
+    daxpy_wrapper(size,b,x,1,z,1);
+    }
+void static
+addScaled(long size, Real b, const float* x, Real* z)
+    {
+    for(long i = 0; i < size; ++i) z[i] += b*x[i];
+    }
+
+//Sets z[d] = a*y[d] + b*x[s] for every element, where (s,d) 
+//runs over the pairs given by plan (or s == d if plan is null).
+//Makes a single pass reading x in its own layout; z may be y.
+//If a == 0, y is not read; if x is null it is taken to be zero.
+//x and y may be held in double or single precision.
+template<typename TY, typename TX>
+void static
+axpby(long size,
+      Real a,
+      const TY* y,
+      Real b,
+      const TX* x,
+      Real* z,
+      const TransposePlan* plan)
+    {
+    const bool inplace = (static_cast<const void*>(z) == static_cast<const void*>(y));
+    if(!x)
+        {
+        if(a == 0) std::fill(z,z+size,0.);
+        else if(a != 1 || !inplace) 
+            {
+            for(long i = 0; i < size; ++i) z[i] = a*y[i];
+            }
+        return;
+        }
+    if(!plan || plan->isCopy())
+        {
+        if(a == 0)
+            {
+            for(long i = 0; i < size; ++i) z[i] = b*x[i];
+            }
+        else
+        if(a == 1 && inplace)
+            {
+            addScaled(size,b,x,z);
+            }
+        else
+            {
+            for(long i = 0; i < size; ++i) z[i] = a*y[i]+b*x[i];
+            }
+        return;
+        }
+    if(a == 0)
+        {
+        plan->forEach([x,b,z](long s, long d) { z[d] = b*x[s]; },Global::nthread());
+        }
+    else
+    if(a == 1 && inplace)
+        {
+        plan->forEach([x,b,z](long s, long d) { z[d] += b*x[s]; },Global::nthread());
+        }
+    else
+        {
+        plan->forEach([a,y,x,b,z](long s, long d) { z[d] = a*y[d]+b*x[s]; },
+                      Global::nthread());
+        }
+    }
+
+//Calls axpby with x in the precision it is held in
+template<typename TY>
+void static
+axpby(long size,
+      Real a,
+      const TY* y,
+      Real b,
+      const ITDat* x,
+      Real* z,
+      const TransposePlan* plan)
+    {
+    if(x && x->isSingle()) axpby(size,a,y,b,x->singleData(),z,plan);
+    else                   axpby(size,a,y,b,(x ? x->data() : nullptr),z,plan);
+    }
+
+//Replaces the data in dat by a*dat + b*(permuted x), where
+//a null dat or x stands for zero. Shared data is not copied
+//first: the result goes straight into new storage, which is
+//always double precision (data held in single precision is 
+//read without being promoted).
+void static
+axpbyInto(shared_ptr<ITDat>& dat,
+          Real a,
+          const ITDat* x,
+          Real b,
+          const TransposePlan* plan)
+    {
+    const long size = (dat ? dat->size() : x->size());
+    shared_ptr<ITDat> y = dat;
+    if(!y) a = 0;
+    if(!dat || !dat.unique()) dat = make_shared<ITDat>(size,ITDat::noInit);
+    else                      dat->makeDouble();
+    if(y && y->isSingle()) axpby(size,a,y->singleData(),b,x,dat->data(),plan);
+    else                   axpby(size,a,(y ? y->data() : nullptr),b,x,dat->data(),plan);
+    }
+
 ITensor& ITensor::
 operator+=(const ITensor& other)
     {
@@ -2848,124 +3623,31 @@ operator+=(const ITensor& other)
     const
     bool same_ind_order = (bothDiag || checkSameIndOrder(is_,other.is_));
 
-    const bool complex_this = this->isComplex();
-    const bool complex_other = other.isComplex();
-    if(!complex_this && complex_other)
-        {
-        operator+=(realPart(other));
-        if(same_ind_order)
-            {
-            i_ = other.i_;
-            }
-        else
-            {
-            Permutation P(NMAX+1); 
-            getperm(is_,other.is_,P);
-            allocateImag();
-            reshape(P,other.is_,other.i_->v,i_->v);
-            }
-        if(scale_ != other.scale_)
-            {
-            soloImag();
-            LogNumber nscale = other.scale_/scale_;
-            vectormult(i_->v,nscale.real0());
-            }
-        return *this;
-        }
-    else
-    if(complex_this && !complex_other) 
-        {
-        ITensor rr(*this);
-        rr.takeRealPart();
-        rr += other;
-        rr.scaleTo(scale_);
-        r_.swap(rr.r_);
-        return *this;
-        }
-    else
-    if(complex_this && complex_other)
-        {
-        ITensor r = realPart(*this) + realPart(other);
-        ITensor i = imagPart(*this) + imagPart(other);
-        i.scaleTo(r.scale_);
-        scale_ = r.scale_;
-        r_.swap(r.r_);
-        i_.swap(i.r_);
-        return *this;
-        }
-
-
-    //if(is_ != other.is_)
-    //    {
-    //    printfln("this ur = %.10f, other.ur = %.10f\n",is_.uniqueReal(),other.is_.uniqueReal());
-    //    Print(*this);
-    //    Print(other);
-    //    Print(this->is_);
-    //    printfln("this indexset uniqueReal = %.20f",is_.uniqueReal());
-    //    Print(other.is_);
-    //    printfln("other indexset uniqueReal = %.20f",other.is_.uniqueReal());
-    //    Error("ITensor::operator+=: different Index structure");
-    //    }
-
-
-
-    Real scalefac = 1;
+    //Bring both tensors to the larger of the two scales
+    //as part of the sum: this = a*this + b*other
+    Real a = 1,
+         b = 1;
     if(scale_.magnitudeLessThan(other.scale_)) 
         {
-        this->scaleTo(other.scale_); 
+        a = (scale_/other.scale_).real0();
+        scale_ = other.scale_;
         }
     else
         {
-        scalefac = (other.scale_/scale_).real();
+        b = (other.scale_/scale_).real0();
         }
 
-    solo();
-
-    auto &thisdat = r_->v;
-    const auto &othrdat = other.r_->v;
-
-    if(same_ind_order) 
-        { 
-        vectordaxpy(thisdat,othrdat,scalefac);
-        return *this; 
-        }
-
-    Permutation P(NMAX+1); 
-    getperm(is_,other.is_,P);
-    Counter c(other.is_);
-
-    const int* j[NMAX+1];
-    for(int k = 1; k <= NMAX; ++k) 
-        {
-        j[P.dest(k)] = &(c.i[k]);
-        }
-
-    int n[NMAX+1];
-    for(int k = 1; k <= NMAX; ++k) 
+    TransposePlan plan;
+    if(!same_ind_order)
         {
-        n[P.dest(k)] = c.n[k];
+        Permutation P(NMAX+1); 
+        getperm(is_,other.is_,P);
+        plan = TransposePlan(P,other.is_);
         }
+    const TransposePlan* pplan = (same_ind_order ? nullptr : &plan);
 
-    if(scalefac == 1)
-        {
-        for(; c.notDone(); ++c)
-            {
-            thisdat[(((((((*j[8])*n[7]+*j[7])*n[6]
-            +*j[6])*n[5]+*j[5])*n[4]+*j[4])*n[3]
-            +*j[3])*n[2]+*j[2])*n[1]+*j[1]]
-            += othrdat[c.ind];
-            }
-        }
-    else
-        {
-        for(; c.notDone(); ++c)
-            {
-            thisdat[(((((((*j[8])*n[7]+*j[7])*n[6]
-            +*j[6])*n[5]+*j[5])*n[4]+*j[4])*n[3]
-            +*j[3])*n[2]+*j[2])*n[1]+*j[1]]
-            += scalefac * othrdat[c.ind];
-            }
-        }
+    axpbyInto(r_,a,other.r_.get(),b,pplan);
+    if(i_ || other.i_) axpbyInto(i_,a,other.i_.get(),b,pplan);
 
     return *this;
     } 
@@ -3095,7 +3777,7 @@ toMatrix11(const Index& i1, const Index& i2, Matrix& res) const
 //    getperm(is_,reshuf,P);
 //
 //    Vector V;
-//    reshape(P,is_,r_->v,V);
+//    reshape(P,is_,r_->v(),V);
 //    res.TreatAsVector() = V;
 //    }
 //
@@ -3122,7 +3804,7 @@ toMatrix11(const Index& i1, const Index& i2, Matrix& res) const
 //#ifdef DEBUG
 //    if(Mvref.Stride()!=1) Error("VectorRef Stride()!=1 before copying data");
 //#endif
-//    Q.r_->v.assign(Mvref.Store(),Mvref.Store()+Mvref.Length());
+//    Q.r_->v().assign(Mvref.Store(),Mvref.Store()+Mvref.Length());
 //    *this = Q;
 //    }
 //
@@ -3148,7 +3830,7 @@ toMatrix11(const Index& i1, const Index& i2, Matrix& res) const
 //    Permutation P(NMAX+1); 
 //    getperm(is_,reshuf,P);
 //    Vector V; 
-//    reshape(P,is_,r_->v,V);
+//    reshape(P,is_,r_->v(),V);
 //    res.TreatAsVector() = V;
 //    res *= scale_.real0();
 //    }
@@ -3167,7 +3849,7 @@ toMatrix11(const Index& i1, const Index& i2, Matrix& res) const
 //#ifdef DEBUG
 //    if(Mvref.Stride()!=1) Error("VectorRef Stride()!=1 before copying data");
 //#endif
-//    Q.r_->v.assign(Mvref.Store(),Mvref.Store()+Mvref.Length());
+//    Q.r_->v().assign(Mvref.Store(),Mvref.Store()+Mvref.Length());
 //    *this = Q;
 //    }
 
@@ -3212,7 +3894,7 @@ void ITensor::fromMatrix21(const Index& i1, const Index& i2, const Index& i3, co
     if(i1.m()*i2.m() != M.Nrows()) Error("fromMatrix21: wrong number of rows");
     if(i3.m() != M.Ncols()) Error("fromMatrix21: wrong number of cols");
     ITensor Q(i3,i1,i2);
-    Q.p->v = M.TreatAsVector();
+    Q.p->v() = M.TreatAsVector();
     assignFrom(Q);
 }
 
@@ -3223,7 +3905,7 @@ void ITensor::fromMatrix12(const Index& i1, const Index& i2, const Index& i3, co
     if(i1.m() != M.Nrows()) Error("fromMatrix12: wrong number of rows");
     if(i3.m()*i2.m() != M.Ncols()) Error("fromMatrix12: wrong number of cols");
     ITensor Q(i2,i3,i1);
-    Q.p->v = M.TreatAsVector();
+    Q.p->v() = M.TreatAsVector();
     assignFrom(Q);
 }
 */
@@ -3241,7 +3923,7 @@ convertToDense()
         const int ds = oldr->size();
         for(int j = 0; j < ds; ++j)
             {
-            r_->v[_ind(is_,j,j,j,j,j,j,j,j)] = oldr->v[j];
+            r_->v()[_ind(is_,j,j,j,j,j,j,j,j)] = oldr->v()[j];
             }
 
         if(this->isComplex())
@@ -3250,7 +3932,7 @@ convertToDense()
             allocateImag(dim);
             for(int j = 0; j < ds; ++j)
                 {
-                i_->v[_ind(is_,j,j,j,j,j,j,j,j)] = oldi->v[j];
+                i_->v()[_ind(is_,j,j,j,j,j,j,j,j)] = oldi->v()[j];
                 }
             }
         }
@@ -3304,14 +3986,14 @@ operator<<(ostream & s, const ITensor& t)
 
             if(t.r() == 0)
                 {
-                const Real rval = t.r_->v.at(0)*scale;
+                const Real rval = t.r_->data()[0]*scale;
                 if(!iscplx)
                     {
                     s << format("  %.10f\n",rval);
                     }
                 else
                     {
-                    const Real ival = t.i_->v.at(0)*scale;
+                    const Real ival = t.i_->data()[0]*scale;
                     const char sgn = (ival > 0 ? '+' : '-');
                     s << format("  %.10f%s%.10fi\n",rval,sgn,fabs(ival));
                     }
@@ -3323,7 +4005,7 @@ operator<<(ostream & s, const ITensor& t)
                 const int ds = t.indices().front().m();
                 for(int j = 1; j <= ds; ++j)
                     {
-                    const Real rval = t.r_->v.at(j-1)*scale;
+                    const Real rval = t.r_->data()[j-1]*scale;
                     if(!iscplx)
                         {
                         if(fabs(rval) > Global::printScale())
@@ -3336,7 +4018,7 @@ operator<<(ostream & s, const ITensor& t)
                         }
                     else
                         {
-                        const Real ival = t.i_->v.at(j-1)*scale;
+                        const Real ival = t.i_->data()[j-1]*scale;
                         if(sqrt(sqr(rval)+sqr(ival)) > Global::printScale())
                             {
                             const char sgn = (ival > 0 ? '+' : '-');
@@ -3398,7 +4080,15 @@ ITDat::
 ITDat(size_t size, 
       Real val) 
     : 
-    v(size,val)
+    v_(size,val)
+    { 
+    }
+
+ITDat::
+ITDat(size_t size, 
+      NoInit) 
+    : 
+    v_(size)
     { 
     }
 
@@ -3406,31 +4096,103 @@ ITDat::
 ITDat(const VectorRef& vref) 
     { 
     if(vref.Stride()!=1) Error("Can only construct ITensor from VectorRef having Stride()==1");
-    v.assign(vref.Store(),vref.Store()+vref.Length());
+    v_.assign(vref.Store(),vref.Store()+vref.Length());
     }
 
 ITDat::
 ITDat(const ITDat& other) 
-    : 
-    v(other.v)
+    { 
+    //Copies the data in the precision it is held in
+    if(other.isSingle())
+        {
+        f_ = other.f_;
+        single_ = true;
+        }
+    else
+    if(other.isView())
+        {
+        v_.assign(other.data(),other.data()+other.size());
+        }
+    else
+        {
+        v_ = other.v_;
+        }
+    }
+
+ITDat::
+ITDat(const Buffer& buf,
+      size_t offset,
+      size_t size)
+    :
+    buf_(buf),
+    off_(offset),
+    n_(size),
+    view_(true)
     { }
 
+void ITDat::
+promote() const
+    {
+    std::lock_guard<std::mutex> lock(promote_mutex_);
+    if(single_) 
+        {
+        v_.assign(f_.begin(),f_.end());
+        single_ = false;
+        }
+    if(view_)
+        {
+        v_.assign(buf_->data()+off_,buf_->data()+off_+n_);
+        view_ = false;
+        }
+    }
+
+void ITDat::
+makeSingle()
+    {
+    if(single_) return;
+    if(view_)
+        {
+        f_.assign(data(),data()+size());
+        view_ = false;
+        }
+    else
+    if(f_.size() != v_.size()) 
+        {
+        f_.assign(v_.begin(),v_.end());
+        }
+    Storage().swap(v_);
+    buf_.reset();
+    single_ = true;
+    }
+
+void ITDat::
+makeDouble()
+    {
+    if(single_) promote();
+    SingleStorage().swap(f_);
+    if(!view_) buf_.reset();
+    }
+
 void ITDat:: 
 read(std::istream& s) 
     { 
     size_t size = 0;
     s.read((char*) &size,sizeof(size));
-    v.resize(size);
-    s.read((char*) v.data(), sizeof(Real)*size);
+    SingleStorage().swap(f_);
+    single_ = false;
+    buf_.reset();
+    view_ = false;
+    v_.resize(size);
+    s.read((char*) v_.data(), sizeof(Real)*size);
     }
 
 
 void ITDat::
 write(std::ostream& s) const 
     { 
-    size_t size = v.size();
+    size_t size = this->size();
     s.write((char*) &size, sizeof(size));
-    s.write((char*) v.data(), sizeof(Real)*size); 
+    s.write((char*) data(), sizeof(Real)*size); 
     }
 
 //
@@ -3506,7 +4268,7 @@ operator,(Real r)
         Error("commaInit notation is T << #, #, #, ... ;");
         }
     if(c_.notDone()) 
-        { T_.r_->v[c_.ind] = r; ++c_; }
+        { T_.r_->v()[c_.ind] = r; ++c_; }
     else 
         { Error("Comma assignment list too long.\n"); }
     return *this;
@@ -6,22 +6,27 @@
 #define __ITENSOR_ITENSOR_H
 #include "real.h"
 #include "counter.h"
+#include "pool.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
 
 namespace itensor {
 
 //Forward declarations
 struct ProductProps;
+struct ContractionPlan;
 class Combiner;
 class ITDat;
 class ITensor;
 class SimpleMatrixRef;
 
 void toMatrixProd(const ITensor& L, const ITensor& R, 
+                  const ContractionPlan& plan,
                   std::vector<Real>& newLdat,
                   std::vector<Real>& newRdat,
-                  ProductProps& pp,
                   SimpleMatrixRef& lref, SimpleMatrixRef& rref,
-                  bool& L_is_matrix, bool& R_is_matrix, bool doReshape = true);
+                  bool doReshape = true);
 
 //
 // ITensor
@@ -77,6 +82,22 @@ class ITensor
     ITensor&
     takeImagPart();
 
+    //Stores the data of this ITensor in single precision, 
+    //halving its memory. Products with a single precision
+    //operand are computed in single precision (accumulating
+    //in double) and are held in single precision as well.
+    //Other operations promote the data to double precision,
+    //for good if they modify it.
+    ITensor&
+    toSinglePrecision();
+
+    //Stores the data of this ITensor in double precision
+    ITensor&
+    toDoublePrecision();
+
+    bool
+    isSinglePrecision() const;
+
     //Enables looping over Indices in a range-based for loop
     //e.g. for(const Index& I : t.index() ) { ... }
     const IndexSet<Index>&
@@ -313,7 +334,7 @@ class ITensor
     //                  If j.m() == 5 and k.m() == 7, J.m() == 5*7.
     //
     void 
-    groupIndices(const array<Index,NMAX+1>& indices, int nind, 
+    groupIndices(const SmallVector<Index,NMAX+1>& indices, int nind, 
                       const Index& grouped, ITensor& res) const;
 
     //
@@ -323,7 +344,7 @@ class ITensor
     // Rijl = Aijil <-- here we have tied the 1st and 3rd index of A
     //
     void
-    tieIndices(const array<Index,NMAX>& indices, int nind,
+    tieIndices(const IndexSet<Index>::Storage& indices, int nind,
                const Index& tied);
 
     void
@@ -358,7 +379,7 @@ class ITensor
           const Index& i8 = Index::Null());
 
     ITensor&
-    trace(const array<Index,NMAX>& indices, int nind = -1);
+    trace(const IndexSet<Index>::Storage& indices, int nind = -1);
 
 
     //
@@ -517,12 +538,14 @@ class ITensor
     
     friend struct ProductProps;
 
+    friend struct ContractionPlan;
+
     friend void toMatrixProd(const ITensor& L, const ITensor& R, 
+                             const ContractionPlan& plan,
                              std::vector<Real>& newLdat,
                              std::vector<Real>& newRdat,
-                             ProductProps& pp,
                              SimpleMatrixRef& lref, SimpleMatrixRef& rref,
-                             bool& L_is_matrix, bool& R_is_matrix, bool doReshape);
+                             bool doReshape);
 
     int _ind2(const IndexVal& iv1, const IndexVal& iv2) const;
 
@@ -544,12 +567,27 @@ class ITensor
 
     friend class commaInit;
 
+    friend class IQTDat;
+
+    friend void
+    writeBlocks(std::ostream& s, const std::vector<const ITensor*>& T);
+
+    friend std::vector<ITensor>
+    readBlocks(std::istream& s);
+
+    friend std::vector<bool>
+    multiplyBatch(const std::vector<std::pair<const ITensor*,const ITensor*>>& prods,
+                  const std::function<void(size_t,ITensor&)>& done);
+
     friend void 
     contractDiagDense(const ITensor& S, const ITensor& T, ITensor& res);
 
     friend void 
     contractDiagDiag(const ITensor& A, const ITensor& B, ITensor& res);
 
+    friend void 
+    contractComplexDense(const ITensor& A, const ITensor& B, ITensor& res);
+
 
     friend std::ostream& 
     operator<<(std::ostream & s, const ITensor& T);
@@ -594,7 +632,10 @@ class ITDat
     {
     public:
 
-    std::vector<Real> v;
+    using Storage = std::vector<Real,PoolAllocator<Real>>;
+
+    //Data held in single precision (see ITensor::toSinglePrecision)
+    using SingleStorage = std::vector<float,PoolAllocator<float>>;
 
     ITDat();
 
@@ -602,19 +643,80 @@ class ITDat
     ITDat(size_t size,
           Real val = 0);
 
+    enum NoInit { noInit };
+
+    //Leaves the elements uninitialized, for data
+    //which is about to be completely overwritten
+    ITDat(size_t size,
+          NoInit);
+
     explicit 
     ITDat(const VectorRef& v_);
 
     explicit 
     ITDat(const ITDat& other);
 
+    //Storage shared by several ITDat's, such as the
+    //blocks of an IQTensor (see IQTDat::pack)
+    using Buffer = std::shared_ptr<Storage>;
+
+    //Views the size elements of buf starting at offset
+    ITDat(const Buffer& buf,
+          size_t offset,
+          size_t size);
+
+    //The data in double precision; data held in single
+    //precision is promoted first, and the viewed part 
+    //of a buffer is copied out of it first
+    Storage&
+    v() { settle(); return v_; }
+    const Storage&
+    v() const { settle(); return v_; }
+
+    //The data in double precision, without copying
+    //out the data of a view
     const Real*
-    data() const { return v.data(); }
+    data() const { return view_ ? buf_->data()+off_ : v().data(); }
     Real*
-    data() { return v.data(); }
+    data() { return view_ ? buf_->data()+off_ : v().data(); }
 
     size_t
-    size() const { return v.size(); }
+    size() const { return view_ ? n_ : (single_ ? f_.size() : v_.size()); }
+
+    //True if the data is part of a shared buffer
+    bool
+    isView() const { return view_; }
+
+    //Buffer viewed and the offset into it (meaningful if isView())
+    const Buffer&
+    buffer() const { return buf_; }
+    size_t
+    offset() const { return off_; }
+
+    //True if the data is the part of buf starting at offset
+    bool
+    views(const Buffer& buf, size_t offset) const 
+        { return view_ && buf_ == buf && off_ == offset; }
+
+    //True if the data is held in single precision only
+    bool
+    isSingle() const { return single_; }
+
+    //The data in single precision, which stays valid once
+    //isSingle() returned true (until makeDouble is called)
+    const float*
+    singleData() const { return f_.data(); }
+
+    //Converts the data to single precision, freeing 
+    //the double precision data. As makeDouble, only 
+    //for data which no other thread is reading.
+    void
+    makeSingle();
+
+    //Converts the data to double precision (if needed), 
+    //freeing the single precision data
+    void
+    makeDouble();
 
     void
     read(std::istream& s);
@@ -626,12 +728,34 @@ class ITDat
 
     private:
 
+    //Promotion and copying out of a view by v() leave f_ and
+    //buf_ in place, since other threads may be reading the
+    //data through them; they are freed by makeDouble once 
+    //the data is about to be modified
+    mutable Storage v_;
+    mutable SingleStorage f_;
+    mutable std::atomic<bool> single_{false};
+    Buffer buf_;
+    size_t off_ = 0,
+           n_ = 0;
+    mutable std::atomic<bool> view_{false};
+    mutable std::mutex promote_mutex_;
+
+    void
+    settle() const { if(single_ || view_) promote(); }
+
+    void
+    promote() const;
+
     //Must be dynamically allocated:
     void operator=(const ITDat&);
 
 
     };
 
+bool inline ITensor::
+isSinglePrecision() const { return r_ && r_->isSingle(); }
+
 ITensor inline
 operator*(ITensor A, const ITensor& B) { A *= B; return A; }
 
@@ -696,7 +820,7 @@ mapElems(const Callable& f)
     scaleTo(1);
     for(size_t j = 0; j < r_->size(); ++j)
         {
-        r_->v[j] = f(r_->v[j]);
+        r_->v()[j] = f(r_->v()[j]);
         }
     return *this;
     }
@@ -733,6 +857,84 @@ Dot(const ITensor& x, const ITensor& y);
 Complex 
 BraKet(const ITensor& x, const ITensor& y);
 
+//
+// ITensor contraction (operator*= and operator/=)
+// caches the analysis of which indices are contracted,
+// how the data must be permuted and the shape of
+// the resulting matrix product, keyed on the dimensions
+// of the indices of both tensors and on which of them
+// are contracted. Repeating a contraction of tensors
+// of the same shape (even with different indices, such
+// as blocks of IQTensors) then skips this analysis.
+//
+// The cache is kept per thread; the statistics
+// are summed over all threads.
+//
+struct ContractionCacheStats
+    {
+    long hits = 0,
+         misses = 0;
+    };
+
+ContractionCacheStats
+contractionCacheStats();
+
+//Empties the cache of the calling thread
+//and resets the statistics
+void
+clearContractionCache();
+
+//
+// For each class of contraction shapes, ITensor
+// products choose between a kernel for small tensors
+// and one based on dgemm. By default the choice is
+// made by a fixed rule. With autotuning on, the first
+// product of each class times both kernels and the
+// faster one is used from then on. The choices can be
+// saved to and loaded from a tuning file.
+//
+void
+autotuneContraction(bool on = true);
+
+void
+clearContractionTuning();
+
+void
+readContractionTuning(const std::string& fname);
+
+void
+writeContractionTuning(const std::string& fname);
+
+//
+// Write out several (non-null) ITensors to binary stream s,
+// the data of all of them after their indices, scales and
+// sizes. The data is written straight from the ITensors, 
+// with a single call if it lies in one buffer in order.
+//
+void
+writeBlocks(std::ostream& s, const std::vector<const ITensor*>& T);
+
+//
+// Read in ITensors written by writeBlocks, reading all of 
+// their data with a single call into one buffer, which 
+// the ITensors view one after another (see ITDat::Buffer).
+//
+std::vector<ITensor>
+readBlocks(std::istream& s);
+
+//
+// Makes the products of the pairs of ITensors prods[n] which
+// are real, dense and need no permuting. They are grouped by
+// the shape of their matrix product, each group being made by
+// one batched GEMM call (cblas_dgemm_batch with MKL), and each
+// product T is handed to done(n,T) as soon as its group is 
+// done. Returns which pairs were multiplied; the others are 
+// left to the caller.
+//
+std::vector<bool>
+multiplyBatch(const std::vector<std::pair<const ITensor*,const ITensor*>>& prods,
+              const std::function<void(size_t,ITensor&)>& done);
+
 //
 // Define product of IndexVal iv1 = (I1,n1), iv2 = (I2,n2)
 // (I1, I2 are Index objects; n1,n2 are type int)
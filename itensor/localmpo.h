@@ -434,9 +434,7 @@ shift(int j, Direction dir, const Tensor& A)
             }
         Tensor& E = PH_.at(LHlim_);
         Tensor& nE = PH_.at(j);
-        nE = E * A;
-        nE *= Op_->A(j);
-        nE *= dag(prime(A));
+        nE = contract(E,A,Op_->A(j),dag(prime(A)));
         setLHlim(j);
         setRHlim(j+nc_+1);
 
@@ -451,9 +449,7 @@ shift(int j, Direction dir, const Tensor& A)
             }
         Tensor& E = PH_.at(RHlim_);
         Tensor& nE = PH_.at(j);
-        nE = E * A;
-        nE *= Op_->A(j);
-        nE *= dag(prime(A));
+        nE = contract(E,A,Op_->A(j),dag(prime(A)));
         setLHlim(j-nc_-1);
         setRHlim(j);
 
@@ -5,6 +5,7 @@
 #ifndef __ITENSOR_LOCAL_OP
 #define __ITENSOR_LOCAL_OP
 #include "iqtensor.h"
+#include "contract.h"
 
 namespace itensor {
 
@@ -246,26 +247,14 @@ product(const Tensor& phi, Tensor& phip) const
     const Tensor& Op1 = *Op1_;
     const Tensor& Op2 = *Op2_;
 
-    if(LIsNull())
-        {
-        phip = phi;
-
-        if(!RIsNull()) 
-            phip *= R(); //m^3 k d
-
-        phip *= Op2; //m^2 k^2
-        phip *= Op1; //m^2 k^2
-        }
-    else
-        {
-        phip = phi * L(); //m^3 k d
-
-        phip *= Op1; //m^2 k^2
-        phip *= Op2; //m^2 k^2
-
-        if(!RIsNull()) 
-            phip *= R();
-        }
+    //Order of the products is chosen from the 
+    //index dimensions (it matters for instance 
+    //whether k is large compared to m)
+    ContractExpr<Tensor> net(phi);
+    if(!LIsNull()) net.add(L());
+    net.add(Op1).add(Op2);
+    if(!RIsNull()) net.add(R());
+    phip = net.eval();
 
     phip.mapprime(1,0);
     }
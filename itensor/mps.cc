@@ -780,6 +780,15 @@ orthMPS(Tensor& A1, Tensor& A2, Direction dir, const Args& args)
         Print(L.indices());
         }
 
+    if(args.getBool("UseQR",false))
+        {
+        Tensor Q,Rb(bnd);
+        qrDecomp(L,Q,Rb);
+        L = Q;
+        R *= Rb;
+        return Spectrum();
+        }
+
     Tensor A,B(bnd);
     Tensor D;
     auto spec = svd(L,A,D,B,args);
@@ -820,11 +829,19 @@ position(int i, const Args& args)
         }
     else //use orthMPS
         {
+        //Without truncation this is a pure gauge
+        //move, done more cheaply by a QR decomposition
+        const bool useQR = args.getBool("UseQR",
+                                        !args.getBool("UseSVD",false)
+                                        && !args.defined("Cutoff")
+                                        && !args.defined("Maxm")
+                                        && !args.defined("Minm"));
+        const Args oargs = args + Args("UseQR",useQR);
         while(l_orth_lim_ < i-1)
             {
             if(l_orth_lim_ < 0) l_orth_lim_ = 0;
             setBond(l_orth_lim_+1);
-            orthMPS(Anc(l_orth_lim_+1),Anc(l_orth_lim_+2),Fromleft,args);
+            orthMPS(Anc(l_orth_lim_+1),Anc(l_orth_lim_+2),Fromleft,oargs);
             ++l_orth_lim_;
             if(r_orth_lim_ < l_orth_lim_+2) r_orth_lim_ = l_orth_lim_+2;
             }
@@ -832,7 +849,7 @@ position(int i, const Args& args)
             {
             if(r_orth_lim_ > N_+1) r_orth_lim_ = N_+1;
             setBond(r_orth_lim_-2);
-            orthMPS(Anc(r_orth_lim_-2),Anc(r_orth_lim_-1),Fromright,args);
+            orthMPS(Anc(r_orth_lim_-2),Anc(r_orth_lim_-1),Fromright,oargs);
             --r_orth_lim_;
             if(l_orth_lim_ > r_orth_lim_-2) l_orth_lim_ = r_orth_lim_-2;
             }
@@ -860,15 +877,22 @@ void MPSt<Tensor>::
 orthogonalize(const Args& args)
     {
     //Do a half-sweep to the right, orthogonalizing each bond
-    //but lower the cutoff since the basis to the right
-    //might not be ortho: don't want to over truncate
+    //but don't truncate since the basis to the right
+    //might not be ortho: a QR decomposition suffices
     l_orth_lim_ = 0;
     r_orth_lim_ = N()+1;
-    //Use smaller cutoff to orthogonalize w/ minimal truncation
-    auto orig_cut = args.getReal("Cutoff",MIN_CUT);
-    position(N_,args + Args("Cutoff",0.01*orig_cut));
+    if(args.getBool("UseSVD",false))
+        {
+        //Use smaller cutoff to orthogonalize w/ minimal truncation
+        auto orig_cut = args.getReal("Cutoff",MIN_CUT);
+        position(N_,args + Args("Cutoff",0.01*orig_cut));
+        }
+    else
+        {
+        position(N_,args + Args("UseQR",true));
+        }
     //Now basis is ortho, ok to truncate
-    position(1,args);
+    position(1,args + Args("UseQR",false));
     }
 template
 void MPSt<ITensor>::orthogonalize(const Args& args);
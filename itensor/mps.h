@@ -150,6 +150,10 @@ class MPSt
 
     //Move the orthogonality center to site i 
     //(leftLim() == i-1, rightLim() == i+1, orthoCenter() == i)
+    //
+    //Unless args set "Cutoff", "Maxm", "Minm" or "UseSVD",
+    //bonds are not truncated and are moved by QR decompositions
+    //(args "UseQR" overrides this choice)
     void 
     position(int i, const Args& args = Global::args());
 
@@ -12,6 +12,11 @@ namespace itensor {
 // Tell where each index will go, 
 // if(p.dest(2) == 1) then 2 -> 1, etc.
 //
+// Positions past size() are left in place
+// (dest(j) == j) and setFromTo grows the
+// Permutation as needed, so that a Permutation
+// can be used for any number of indices.
+//
 struct Permutation
     {
     using storage = std::vector<long>;
@@ -37,7 +42,7 @@ struct Permutation
               long to);
 
     long 
-    dest(long j) const { return GET(store_,j); }
+    dest(long j) const { return j < size() ? store_[j] : j; }
 
     //bool 
     //check(int d);
@@ -62,7 +67,13 @@ setFromTo(long from,
           long to) 
     { 
     if(from != to) trivial_ = false;
-    GET(store_,from) = to; 
+    if(from >= size())
+        {
+        auto n = store_.size();
+        store_.resize(from+1);
+        for(; n < store_.size(); ++n) store_[n] = n;
+        }
+    store_[from] = to; 
     }
 
 Permutation inline
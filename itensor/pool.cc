@@ -0,0 +1,248 @@
+//
+// Distributed under the ITensor Library License, Version 1.1.
+//    (See accompanying LICENSE file.)
+//
+#include "pool.h"
+#include <atomic>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+namespace itensor {
+
+constexpr size_t PoolArena::DefaultChunkBytes;
+
+namespace detail {
+
+//
+// Every block starts with a header recording where
+// it came from: the arena chunk it belongs to, or
+// else its size class (-1 for blocks too large to
+// have one). Its size keeps the data 16-byte aligned.
+//
+struct alignas(16) BlockHeader
+    {
+    ArenaChunk* chunk;
+    int sclass;
+    };
+
+struct ArenaChunk
+    {
+    char* base;
+    size_t size,
+           used;
+    //Number of blocks in use plus one while
+    //the arena owning the chunk still exists
+    std::atomic<long> refs;
+    };
+
+//Size classes: 64 bytes, then four classes
+//for each doubling up to MaxClassBytes
+const size_t MinClassBytes = 64,
+             MaxClassBytes = 1ul << 25;
+const int NumClasses = 77;
+
+//Most bytes a thread keeps in its cache
+const size_t MaxCachedBytes = 1ul << 26;
+
+size_t static
+classBytes(int c)
+    {
+    if(c == 0) return MinClassBytes;
+    const int e = 6+(c-1)/4,
+              s = (c-1)%4;
+    return size_t(5+s) << (e-2);
+    }
+
+int static
+sizeClass(size_t n)
+    {
+    if(n <= MinClassBytes) return 0;
+    if(n > MaxClassBytes) return -1;
+    const size_t m = n-1;
+    int e = 0;
+    while((m >> (e+1)) != 0) ++e;
+    const int s = (m >> (e-2)) & 3;
+    return (e-6)*4+s+1;
+    }
+
+void static*
+mallocBlock(size_t nbytes)
+    {
+    void* p = std::malloc(nbytes);
+    if(!p) throw std::bad_alloc();
+    return p;
+    }
+
+//Tells poolDeallocate whether this thread's
+//cache has not been created yet (0), is
+//usable (1) or was already destroyed (2)
+thread_local int cache_state = 0;
+
+struct ThreadCache
+    {
+    std::vector<BlockHeader*> free[NumClasses];
+    size_t bytes = 0;
+    PoolStats stats;
+    PoolArena* arena = nullptr;
+
+    ThreadCache() { cache_state = 1; }
+
+    ~ThreadCache()
+        {
+        release();
+        cache_state = 2;
+        }
+
+    void
+    release()
+        {
+        for(auto& fl : free)
+            {
+            for(auto* h : fl) std::free(h);
+            fl.clear();
+            }
+        bytes = 0;
+        }
+    };
+
+ThreadCache static&
+threadCache()
+    {
+    thread_local ThreadCache cache;
+    return cache;
+    }
+
+void static
+releaseChunkRef(ArenaChunk* ch)
+    {
+    if(--ch->refs == 0)
+        {
+        std::free(ch->base);
+        delete ch;
+        }
+    }
+
+void*
+poolAllocate(size_t nbytes)
+    {
+    const size_t total = nbytes+sizeof(BlockHeader);
+    BlockHeader* h = nullptr;
+    if(cache_state != 2)
+        {
+        ThreadCache& tc = threadCache();
+        if(tc.arena)
+            {
+            ++tc.stats.arena;
+            return tc.arena->allocate(total);
+            }
+        const int c = sizeClass(total);
+        if(c >= 0 && !tc.free[c].empty())
+            {
+            h = tc.free[c].back();
+            tc.free[c].pop_back();
+            tc.bytes -= classBytes(c);
+            ++tc.stats.reused;
+            return h+1;
+            }
+        ++tc.stats.fresh;
+        }
+    const int c = sizeClass(total);
+    h = static_cast<BlockHeader*>(mallocBlock(c >= 0 ? classBytes(c) : total));
+    h->chunk = nullptr;
+    h->sclass = c;
+    return h+1;
+    }
+
+void
+poolDeallocate(void* p)
+    {
+    if(!p) return;
+    BlockHeader* h = static_cast<BlockHeader*>(p)-1;
+    if(h->chunk)
+        {
+        releaseChunkRef(h->chunk);
+        return;
+        }
+    const int c = h->sclass;
+    if(c >= 0 && cache_state != 2)
+        {
+        ThreadCache& tc = threadCache();
+        if(tc.bytes+classBytes(c) <= MaxCachedBytes)
+            {
+            tc.free[c].push_back(h);
+            tc.bytes += classBytes(c);
+            return;
+            }
+        }
+    std::free(h);
+    }
+
+} //namespace detail
+
+using detail::ArenaChunk;
+using detail::BlockHeader;
+
+PoolArena::
+PoolArena(size_t chunk_bytes)
+    :
+    chunk_bytes_(chunk_bytes)
+    {
+    auto& tc = detail::threadCache();
+    outer_ = tc.arena;
+    tc.arena = this;
+    }
+
+PoolArena::
+~PoolArena()
+    {
+    if(detail::cache_state == 1) detail::threadCache().arena = outer_;
+    if(current_) detail::releaseChunkRef(current_);
+    }
+
+size_t PoolArena::
+chunkBytes(size_t nbytes)
+    {
+    return (nbytes+sizeof(BlockHeader)+15) & ~size_t(15);
+    }
+
+void* PoolArena::
+allocate(size_t nbytes)
+    {
+    //Keep every block 16-byte aligned
+    nbytes = (nbytes+15) & ~size_t(15);
+    if(!current_ || current_->used+nbytes > current_->size)
+        {
+        //Start a new chunk, letting go of the arena's
+        //reference to the current one
+        auto* ch = new ArenaChunk;
+        ch->size = std::max(chunk_bytes_,nbytes);
+        ch->base = static_cast<char*>(detail::mallocBlock(ch->size));
+        ch->used = 0;
+        ch->refs = 1;
+        if(current_) detail::releaseChunkRef(current_);
+        current_ = ch;
+        }
+    auto* h = reinterpret_cast<BlockHeader*>(current_->base+current_->used);
+    current_->used += nbytes;
+    ++current_->refs;
+    h->chunk = current_;
+    h->sclass = -1;
+    return h+1;
+    }
+
+PoolStats
+poolStats()
+    {
+    return detail::threadCache().stats;
+    }
+
+void
+clearPool()
+    {
+    auto& tc = detail::threadCache();
+    tc.release();
+    tc.stats = PoolStats();
+    }
+
+} //namespace itensor
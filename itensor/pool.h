@@ -0,0 +1,164 @@
+//
+// Distributed under the ITensor Library License, Version 1.1.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_POOL_H
+#define __ITENSOR_POOL_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace itensor {
+
+namespace detail {
+
+void*
+poolAllocate(size_t nbytes);
+
+void
+poolDeallocate(void* p);
+
+struct ArenaChunk;
+
+} //namespace detail
+
+//
+// PoolAllocator
+//
+// Allocator for tensor storage. Requests are rounded
+// up to one of a set of size classes and freed blocks
+// are kept in a cache belonging to the thread which
+// frees them, to be handed out again by later requests
+// of the same size class without calling malloc.
+//
+// Value-initialization of elements of trivial type
+// (as done by resize or by the size-only constructor
+// of std::vector) leaves them uninitialized, so storage
+// which is about to be overwritten is not zeroed first.
+//
+template<typename T>
+class PoolAllocator
+    {
+    public:
+
+    using value_type = T;
+
+    PoolAllocator() { }
+
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U>&) { }
+
+    T*
+    allocate(size_t n)
+        {
+        return static_cast<T*>(detail::poolAllocate(n*sizeof(T)));
+        }
+
+    void
+    deallocate(T* p, size_t) { detail::poolDeallocate(p); }
+
+    template<typename U>
+    void
+    construct(U* p) { ::new(static_cast<void*>(p)) U; }
+
+    template<typename U, typename... Args>
+    void
+    construct(U* p, Args&&... args)
+        {
+        ::new(static_cast<void*>(p)) U(std::forward<Args>(args)...);
+        }
+    };
+
+template<typename T, typename U>
+bool
+operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) { return true; }
+
+template<typename T, typename U>
+bool
+operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) { return false; }
+
+//
+// PoolArena
+//
+// While a PoolArena exists, PoolAllocator requests made
+// by the thread which created it are carved out of large
+// chunks owned by the arena, instead of coming from the
+// size-class pool. Freeing such storage costs nothing.
+//
+// Meant to be wrapped around a unit of work creating many
+// short-lived tensors (such as one sweep of DMRG):
+//
+//     {
+//     PoolArena arena;
+//     ...
+//     } //chunks released here
+//
+// The chunks are released in bulk when the arena is
+// destroyed. Storage which outlives the arena remains
+// valid: its chunk is only released once all storage
+// allocated in it has been freed.
+//
+// Arenas may be nested; the innermost one is used.
+//
+class PoolArena
+    {
+    public:
+
+    explicit
+    PoolArena(size_t chunk_bytes = DefaultChunkBytes);
+
+    ~PoolArena();
+
+    PoolArena(const PoolArena&) = delete;
+
+    PoolArena&
+    operator=(const PoolArena&) = delete;
+
+    static constexpr size_t DefaultChunkBytes = 1ul << 24;
+
+    //Bytes of an arena chunk taken up by storage for 
+    //n elements of type T (a chunk holding the sum of
+    //these over several requests fits all of them)
+    template<typename T>
+    static size_t
+    bytesFor(size_t n) { return chunkBytes(n*sizeof(T)); }
+
+    private:
+
+    ///////////
+    size_t chunk_bytes_;
+    detail::ArenaChunk* current_ = nullptr;
+    PoolArena* outer_ = nullptr;
+    ///////////
+
+    void*
+    allocate(size_t nbytes);
+
+    static size_t
+    chunkBytes(size_t nbytes);
+
+    friend void* detail::poolAllocate(size_t nbytes);
+    };
+
+//
+// Counts of PoolAllocator requests made by the calling thread
+//
+struct PoolStats
+    {
+    long reused = 0, //served from the thread's cache
+         fresh = 0,  //needed a call to malloc
+         arena = 0;  //served by a PoolArena
+    };
+
+PoolStats
+poolStats();
+
+//Returns the storage cached by the calling
+//thread to the system and resets its statistics
+void
+clearPool();
+
+} //namespace itensor
+
+#endif
@@ -25,24 +25,18 @@ class QCounter : public Counter
         {
         rn = v.size();
         r = rn;
-        n[0] = 0;
+        allocate(rn);
         for(int j = 0; j < rn; ++j) 
             n[j+1] = v[j].nindex();
-        for(int j = rn+1; j <= NMAX; ++j) 
-            n[j] = 1;
-        reset();
         }
 
     QCounter(const IndexSet<IQIndex>& is)
         {
         rn = is.rn();
         r = is.r();
-        n[0] = 0;
+        allocate(r);
         for(int j = 1; j <= rn; ++j) 
             n[j] = is.index(j).nindex();
-        for(int j = rn+1; j <= NMAX; ++j) 
-            n[j] = 1;
-        reset();
         }
 
     int 
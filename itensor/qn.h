@@ -5,6 +5,9 @@
 #ifndef __ITENSOR_QN_H
 #define __ITENSOR_QN_H
 
+#include <array>
+#include <functional>
+
 #define DEF_NMAX 2
 
 namespace itensor {
@@ -30,11 +33,32 @@ namespace itensor {
 // this is useful for conserving charge mod Nmax as in a 
 // Potts/parafermion model.
 //
+// Further conserved charges (particle numbers per flavor,
+// momentum, Z_n charges) can be added with QN::addCharge,
+// which returns the number of the new charge:
+//
+//   auto Nup = QN::addCharge();   //U(1) charge
+//   auto K = QN::addCharge(4);    //Z_4 charge
+//   auto q = QN(1,1).setCharge(Nup,1).setCharge(K,3);
+//
+// Every QN carries the same set of charges;
+// charges not set are zero.
+//
 
 class QN
     {
     public:
 
+    //Most charges a QN can carry, including sz, Nf and Nfp
+    static const int MaxCharges = 8;
+
+    //Numbers of the built-in charges
+    enum { SzCharge = 0, NfCharge = 1, NfpCharge = 2 };
+
+    //Marks the start of a QN written by write(), which
+    //records the charge count and moduli (see below)
+    enum { IOTag = -0x51AB0E00 };
+
     QN(int sz = 0, int Nf = 0);
 
     QN(int sz, int Nf, int Nfp);
@@ -42,17 +66,26 @@ class QN
     //sz is measured in units of 1/2
     //(sz==1 is 1/2, sz==2 is 1, etc.)
     int 
-    sz() const { return sz_; }
+    sz() const { return q_[SzCharge]; }
 
     //Number of particles
     int 
-    Nf() const { return Nf_; }
+    Nf() const { return q_[NfCharge]; }
 
     //Fermion parity
     //Nfp is either 0 or 1
     //(or can range up to Nmax-1 if Nmax > 2)
     int 
-    Nfp() const { return Nfp_; }
+    Nfp() const { return q_[NfpCharge]; }
+
+    //Value of charge number n
+    int
+    charge(int n) const { return q_[n]; }
+
+    //Set charge number n (reduced mod its modulus
+    //if it is a Z_n charge)
+    QN&
+    setCharge(int n, int val);
 
     QN& 
     operator+=(const QN &other);
@@ -79,6 +112,9 @@ class QN
     void 
     read(std::istream& s);
 
+    size_t
+    hash() const;
+
     static int&
     Nmax()
         {
@@ -86,33 +122,64 @@ class QN
         return Nmax_;
         }
 
+    //Add a charge to every QN, returning its number.
+    //A modulus of 0 makes a U(1) charge, n > 1 a Z_n charge.
+    static int
+    addCharge(int modulus = 0);
+
+    //Number of charges carried, including sz, Nf and Nfp
+    static int
+    nCharges() { return layout().n; }
+
+    //Modulus of charge number n (0 for a U(1) charge)
+    static int
+    modulus(int n) { return (n == NfpCharge ? Nmax() : layout().mod[n]); }
+
+    //Remove all charges added by addCharge
+    static void
+    resetCharges() { layout() = Layout(); }
+
     private:
 
-    int sz_, 
-        Nf_, 
-        Nfp_; //Nfp_ stands for fermion number parity, 
-              //and tracks whether Nf is even or odd
-              //(can't just calculate Nfp from Nf on the fly
-              //because we may not be tracking Nf, i.e. Nf==0)
+    //sz, Nf, Nfp, then the charges added by addCharge;
+    //slots past nCharges() are always zero.
+    //Nfp stands for fermion number parity, 
+    //and tracks whether Nf is even or odd
+    //(can't just calculate Nfp from Nf on the fly
+    //because we may not be tracking Nf, i.e. Nf==0)
+    std::array<int,MaxCharges> q_;
+
+    struct Layout
+        {
+        int n = 3;
+        std::array<int,MaxCharges> mod = {{}};
+        };
+
+    static Layout&
+    layout()
+        {
+        static Layout layout_;
+        return layout_;
+        }
+
+    //Reduce val into the range of charge n
+    static int
+    wrap(int n, int val);
     };
 
 inline QN::
 QN(int sz, int Nf)
     :
-    sz_(sz),
-    Nf_(Nf),
-    Nfp_(abs(Nf%DEF_NMAX))
+    q_({{sz,Nf,abs(Nf%DEF_NMAX)}})
     { }
 
 inline QN::
 QN(int sz, int Nf, int Nfp)
     : 
-    sz_(sz), 
-    Nf_(Nf), 
-    Nfp_(abs(Nfp%Nmax()))
+    q_({{sz,Nf,abs(Nfp%Nmax())}})
     { 
 #ifdef DEBUG
-    if(Nf_ != 0 && abs(Nf_%Nmax()) != Nfp_)
+    if(Nf != 0 && abs(Nf%Nmax()) != q_[NfpCharge])
         {
         Print(Nmax());
         Error("Nfp should equal abs(Nf%Nmax)");
@@ -120,6 +187,37 @@ QN(int sz, int Nf, int Nfp)
 #endif
     }
 
+int inline QN::
+wrap(int n, int val)
+    {
+    //Nfp keeps its original convention
+    if(n == NfpCharge) return abs(val)%Nmax();
+    const int m = layout().mod[n];
+    if(m == 0) return val;
+    return ((val%m)+m)%m;
+    }
+
+int inline QN::
+addCharge(int modulus)
+    {
+    auto& l = layout();
+    if(l.n >= MaxCharges) Error("QN: too many charges (increase QN::MaxCharges)");
+    if(modulus < 0 || modulus == 1) Error("QN: modulus must be 0 (U(1)) or > 1 (Z_n)");
+    l.mod[l.n] = modulus;
+    return l.n++;
+    }
+
+inline
+QN& QN::
+setCharge(int n, int val)
+    {
+#ifdef DEBUG
+    if(n < 0 || n >= nCharges()) Error("QN::setCharge: charge number out of range");
+#endif
+    q_[n] = wrap(n,val);
+    return *this;
+    }
+
 QN inline
 operator+(QN A, const QN& B) { A += B; return A; }
 
@@ -130,9 +228,10 @@ inline
 QN& QN::
 operator+=(const QN &other)
     {
-    sz_ += other.sz_; 
-    Nf_ += other.Nf_; 
-    Nfp_ = abs(Nfp_+other.Nfp_)%Nmax();
+    for(int n = 0; n < nCharges(); ++n)
+        {
+        q_[n] = wrap(n,q_[n]+other.q_[n]);
+        }
     return *this;
     }
 
@@ -140,16 +239,19 @@ inline
 QN& QN::
 operator-=(const QN &other)
     {
-    sz_ -= other.sz_; 
-    Nf_ -= other.Nf_; 
-    Nfp_ = abs(Nfp_-other.Nfp_)%Nmax();
+    for(int n = 0; n < nCharges(); ++n)
+        {
+        q_[n] = wrap(n,q_[n]-other.q_[n]);
+        }
     return *this;
     }
 
 QN inline QN::
 operator-() const 
     { 
-    return QN(-sz_,-Nf_,(Nmax()-Nfp_)%Nmax()); 
+    QN res(*this);
+    res *= In;
+    return res;
     }
 
 inline
@@ -157,63 +259,120 @@ QN& QN::
 operator*=(Arrow dir) 
     { 
     const int i = dir;
-    sz_*=i; 
-    Nf_*=i; 
-    if(i == -1) Nfp_ = (Nmax()-Nfp_)%Nmax();
+    for(int n = 0; n < nCharges(); ++n)
+        {
+        const int m = modulus(n);
+        if(m == 0) q_[n] *= i;
+        else if(i == -1) q_[n] = (m-q_[n])%m;
+        }
     return *this; 
     }
 
 QN inline
 operator*(QN q, Arrow dir) { q *= dir; return q; }
 
+//QNs are written as IOTag, the number of charges,
+//the modulus of each charge, then the charges.
+//Files holding just sz, Nf and Nfp (the layout used
+//before charges could be added) can still be read:
+//their first int is sz, which is never IOTag.
 void inline QN::
 write(std::ostream& s) const 
     { 
-    s.write((char*)&sz_,sizeof(sz_)); 
-    s.write((char*)&Nf_,sizeof(Nf_)); 
-    s.write((char*)&Nfp_,sizeof(Nfp_)); 
+    const int n = nCharges();
+    int head[2+MaxCharges] = { IOTag, n };
+    for(int j = 0; j < n; ++j) head[2+j] = modulus(j);
+    s.write((char*)head,sizeof(int)*(2+n)); 
+    s.write((char*)q_.data(),sizeof(int)*n); 
     }
 
 void inline QN::
 read(std::istream& s) 
     { 
-    s.read((char*)&sz_,sizeof(sz_)); 
-    s.read((char*)&Nf_,sizeof(Nf_)); 
-    s.read((char*)&Nfp_,sizeof(Nfp_)); 
+    q_.fill(0);
+    int first = 0;
+    s.read((char*)&first,sizeof(first));
+    if(first != IOTag)
+        {
+        //Old layout: sz, Nf, Nfp
+        q_[SzCharge] = first;
+        s.read((char*)(q_.data()+NfCharge),sizeof(int)*2); 
+        return;
+        }
+    int n = 0;
+    s.read((char*)&n,sizeof(n));
+    if(n != nCharges())
+        {
+        Print(n);
+        Print(nCharges());
+        Error("QN::read: number of charges in file does not match QN::nCharges()");
+        }
+    for(int j = 0; j < n; ++j)
+        {
+        int mod = 0;
+        s.read((char*)&mod,sizeof(mod));
+        if(mod != modulus(j))
+            {
+            Print(j);
+            Print(mod);
+            Print(modulus(j));
+            Error("QN::read: charge modulus in file does not match QN::modulus");
+            }
+        }
+    s.read((char*)q_.data(),sizeof(int)*n); 
+    }
+
+size_t inline QN::
+hash() const
+    {
+    size_t h = 0;
+    for(int c : q_) h = (h ^ static_cast<unsigned>(c))*1099511628211ul;
+    return h;
     }
 
 std::string inline QN::
 toString() const
-    { return format("(%+d:%d)",sz_,Nf_); }
+    { 
+    std::string s = format("(%+d:%d",sz(),Nf());
+    for(int n = NfpCharge+1; n < nCharges(); ++n) s += format(":%d",charge(n));
+    return s + ")";
+    }
 
 inline std::ostream& 
 operator<<(std::ostream &o, const QN &q)
     { 
-    return o << format("(sz=%d, Nf=%d, p=%d)",q.sz(),q.Nf(),q.Nfp());
+    o << format("(sz=%d, Nf=%d, p=%d",q.sz(),q.Nf(),q.Nfp());
+    for(int n = QN::NfpCharge+1; n < QN::nCharges(); ++n) 
+        {
+        o << format(", q%d=%d",n,q.charge(n));
+        }
+    return o << ")";
     }
 
 bool inline
 operator==(const QN &a,const QN &b)
     { 
-    return a.sz() == b.sz() 
-        && a.Nf() == b.Nf() 
-        && a.Nfp() == b.Nfp(); 
+    for(int n = 0; n < QN::MaxCharges; ++n)
+        {
+        if(a.charge(n) != b.charge(n)) return false;
+        }
+    return true;
     }
 
 bool inline
 operator!=(const QN &a,const QN &b)
     { 
-    return a.sz() != b.sz() 
-        || a.Nf() != b.Nf() 
-        || a.Nfp() != b.Nfp(); 
+    return !(a == b);
     }
 
 bool inline
 operator<(const QN &a,const QN &b)
     { 
-    return a.sz() < b.sz() 
-        || (a.sz() == b.sz() && a.Nf() < b.Nf()) 
-        || (a.sz() == b.sz() && a.Nf() == b.Nf() && a.Nfp() < b.Nfp()); 
+    for(int n = 0; n < QN::MaxCharges; ++n)
+        {
+        if(a.charge(n) != b.charge(n)) return a.charge(n) < b.charge(n);
+        }
+    return false;
     }
 
 QN inline
@@ -227,4 +386,15 @@ operator*(Arrow dir, QN q)
 
 #undef DEF_NMAX
 
+namespace std {
+
+template<>
+struct hash<itensor::QN>
+    {
+    size_t
+    operator()(const itensor::QN& q) const { return q.hash(); }
+    };
+
+} //namespace std
+
 #endif
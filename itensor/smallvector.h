@@ -0,0 +1,254 @@
+//
+// Distributed under the ITensor Library License, Version 1.1.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_SMALLVECTOR_H
+#define __ITENSOR_SMALLVECTOR_H
+
+#include <array>
+#include <memory>
+#include <algorithm>
+#include <initializer_list>
+#include <stdexcept>
+
+namespace itensor {
+
+//
+// SmallVector
+//
+// Sequence container which keeps up to N elements
+// in a fixed array inside the object itself, and only
+// allocates from the heap once it grows beyond that.
+//
+// Intended for short lists (indices of a tensor,
+// counter ranges, etc.) whose length is almost always
+// small but must not have a hard upper limit.
+//
+// Unlike std::vector, SmallVector<bool,N> stores
+// actual bools, so data() and references work as
+// for any other element type.
+//
+template<typename T, size_t N>
+class SmallVector
+    {
+    public:
+
+    using value_type = T;
+    using size_type = size_t;
+    using reference = T&;
+    using const_reference = const T&;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    SmallVector() { }
+
+    explicit
+    SmallVector(size_type size,
+                const T& val = T())
+        {
+        resize(size,val);
+        }
+
+    SmallVector(std::initializer_list<T> il)
+        {
+        resize(il.size());
+        std::copy(il.begin(),il.end(),data());
+        }
+
+    SmallVector(const SmallVector& other) { copyFrom(other); }
+
+    SmallVector(SmallVector&& other) { moveFrom(other); }
+
+    SmallVector&
+    operator=(const SmallVector& other)
+        {
+        if(this != &other) copyFrom(other);
+        return *this;
+        }
+
+    SmallVector&
+    operator=(SmallVector&& other)
+        {
+        if(this != &other) moveFrom(other);
+        return *this;
+        }
+
+    size_type
+    size() const { return size_; }
+
+    bool
+    empty() const { return size_ == 0; }
+
+    size_type
+    capacity() const { return cap_; }
+
+    //True if the elements are stored inside the object
+    bool
+    isSmall() const { return !large_; }
+
+    T*
+    data() { return large_ ? large_.get() : small_.data(); }
+    const T*
+    data() const { return large_ ? large_.get() : small_.data(); }
+
+    T&
+    operator[](size_type j) { return data()[j]; }
+    const T&
+    operator[](size_type j) const { return data()[j]; }
+
+    T&
+    at(size_type j) { checkRange(j); return data()[j]; }
+    const T&
+    at(size_type j) const { checkRange(j); return data()[j]; }
+
+    T&
+    front() { return data()[0]; }
+    const T&
+    front() const { return data()[0]; }
+
+    T&
+    back() { return data()[size_-1]; }
+    const T&
+    back() const { return data()[size_-1]; }
+
+    iterator
+    begin() { return data(); }
+    iterator
+    end() { return data()+size_; }
+
+    const_iterator
+    begin() const { return data(); }
+    const_iterator
+    end() const { return data()+size_; }
+
+    //Elements added by resize are set to val
+    void
+    resize(size_type size,
+           const T& val = T())
+        {
+        reserve(size);
+        T* d = data();
+        for(size_type j = size_; j < size; ++j) d[j] = val;
+        size_ = size;
+        }
+
+    //Only ever grows the capacity
+    void
+    reserve(size_type cap)
+        {
+        if(cap <= cap_) return;
+        cap = std::max(cap,2*cap_);
+        std::unique_ptr<T[]> nl(new T[cap]);
+        std::move(data(),data()+size_,nl.get());
+        large_.swap(nl);
+        cap_ = cap;
+        }
+
+    void
+    push_back(const T& val)
+        {
+        if(size_ == cap_) reserve(size_+1);
+        data()[size_] = val;
+        ++size_;
+        }
+
+    void
+    assign(size_type size,
+           const T& val)
+        {
+        reserve(size);
+        std::fill(data(),data()+size,val);
+        size_ = size;
+        }
+
+    void
+    fill(const T& val) { std::fill(begin(),end(),val); }
+
+    void
+    clear() { size_ = 0; }
+
+    void
+    swap(SmallVector& other)
+        {
+        //The inline arrays can only be exchanged
+        //element by element, so only the elements
+        //in use are swapped
+        const size_type ns = std::max(size_,other.size_);
+        if(ns <= N)
+            {
+            std::swap_ranges(small_.begin(),small_.begin()+ns,other.small_.begin());
+            }
+        else
+            {
+            small_.swap(other.small_);
+            }
+        large_.swap(other.large_);
+        std::swap(size_,other.size_);
+        std::swap(cap_,other.cap_);
+        }
+
+    private:
+
+    ///////////
+    std::array<T,N> small_;
+    std::unique_ptr<T[]> large_;
+    size_type size_ = 0,
+              cap_ = N;
+    ///////////
+
+    void
+    checkRange(size_type j) const
+        {
+        if(j >= size_) throw std::out_of_range("SmallVector index out of range");
+        }
+
+    void
+    copyFrom(const SmallVector& other)
+        {
+        size_ = 0;
+        reserve(other.size_);
+        std::copy(other.begin(),other.end(),data());
+        size_ = other.size_;
+        }
+
+    void
+    moveFrom(SmallVector& other)
+        {
+        if(other.large_)
+            {
+            large_.swap(other.large_);
+            cap_ = other.cap_;
+            size_ = other.size_;
+            other.large_.reset();
+            other.cap_ = N;
+            other.size_ = 0;
+            }
+        else
+            {
+            copyFrom(other);
+            }
+        }
+
+    };
+
+template<typename T, size_t N>
+void
+swap(SmallVector<T,N>& a, SmallVector<T,N>& b) { a.swap(b); }
+
+template<typename T, size_t N>
+bool
+operator==(const SmallVector<T,N>& a, const SmallVector<T,N>& b)
+    {
+    return a.size() == b.size() && std::equal(a.begin(),a.end(),b.begin());
+    }
+
+template<typename T, size_t N>
+bool
+operator!=(const SmallVector<T,N>& a, const SmallVector<T,N>& b)
+    {
+    return !(a == b);
+    }
+
+} //namespace itensor
+
+#endif
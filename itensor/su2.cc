@@ -0,0 +1,150 @@
+//
+// Distributed under the ITensor Library License, Version 1.1.
+//    (See accompanying LICENSE file.)
+//
+#include "su2.h"
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <unordered_map>
+
+namespace itensor {
+
+//Most 6j symbols cached (per thread)
+const size_t MaxCached6j = 1ul << 16;
+
+//Logarithm of n!
+Real static
+logFact(int n)
+    {
+    return std::lgamma(n+1.);
+    }
+
+//Logarithm of the triangle coefficient
+//(a+b-c)!(a-b+c)!(-a+b+c)!/(a+b+c+1)!
+Real static
+logDelta(int ta, int tb, int tc)
+    {
+    return logFact((ta+tb-tc)/2)+logFact((ta-tb+tc)/2)
+          +logFact((-ta+tb+tc)/2)-logFact((ta+tb+tc)/2+1);
+    }
+
+Real static
+phase(int n)
+    {
+    return (std::abs(n)%2 == 0 ? 1. : -1.);
+    }
+
+//True if tm/2 is a valid projection of spin tj/2
+bool static
+validProjection(int tj, int tm)
+    {
+    return std::abs(tm) <= tj && (tj+tm)%2 == 0;
+    }
+
+bool
+su2Triangle(int ta, int tb, int tc)
+    {
+    if(ta < 0 || tb < 0 || tc < 0) return false;
+    if((ta+tb+tc)%2 != 0) return false;
+    return std::abs(ta-tb) <= tc && tc <= ta+tb;
+    }
+
+Real
+clebschGordan(int tj1, int tm1,
+              int tj2, int tm2,
+              int tj, int tm)
+    {
+    if(tm1+tm2 != tm) return 0;
+    if(!su2Triangle(tj1,tj2,tj)) return 0;
+    if(!validProjection(tj1,tm1)
+       || !validProjection(tj2,tm2)
+       || !validProjection(tj,tm)) return 0;
+
+    //Racah's formula
+    const Real pre = 0.5*(std::log(tj+1.)+logDelta(tj1,tj2,tj)
+                         +logFact((tj+tm)/2)+logFact((tj-tm)/2)
+                         +logFact((tj1+tm1)/2)+logFact((tj1-tm1)/2)
+                         +logFact((tj2+tm2)/2)+logFact((tj2-tm2)/2));
+
+    const int a = (tj1+tj2-tj)/2,
+              b = (tj1-tm1)/2,
+              c = (tj2+tm2)/2,
+              d = (tj-tj2+tm1)/2,
+              e = (tj-tj1-tm2)/2;
+    const int kmin = std::max(0,std::max(-d,-e)),
+              kmax = std::min(a,std::min(b,c));
+    Real sum = 0;
+    for(int k = kmin; k <= kmax; ++k)
+        {
+        sum += phase(k)*std::exp(pre-logFact(k)-logFact(a-k)-logFact(b-k)
+                                 -logFact(c-k)-logFact(d+k)-logFact(e+k));
+        }
+    return sum;
+    }
+
+Real
+wigner3j(int tj1, int tm1,
+         int tj2, int tm2,
+         int tj3, int tm3)
+    {
+    if(tm1+tm2+tm3 != 0) return 0;
+    const Real cg = clebschGordan(tj1,tm1,tj2,tm2,tj3,-tm3);
+    if(cg == 0) return 0;
+    return phase((tj1-tj2-tm3)/2)*cg/std::sqrt(tj3+1.);
+    }
+
+Real static
+computeWigner6j(int tj1, int tj2, int tj3,
+                int tj4, int tj5, int tj6)
+    {
+    if(!su2Triangle(tj1,tj2,tj3) || !su2Triangle(tj1,tj5,tj6)
+       || !su2Triangle(tj4,tj2,tj6) || !su2Triangle(tj4,tj5,tj3)) return 0;
+
+    //Racah's formula
+    const Real pre = 0.5*(logDelta(tj1,tj2,tj3)+logDelta(tj1,tj5,tj6)
+                         +logDelta(tj4,tj2,tj6)+logDelta(tj4,tj5,tj3));
+
+    const int a1 = (tj1+tj2+tj3)/2,
+              a2 = (tj1+tj5+tj6)/2,
+              a3 = (tj4+tj2+tj6)/2,
+              a4 = (tj4+tj5+tj3)/2,
+              b1 = (tj1+tj2+tj4+tj5)/2,
+              b2 = (tj2+tj3+tj5+tj6)/2,
+              b3 = (tj3+tj1+tj6+tj4)/2;
+    const int tmin = std::max(std::max(a1,a2),std::max(a3,a4)),
+              tmax = std::min(b1,std::min(b2,b3));
+    Real sum = 0;
+    for(int t = tmin; t <= tmax; ++t)
+        {
+        sum += phase(t)*std::exp(pre+logFact(t+1)
+                                 -logFact(t-a1)-logFact(t-a2)-logFact(t-a3)-logFact(t-a4)
+                                 -logFact(b1-t)-logFact(b2-t)-logFact(b3-t));
+        }
+    return sum;
+    }
+
+Real
+wigner6j(int tj1, int tj2, int tj3,
+         int tj4, int tj5, int tj6)
+    {
+    //Pack the arguments into a key if they fit in 10 bits each
+    const int targs[6] = { tj1, tj2, tj3, tj4, tj5, tj6 };
+    unsigned long long key = 0;
+    for(int t : targs)
+        {
+        if(t < 0 || t >= 1024) return computeWigner6j(tj1,tj2,tj3,tj4,tj5,tj6);
+        key = (key << 10) | static_cast<unsigned long long>(t);
+        }
+
+    thread_local std::unordered_map<unsigned long long,Real> cache;
+    auto it = cache.find(key);
+    if(it != cache.end()) return it->second;
+
+    const Real val = computeWigner6j(tj1,tj2,tj3,tj4,tj5,tj6);
+    if(cache.size() >= MaxCached6j) cache.clear();
+    cache.emplace(key,val);
+    return val;
+    }
+
+} //namespace itensor
@@ -0,0 +1,54 @@
+//
+// Distributed under the ITensor Library License, Version 1.1.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_SU2_H
+#define __ITENSOR_SU2_H
+
+#include "global.h"
+
+namespace itensor {
+
+//
+// SU(2) recoupling coefficients
+//
+// Spins and their projections are passed as twice their
+// value (tj = 2j, tm = 2m) so that half-integer spins are
+// integers: spin 1/2 with projection -1/2 is (1,-1).
+//
+// Coefficients which vanish by selection rules (triangle
+// conditions, projections out of range or not summing up)
+// are returned as zero.
+//
+
+//True if spins ta/2, tb/2, tc/2 can couple to zero:
+//|a-b| <= c <= a+b with a+b+c an integer
+bool
+su2Triangle(int ta, int tb, int tc);
+
+//Clebsch-Gordan coefficient <j1 m1; j2 m2 | j m>
+//(Condon-Shortley phase convention)
+Real
+clebschGordan(int tj1, int tm1,
+              int tj2, int tm2,
+              int tj, int tm);
+
+//Wigner 3j symbol ( j1 j2 j3 )
+//                 ( m1 m2 m3 )
+Real
+wigner3j(int tj1, int tm1,
+         int tj2, int tm2,
+         int tj3, int tm3);
+
+//Wigner 6j symbol { j1 j2 j3 }
+//                 { j4 j5 j6 }
+//
+//Values are cached (per thread), since recoupling
+//the same multiplets comes up over and over.
+Real
+wigner6j(int tj1, int tj2, int tj3,
+         int tj4, int tj5, int tj6);
+
+} //namespace itensor
+
+#endif
@@ -0,0 +1,368 @@
+//
+// Distributed under the ITensor Library License, Version 1.1.
+//    (See accompanying LICENSE file.)
+//
+#include "su2tensor.h"
+#include "svd.h"
+#include <algorithm>
+
+namespace itensor {
+
+using std::vector;
+
+Real static
+phase(int n)
+    {
+    return (std::abs(n)%2 == 0 ? 1. : -1.);
+    }
+
+SU2Index& SU2Index::
+addMultiplet(int tj, int deg)
+    {
+    if(tj < 0) Error("addMultiplet: spin must be non-negative");
+    if(deg < 1) Error("addMultiplet: degeneracy must be at least 1");
+    for(auto& mp : mults_)
+        {
+        if(mp.tj == tj)
+            {
+            mp.deg += deg;
+            return *this;
+            }
+        }
+    Multiplet mp;
+    mp.tj = tj;
+    mp.deg = deg;
+    mults_.push_back(mp);
+    return *this;
+    }
+
+int SU2Index::
+degOf(int tj) const
+    {
+    for(const auto& mp : mults_)
+        {
+        if(mp.tj == tj) return mp.deg;
+        }
+    return 0;
+    }
+
+int SU2Index::
+m() const
+    {
+    int res = 0;
+    for(const auto& mp : mults_) res += mp.deg;
+    return res;
+    }
+
+int SU2Index::
+fullDim() const
+    {
+    int res = 0;
+    for(const auto& mp : mults_) res += mp.deg*(mp.tj+1);
+    return res;
+    }
+
+int SU2Index::
+fullOffset(int n) const
+    {
+    int res = 0;
+    for(int j = 0; j < n-1; ++j)
+        {
+        res += mults_.at(j).deg*(mults_.at(j).tj+1);
+        }
+    return res;
+    }
+
+SU2Tensor::
+SU2Tensor(const SU2Index& row,
+          const SU2Index& col,
+          int tk)
+    :
+    row_(row),
+    col_(col),
+    tk_(tk)
+    {
+    if(tk < 0) Error("SU2Tensor: tensor rank must be non-negative");
+    }
+
+Matrix& SU2Tensor::
+block(int tjr, int tjc)
+    {
+    auto it = blocks_.find(BlockKey(tjr,tjc));
+    if(it != blocks_.end()) return it->second;
+
+    const int dr = row_.degOf(tjr),
+              dc = col_.degOf(tjc);
+    if(dr == 0 || dc == 0)
+        {
+        Print(tjr);
+        Print(tjc);
+        Error("SU2Tensor::block: multiplet not in index");
+        }
+    if(!su2Triangle(tjr,tk_,tjc))
+        {
+        Print(tjr);
+        Print(tk_);
+        Print(tjc);
+        Error("SU2Tensor::block: block forbidden by triangle rule");
+        }
+
+    Matrix& M = blocks_[BlockKey(tjr,tjc)];
+    M.ReDimension(dr,dc);
+    M = 0;
+    return M;
+    }
+
+const Matrix* SU2Tensor::
+findBlock(int tjr, int tjc) const
+    {
+    auto it = blocks_.find(BlockKey(tjr,tjc));
+    if(it == blocks_.end()) return nullptr;
+    return &(it->second);
+    }
+
+void SU2Tensor::
+randomize()
+    {
+    for(int r = 1; r <= row_.nmult(); ++r)
+    for(int c = 1; c <= col_.nmult(); ++c)
+        {
+        if(!su2Triangle(row_.tj(r),tk_,col_.tj(c))) continue;
+        block(row_.tj(r),col_.tj(c)).Randomize();
+        }
+    }
+
+Real SU2Tensor::
+norm() const
+    {
+    Real nrm2 = 0;
+    for(const auto& b : blocks_)
+        {
+        const Matrix& M = b.second;
+        for(int i = 1; i <= M.Nrows(); ++i)
+        for(int j = 1; j <= M.Ncols(); ++j)
+            {
+            nrm2 += sqr(M(i,j));
+            }
+        }
+    return std::sqrt(nrm2);
+    }
+
+SU2Tensor& SU2Tensor::
+operator*=(Real fac)
+    {
+    for(auto& b : blocks_) b.second *= fac;
+    return *this;
+    }
+
+SU2Tensor& SU2Tensor::
+operator+=(const SU2Tensor& other)
+    {
+    if(other.tk_ != tk_) Error("SU2Tensor::operator+=: mismatched tensor ranks");
+    for(const auto& b : other.blocks_)
+        {
+        block(b.first.first,b.first.second) += b.second;
+        }
+    return *this;
+    }
+
+Matrix SU2Tensor::
+toMatrix(int tq) const
+    {
+    Matrix res(row_.fullDim(),col_.fullDim());
+    res = 0;
+    if(std::abs(tq) > tk_ || (tk_+tq)%2 != 0) return res;
+
+    for(int r = 1; r <= row_.nmult(); ++r)
+    for(int c = 1; c <= col_.nmult(); ++c)
+        {
+        const int tjr = row_.tj(r),
+                  tjc = col_.tj(c);
+        const Matrix* M = findBlock(tjr,tjc);
+        if(!M) continue;
+
+        const int roff = row_.fullOffset(r),
+                  coff = col_.fullOffset(c);
+        for(int tmr = tjr; tmr >= -tjr; tmr -= 2)
+            {
+            //Only mc = mr-q gives a non-zero 3j symbol
+            const int tmc = tmr-tq;
+            if(std::abs(tmc) > tjc) continue;
+            const Real coef = phase((tjr-tmr)/2)*wigner3j(tjr,-tmr,tk_,tq,tjc,tmc);
+            if(coef == 0) continue;
+            const int ir = (tjr-tmr)/2,
+                      ic = (tjc-tmc)/2;
+            for(int a = 1; a <= M->Nrows(); ++a)
+            for(int b = 1; b <= M->Ncols(); ++b)
+                {
+                res(roff+(a-1)*(tjr+1)+ir+1,coff+(b-1)*(tjc+1)+ic+1) = coef*(*M)(a,b);
+                }
+            }
+        }
+    return res;
+    }
+
+SU2Tensor
+product(const SU2Tensor& A, const SU2Tensor& B, int tK)
+    {
+    const int tk1 = A.tk_,
+              tk2 = B.tk_;
+    if(!su2Triangle(tk1,tk2,tK))
+        {
+        Print(tk1);
+        Print(tk2);
+        Print(tK);
+        Error("product: ranks do not couple to tK");
+        }
+    if(A.col_.fullDim() != B.row_.fullDim())
+        {
+        Error("product: column index of A does not match row index of B");
+        }
+
+    SU2Tensor res(A.row_,B.col_,tK);
+    for(const auto& a : A.blocks_)
+    for(const auto& b : B.blocks_)
+        {
+        const int tj = a.first.first,
+                  tjpp = a.first.second,
+                  tjp = b.first.second;
+        if(b.first.first != tjpp) continue;
+        if(!su2Triangle(tj,tK,tjp)) continue;
+
+        const Real coef = phase((tK+tj+tjp)/2)*std::sqrt(tK+1.)
+                         *wigner6j(tk1,tk2,tK,tjp,tj,tjpp);
+        if(coef == 0) continue;
+        res.block(tj,tjp) += coef*(a.second*b.second);
+        }
+    return res;
+    }
+
+SU2Tensor
+operator*(const SU2Tensor& A, const SU2Tensor& B)
+    {
+    if(A.tk() != 0 || B.tk() != 0)
+        {
+        Error("operator*: both tensors must be scalars, use product(A,B,tK) instead");
+        }
+    return product(A,B,0);
+    }
+
+Real
+svd(const SU2Tensor& T,
+    SU2Tensor& U, SU2Tensor& D, SU2Tensor& V,
+    const Args& args)
+    {
+    if(T.tk_ != 0) Error("svd: SU2Tensor must be a scalar");
+
+    const Real cutoff = args.getReal("Cutoff",MIN_CUT);
+    const int maxm = args.getInt("Maxm",MAX_M);
+
+    struct BlockSVD
+        {
+        int tj = 0;
+        Matrix U, V;
+        Vector d;
+        };
+    vector<BlockSVD> bsvd;
+    bsvd.reserve(T.blocks_.size());
+
+    //A multiplet state (tj,n) with reduced singular value d
+    //has weight d^2 split over tj+1 degenerate states
+    struct State
+        {
+        Real p = 0;
+        int tj = 0,
+            block = 0,
+            n = 0;
+        };
+    vector<State> states;
+
+    Real total = 0;
+    for(const auto& b : T.blocks_)
+        {
+        BlockSVD B;
+        B.tj = b.first.first;
+        SVD(b.second,B.U,B.d,B.V);
+        for(int n = 1; n <= B.d.Length(); ++n)
+            {
+            State s;
+            s.p = sqr(B.d(n))/(B.tj+1);
+            s.tj = B.tj;
+            s.block = int(bsvd.size());
+            s.n = n;
+            states.push_back(s);
+            total += sqr(B.d(n));
+            }
+        bsvd.push_back(B);
+        }
+
+    std::stable_sort(states.begin(),states.end(),
+                     [](const State& s1, const State& s2) { return s1.p > s2.p; });
+
+    //Keep the largest states up to maxm, then drop
+    //the smallest ones while the truncation error
+    //stays below the cutoff; always keep one multiplet
+    int nkeep = 0,
+        mkeep = 0;
+    for(const auto& s : states)
+        {
+        if(nkeep > 0 && mkeep+s.tj+1 > maxm) break;
+        mkeep += s.tj+1;
+        ++nkeep;
+        }
+    Real truncerr = 0;
+    for(size_t n = nkeep; n < states.size(); ++n)
+        {
+        truncerr += states[n].p*(states[n].tj+1);
+        }
+    while(nkeep > 1)
+        {
+        const State& s = states[nkeep-1];
+        const Real w = s.p*(s.tj+1);
+        if(total == 0 || (truncerr+w)/total > cutoff) break;
+        truncerr += w;
+        --nkeep;
+        }
+
+    vector<vector<int>> kept(bsvd.size());
+    for(int n = 0; n < nkeep; ++n)
+        {
+        kept[states[n].block].push_back(states[n].n);
+        }
+
+    SU2Index link;
+    for(size_t b = 0; b < bsvd.size(); ++b)
+        {
+        if(!kept[b].empty()) link.addMultiplet(bsvd[b].tj,int(kept[b].size()));
+        }
+
+    U = SU2Tensor(T.row_,link,0);
+    D = SU2Tensor(link,link,0);
+    V = SU2Tensor(link,T.col_,0);
+
+    //Rescale U and V by sqrt(2j+1) so that the full
+    //operators are isometries (see toMatrix)
+    for(size_t b = 0; b < bsvd.size(); ++b)
+        {
+        if(kept[b].empty()) continue;
+        const BlockSVD& B = bsvd[b];
+        const Real sq = std::sqrt(B.tj+1.);
+        std::sort(kept[b].begin(),kept[b].end());
+
+        Matrix& Um = U.block(B.tj,B.tj);
+        Matrix& Dm = D.block(B.tj,B.tj);
+        Matrix& Vm = V.block(B.tj,B.tj);
+        for(size_t j = 0; j < kept[b].size(); ++j)
+            {
+            const int n = kept[b][j],
+                      k = int(j)+1;
+            Um.Column(k) = sq*B.U.Column(n);
+            Dm(k,k) = B.d(n);
+            Vm.Row(k) = sq*B.V.Row(n);
+            }
+        }
+
+    return (total == 0 ? 0. : truncerr/total);
+    }
+
+} //namespace itensor
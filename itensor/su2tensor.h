@@ -0,0 +1,224 @@
+//
+// Distributed under the ITensor Library License, Version 1.1.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_SU2TENSOR_H
+#define __ITENSOR_SU2TENSOR_H
+
+#include "su2.h"
+#include "matrix.h"
+#include <map>
+#include <vector>
+
+namespace itensor {
+
+//
+// SU2Index
+//
+// A space spanned by SU(2) multiplets. Each multiplet
+// has a spin tj/2 (spins are passed as twice their value,
+// as in su2.h) and a degeneracy: the number of copies of
+// that multiplet. Only one state per copy is stored, the
+// 2j+1 projections being implied, so m() can be much
+// smaller than the dimension fullDim() of the space.
+//
+// The full basis is ordered by multiplet, then by copy,
+// then by projection from +j down to -j.
+//
+
+class SU2Index
+    {
+    public:
+
+    SU2Index() { }
+
+    //Add deg copies of the spin tj/2 multiplet
+    //(or deg more copies if it is already present)
+    SU2Index&
+    addMultiplet(int tj, int deg);
+
+    //Number of distinct multiplets
+    int
+    nmult() const { return int(mults_.size()); }
+
+    //Spin and degeneracy of multiplet n = 1,...,nmult()
+    int
+    tj(int n) const { return mults_.at(n-1).tj; }
+    int
+    deg(int n) const { return mults_.at(n-1).deg; }
+
+    //Degeneracy of the spin tj/2 multiplet, zero if absent
+    int
+    degOf(int tj) const;
+
+    //Number of stored (reduced) states
+    int
+    m() const;
+
+    //Dimension counting all projections
+    int
+    fullDim() const;
+
+    //Position in the full basis, starting from 0, of the
+    //first state of multiplet n
+    int
+    fullOffset(int n) const;
+
+    private:
+
+    struct Multiplet
+        {
+        int tj = 0,
+            deg = 0;
+        };
+
+    std::vector<Multiplet> mults_;
+
+    };
+
+//
+// SU2Tensor
+//
+// Irreducible tensor operator T^k of spin tk/2 mapping
+// the space col() to the space row(), stored through its
+// reduced matrix elements (Wigner-Eckart theorem):
+//
+// <jr mr,a| T^k_q |jc mc,b>
+//     = (-1)^(jr-mr) ( jr  k  jc ) <jr,a||T||jc,b>
+//                    (-mr  q  mc )
+//
+// where a, b label copies of the multiplets. The reduced
+// elements for each pair of multiplets form a block
+// Matrix of size row().degOf(tjr) x col().degOf(tjc);
+// blocks forbidden by the triangle rule for (jr,k,jc)
+// are never stored.
+//
+// Scalar (tk == 0) tensors are the SU(2) invariant
+// operators such as Hamiltonians, density matrices and
+// bond tensors of a symmetric MPS.
+//
+// This is groundwork for SU(2) symmetric MPS: only
+// two-index (operator-like) tensors are supported. There
+// are no multi-leg reduced tensors yet, and SU2Tensor
+// cannot be used as the tensor type of MPSt, MPOt or
+// DMRGWorker.
+//
+
+class SU2Tensor
+    {
+    public:
+
+    SU2Tensor() { }
+
+    SU2Tensor(const SU2Index& row,
+              const SU2Index& col,
+              int tk = 0);
+
+    const SU2Index&
+    row() const { return row_; }
+
+    const SU2Index&
+    col() const { return col_; }
+
+    int
+    tk() const { return tk_; }
+
+    //Number of stored blocks
+    int
+    nblocks() const { return int(blocks_.size()); }
+
+    //Reduced matrix elements <jr||T||jc>, created
+    //(zero) on first access
+    Matrix&
+    block(int tjr, int tjc);
+
+    //Null if block (tjr,tjc) is not stored
+    const Matrix*
+    findBlock(int tjr, int tjc) const;
+
+    //Fill every allowed block with random values
+    void
+    randomize();
+
+    //Norm of the full operator, summed over all
+    //components q (equal to the norm of the
+    //reduced elements by orthogonality of the 3j symbols)
+    Real
+    norm() const;
+
+    SU2Tensor&
+    operator*=(Real fac);
+
+    SU2Tensor&
+    operator+=(const SU2Tensor& other);
+
+    //Component q = tq/2 of the operator in the full basis,
+    //a row().fullDim() x col().fullDim() Matrix
+    Matrix
+    toMatrix(int tq = 0) const;
+
+    private:
+
+    using BlockKey = std::pair<int,int>;
+
+    SU2Index row_,
+             col_;
+    int tk_ = 0;
+    std::map<BlockKey,Matrix> blocks_;
+
+    friend SU2Tensor
+    product(const SU2Tensor& A, const SU2Tensor& B, int tK);
+
+    friend Real
+    svd(const SU2Tensor& T,
+        SU2Tensor& U, SU2Tensor& D, SU2Tensor& V,
+        const Args& args);
+
+    };
+
+//
+// Coupled product of A^k1 and B^k2 with A's column index
+// contracted with B's row index:
+//
+// [A x B]^K_Q = sum_{q1,q2} <k1 q1 k2 q2|K Q> A_q1 B_q2
+//
+// Computed from the reduced elements alone, through
+//
+// <j||[A x B]^K||j'> = (-1)^(K+j+j') sqrt(2K+1)
+//     sum_j'' { k1 k2 K } <j||A||j''><j''||B||j'>
+//             { j' j  j'' }
+//
+// so no projection is ever enumerated.
+//
+SU2Tensor
+product(const SU2Tensor& A, const SU2Tensor& B, int tK);
+
+//
+// Ordinary operator product of two scalar tensors
+// (product(A,B,0) for tk() == 0)
+//
+SU2Tensor
+operator*(const SU2Tensor& A, const SU2Tensor& B);
+
+//
+// Singular value decomposition T = U*D*V of a scalar
+// tensor, computed block by block. U maps the new link
+// space to T.row() and V maps T.col() to the link; the
+// full U and V operators are isometries. D is diagonal
+// and holds the reduced singular values: its multiplet
+// of spin j carries 2j+1 degenerate singular values of
+// the full operator, each equal to d/sqrt(2j+1).
+//
+// Truncation uses the Args "Cutoff" (truncation error,
+// relative to norm(T)^2) and "Maxm" (counting all
+// projections, so a spin j multiplet uses 2j+1 states).
+// Returns the truncation error.
+//
+Real
+svd(const SU2Tensor& T,
+    SU2Tensor& U, SU2Tensor& D, SU2Tensor& V,
+    const Args& args = Global::args());
+
+} //namespace itensor
+
+#endif
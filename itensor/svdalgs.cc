@@ -3,7 +3,11 @@
 //    (See accompanying LICENSE file.)
 //
 #include "svdalgs.h"
+#include "lapack_wrap.h"
+#include "detail/parallel.h"
 #include <algorithm>
+#include <functional>
+#include <numeric>
 
 namespace itensor {
 
@@ -44,18 +48,316 @@ struct EigQN
     };
 
 
+//
+// SVD routine for the blocks of svdRank2, selected
+// by the "SVDMethod" arg:
+//
+//   "DensityMatrix" (default for real A): diagonalizes A*A.t(),
+//        then refines the small singular values (see SVD in 
+//        matrix/svd.h; "SVDThreshold" sets when to refine)
+//   "gesdd" (default for complex A): LAPACK divide and conquer
+//   "gesvd": LAPACK QR iteration (slower, most robust)
+//   "Randomized": randomized SVD computing only the leading
+//        singular values (see randomizedRank below), otherwise
+//        the same as the default
+//
+// Complex matrices are decomposed by zgesdd for every method
+// but "DensityMatrix", which works with the real and imaginary
+// parts separately and so does several times the work.
+//
+enum class SVDMethod { DensityMatrix, Gesdd, Gesvd, Randomized };
+
+SVDMethod static
+svdMethod(const Args& args, bool cplx = false)
+    {
+    const auto name = args.getString("SVDMethod",cplx ? "gesdd" : "DensityMatrix");
+    if(name == "DensityMatrix") return SVDMethod::DensityMatrix;
+    if(name == "gesdd") return SVDMethod::Gesdd;
+    if(name == "gesvd") return SVDMethod::Gesvd;
+    if(name == "Randomized") return SVDMethod::Randomized;
+    Error(format("Unknown SVDMethod=\"%s\"",name));
+    return SVDMethod::DensityMatrix;
+    }
+
+void static
+svdMatrix(SVDMethod method,
+          const MatrixRef& M, 
+          Matrix& U, Vector& D, Matrix& V,
+          Real thresh)
+    {
+    if(method == SVDMethod::Gesdd || method == SVDMethod::Gesvd) 
+        SVDLapack(M,U,D,V,method == SVDMethod::Gesdd);
+    else 
+        SVD(M,U,D,V,thresh);
+    }
+
+void static
+svdMatrix(SVDMethod method,
+          const MatrixRef& Mre, const MatrixRef& Mim, 
+          Matrix& Ure, Matrix& Uim, 
+          Vector& D, 
+          Matrix& Vre, Matrix& Vim,
+          Real thresh)
+    {
+    if(method == SVDMethod::DensityMatrix) 
+        SVD(Mre,Mim,Ure,Uim,D,Vre,Vim,thresh);
+    else 
+        SVDComplex(Mre,Mim,Ure,Uim,D,Vre,Vim);
+    }
+
+//Truncation settings used to pick the rank
+//of randomized decompositions
+struct RandomizedArgs
+    {
+    int maxm = MAX_M,
+        minm = 1,
+        oversample = 10,
+        niter = 2;
+    Real cutoff = MIN_CUT;
+    bool absoluteCutoff = false,
+         doRelCutoff = false;
+    };
+
+RandomizedArgs static
+randomizedArgs(const Args& args)
+    {
+    RandomizedArgs r;
+    r.maxm = args.getInt("Maxm",MAX_M);
+    r.minm = args.getInt("Minm",1);
+    r.oversample = args.getInt("RSVDOversample",10);
+    r.niter = args.getInt("RSVDPowerIter",2);
+    r.cutoff = args.getReal("Cutoff",MIN_CUT);
+    r.absoluteCutoff = args.getBool("AbsoluteCutoff",false);
+    r.doRelCutoff = args.getBool("DoRelCutoff",false);
+    return r;
+    }
+
+//Largest part of the weight discarded anyway to keep
+//Maxm states which the weight missed by a randomized
+//decomposition may add to it
+const Real MaxMissedFrac = 0.1;
+
+//Picks the rank of a randomized decomposition of a matrix
+//of smaller dimension mind. decomp(l,w) computes the leading
+//l weights w (squared singular values or density matrix
+//eigenvalues, largest first) and returns the weight they miss.
+//Starting from Maxm (or mind/4 if smaller), the rank doubles
+//until the missed weight is below the cutoff, or is a small
+//part of the weight discarded anyway to keep Maxm states.
+//Returns false, for the caller to decompose exactly, if the
+//rank gets too close to mind for randomization to pay off.
+template<typename Decomp>
+bool static
+randomizedRank(int mind,
+               const RandomizedArgs& r,
+               Decomp&& decomp,
+               Real& missed)
+    {
+    int k = max(r.minm,min(r.maxm,mind/4));
+    while(2*(k+r.oversample) <= mind)
+        {
+        const int l = k+r.oversample;
+        Vector w;
+        missed = decomp(l,w);
+
+        Real tol = r.cutoff;
+        if(r.doRelCutoff && !r.absoluteCutoff) tol *= w(1);
+        if(missed <= tol) return true;
+
+        if(k >= r.maxm)
+            {
+            Real disc = 0;
+            for(int j = k+1; j <= l; ++j) disc += w(j);
+            if(missed <= MaxMissedFrac*disc) return true;
+            break;
+            }
+        k = min(2*k,r.maxm);
+        }
+    missed = 0;
+    return false;
+    }
+
+bool static
+randomizedSVD(const MatrixRef& M, 
+              Matrix& U, Vector& D, Matrix& V,
+              const RandomizedArgs& r,
+              Real& missed)
+    {
+    const int mind = min(M.Nrows(),M.Ncols());
+    return randomizedRank(mind,r,[&](int l, Vector& w)
+        {
+        const Real mw = RandomizedSVD(M,U,D,V,l,r.niter);
+        w = D;
+        for(int j = 1; j <= w.Length(); ++j) w(j) *= w(j);
+        return mw;
+        },missed);
+    }
+
+//Randomized diagonalization of a block M of a density matrix,
+//proportional to rho if posScale is true and to -rho otherwise.
+//The eigenvalues D have the same sign as those of M.
+bool static
+randomizedEigen(Matrix& M, bool posScale, 
+                Vector& D, Matrix& U,
+                const RandomizedArgs& r,
+                Real& missed)
+    {
+    if(!posScale) M *= -1;
+    const bool ok = randomizedRank(M.Nrows(),r,[&](int l, Vector& w)
+        {
+        const Real mw = RandomizedEigenValues(M,D,U,l,r.niter);
+        w = D;
+        return mw;
+        },missed);
+    if(!posScale) 
+        {
+        M *= -1;
+        D *= -1;
+        }
+    return ok;
+    }
+
+//Diagonalizes a block M proportional to minus a density
+//matrix, so that eigenvalues come largest weight first,
+//computing only the first k eigenpairs if k < M.Nrows().
+//Returns the weight of the others (part of the trace of M),
+//which truncation counts as discarded.
+Real static
+partialEigen(const Matrix& M, int k, Vector& D, Matrix& U)
+    {
+    if(k >= M.Nrows())
+        {
+        EigenValues(M,D,U);
+        return 0;
+        }
+    LowestEigenValues(M,D,U,k);
+    return max(0.,D.sumels()-Trace(M));
+    }
+
+//Eigenpairs computed per block by a partial diagonalization
+//beyond the estimate of how many will be kept
+const int PartialEigPad = 8;
+
+//Number of eigenpairs to compute for each block (indices
+//aind, aind') of a density matrix when keeping at most maxm
+//states. The threshold for keeping a state is estimated as
+//the maxm-th largest diagonal element of rho; each block gets
+//twice as many eigenpairs as it has diagonal elements above
+//it, plus PartialEigPad, but never more than maxm.
+vector<int> static
+partialEigCounts(const vector<const ITensor*>& tblock,
+                 const vector<Index>& aind,
+                 int maxm)
+    {
+    vector<int> neig(tblock.size());
+    vector<vector<Real>> bdiag(tblock.size());
+    vector<Real> alldiag;
+    for(size_t b = 0; b < tblock.size(); ++b)
+        {
+        const Index& a = aind.at(b);
+        neig.at(b) = a.m();
+        for(int j = 1; j <= a.m(); ++j)
+            {
+            bdiag.at(b).push_back((*tblock.at(b))(a(j),prime(a)(j)));
+            }
+        alldiag.insert(alldiag.end(),bdiag.at(b).begin(),bdiag.at(b).end());
+        }
+    if(maxm < 1 || long(alldiag.size()) <= maxm) return neig;
+
+    auto nth = alldiag.begin()+(maxm-1);
+    std::nth_element(alldiag.begin(),nth,alldiag.end(),std::greater<Real>());
+    const Real thresh = *nth;
+
+    for(size_t b = 0; b < tblock.size(); ++b)
+        {
+        const auto& d = bdiag.at(b);
+        const int nabove = std::count_if(d.begin(),d.end(),[thresh](Real x) { return x >= thresh; });
+        neig.at(b) = min(neig.at(b),min(maxm,2*nabove+PartialEigPad));
+        }
+    return neig;
+    }
+
+//Least total cost (in flops, roughly) of decomposing
+//the blocks of an IQTensor for which they are
+//decomposed in parallel
+const double MinParallelWork = 1E6;
+
+//Calls f(k) for each block k = 0,1,...,cost.size()-1
+//of an IQTensor, given the cost of decomposing each.
+//The blocks are independent, so when there is enough
+//work they are done as parallel tasks, costliest first.
+template<typename Func>
+void static
+decompBlocks(const vector<double>& cost, Func&& f)
+    {
+    const double work = std::accumulate(cost.begin(),cost.end(),0.);
+    const int nthread = (work < MinParallelWork ? 1 : Global::nthread());
+    if(nthread <= 1 || cost.size() < 2)
+        {
+        for(size_t k = 0; k < cost.size(); ++k) f(k);
+        return;
+        }
+    vector<long> order(cost.size());
+    std::iota(order.begin(),order.end(),0);
+    std::stable_sort(order.begin(),order.end(),[&cost](long a, long b) 
+        { 
+        return cost[a] > cost[b]; 
+        });
+    SerialBlasScope serial;
+    detail::parallelTasks(order.size(),nthread,[&f,&order](long j)
+        {
+        SerialBlasScope serial;
+        f(order[j]);
+        });
+    }
+
+//Orders alleig from smallest to largest eigenvalue,
+//as truncate requires. If at most maxm eigenvalues can
+//be kept, only the largest maxm get sorted: the rest
+//are moved below them, with the largest of the rest
+//just below the sorted ones. Returns the number of
+//sorted eigenvalues (at the end of alleig).
+long static
+orderEigs(vector<EigQN>& alleig, int maxm, bool sortAll)
+    {
+    const long ndisc = long(alleig.size())-maxm;
+    if(sortAll || maxm < 1 || ndisc <= 0)
+        {
+        sort(alleig.begin(),alleig.end());
+        return alleig.size();
+        }
+    auto mid = alleig.begin()+ndisc;
+    std::nth_element(alleig.begin(),mid,alleig.end());
+    sort(mid,alleig.end());
+    std::iter_swap(std::max_element(alleig.begin(),mid),mid-1);
+    return maxm;
+    }
+
+//Makes sure the largest n eigenvalues in alleig are
+//sorted, given that the largest nsorted are
+void static
+sortLargest(vector<EigQN>& alleig, long& nsorted, long n)
+    {
+    if(n <= nsorted) return;
+    sort(alleig.begin(),alleig.end()-nsorted);
+    nsorted = alleig.size();
+    }
+
 Real static
 truncate(Vector& D,
          int maxm,
          int minm,
          Real cutoff,
          bool absoluteCutoff,
-         bool doRelCutoff)
+         bool doRelCutoff,
+         Real missed = 0)
     {
     int m = D.Length();
     if(m == 1) return 0;
 
-    Real truncerr = 0;
+    //Weight missed by a randomized decomposition
+    //counts as discarded
+    Real truncerr = missed;
 
     //Zero out any negative weight
     for(int zerom = m; zerom > 0; --zerom)
@@ -94,7 +396,8 @@ truncate(vector<EigQN>& alleig,
          int minm,
          Real cutoff,
          bool absoluteCutoff,
-         bool doRelCutoff)
+         bool doRelCutoff,
+         Real missed = 0)
     {
     m = (int)alleig.size();
     if(m == 1)
@@ -104,7 +407,7 @@ truncate(vector<EigQN>& alleig,
         }
     long mdisc = 0;
 
-    Real truncerr = 0;
+    Real truncerr = missed;
 
     if(absoluteCutoff)
         {
@@ -164,6 +467,7 @@ svdRank2(ITensor A, const Index& ui, const Index& vi,
     const bool doRelCutoff = args.getBool("DoRelCutoff",false);
     const bool absoluteCutoff = args.getBool("AbsoluteCutoff",false);
     const bool cplx = A.isComplex();
+    const SVDMethod method = svdMethod(args,cplx);
 
     if(A.r() != 2)
         {
@@ -173,13 +477,18 @@ svdRank2(ITensor A, const Index& ui, const Index& vi,
     Matrix UU,VV,
            iUU,iVV;
     Vector DD;
+    Real missed = 0;
 
     if(!cplx)
         {
         Matrix M;
         A.toMatrix11NoScale(ui,vi,M);
 
-        SVD(M,UU,DD,VV,thresh);
+        if(method != SVDMethod::Randomized || !do_truncate
+           || !randomizedSVD(M,UU,DD,VV,randomizedArgs(args),missed))
+            {
+            svdMatrix(method,M,UU,DD,VV,thresh);
+            }
         }
     else
         {
@@ -191,8 +500,7 @@ svdRank2(ITensor A, const Index& ui, const Index& vi,
         Are.toMatrix11NoScale(ui,vi,Mre);
         Aim.toMatrix11NoScale(ui,vi,Mim);
 
-        //SVDComplex(Mre,Mim,UU,iUU,DD,VV,iVV);
-        SVD(Mre,Mim,UU,iUU,DD,VV,iVV,thresh);
+        svdMatrix(method,Mre,Mim,UU,iUU,DD,VV,iVV,thresh);
         }
 
     //Truncate
@@ -206,7 +514,7 @@ svdRank2(ITensor A, const Index& ui, const Index& vi,
         Vector sqrD(DD);
         for(int j = 1; j <= sqrD.Length(); ++j)
             sqrD(j) = sqr(DD(j));
-        terr = truncate(sqrD,maxm,minm,cutoff,absoluteCutoff,doRelCutoff);
+        terr = truncate(sqrD,maxm,minm,cutoff,absoluteCutoff,doRelCutoff,missed);
         m = sqrD.Length();
         DD.ReduceDimension(m);
         }
@@ -309,6 +617,7 @@ svdRank2(IQTensor A, const IQIndex& uI, const IQIndex& vI,
     {
     auto cplx = A.isComplex();
     auto thresh = args.getReal("SVDThreshold",1E-4);
+    auto method = svdMethod(args,cplx);
     auto cutoff = args.getReal("Cutoff",MIN_CUT);
     auto maxm = args.getInt("Maxm",MAX_M);
     auto minm = args.getInt("Minm",1);
@@ -338,6 +647,12 @@ svdRank2(IQTensor A, const IQIndex& uI, const IQIndex& vI,
 
     vector<Vector> dvector(Nblock);
 
+    const bool randomized = (method == SVDMethod::Randomized && do_truncate);
+    RandomizedArgs rargs = randomizedArgs(args);
+    //Split the cutoff between the blocks
+    if(!absoluteCutoff) rargs.cutoff /= Nblock;
+    vector<Real> missed(Nblock,0.);
+
     vector<EigQN> alleig;
     alleig.reserve(min(uI.m(),vI.m()));
 
@@ -361,13 +676,16 @@ svdRank2(IQTensor A, const IQIndex& uI, const IQIndex& vI,
 
     //1. SVD each ITensor within A.
     //   Store results in mmatrix and mvector.
-    int itenind = 0;
+    vector<const ITensor*> tblock;
+    vector<const Index*> uind,
+                         vind;
+    vector<double> cost;
+    tblock.reserve(Nblock);
+    uind.reserve(Nblock);
+    vind.reserve(Nblock);
+    cost.reserve(Nblock);
     for(const ITensor& t : A.blocks())
         {
-        Matrix &UU = Umatrix.at(itenind);
-        Matrix &VV = Vmatrix.at(itenind);
-        Vector &d =  dvector.at(itenind);
-
         const Index *ui=0,*vi=0;
         bool gotui = false;
         for(const Index& I : t.indices())
@@ -387,12 +705,33 @@ svdRank2(IQTensor A, const IQIndex& uI, const IQIndex& vI,
         if(!hasindex(uI,*ui))
             swap(ui,vi);
 
+        tblock.push_back(&t);
+        uind.push_back(ui);
+        vind.push_back(vi);
+        const double mu = ui->m(),
+                     mv = vi->m();
+        cost.push_back(mu*mv*min(mu,mv));
+        }
+
+    decompBlocks(cost,[&](long itenind)
+        {
+        const ITensor& t = *tblock.at(itenind);
+        const Index &ui = *uind.at(itenind),
+                    &vi = *vind.at(itenind);
+
+        Matrix &UU = Umatrix.at(itenind);
+        Matrix &VV = Vmatrix.at(itenind);
+        Vector &d =  dvector.at(itenind);
+
         if(!cplx)
             {
-            Matrix M(ui->m(),vi->m());
-            t.toMatrix11NoScale(*ui,*vi,M);
+            Matrix M(ui.m(),vi.m());
+            t.toMatrix11NoScale(ui,vi,M);
 
-            SVD(M,UU,d,VV,thresh);
+            if(!randomized || !randomizedSVD(M,UU,d,VV,rargs,missed.at(itenind)))
+                {
+                svdMatrix(method,M,UU,d,VV,thresh);
+                }
             }
         else
             {
@@ -400,31 +739,30 @@ svdRank2(IQTensor A, const IQIndex& uI, const IQIndex& vI,
                     imt = imagPart(t);
             ret.scaleTo(refNorm);
             imt.scaleTo(refNorm);
-            Matrix Mre(ui->m(),vi->m()),
-                   Mim(ui->m(),vi->m());
-            ret.toMatrix11NoScale(*ui,*vi,Mre);
-            imt.toMatrix11NoScale(*ui,*vi,Mim);
-
-            //SVDComplex(Mre,Mim,
-            //           UU,iUmatrix.at(itenind),
-            //           d,
-            //           VV,iVmatrix.at(itenind));
-            SVD(Mre,Mim,
-                UU,iUmatrix.at(itenind),
-                d,
-                VV,iVmatrix.at(itenind),
-                thresh);
+            Matrix Mre(ui.m(),vi.m()),
+                   Mim(ui.m(),vi.m());
+            ret.toMatrix11NoScale(ui,vi,Mre);
+            imt.toMatrix11NoScale(ui,vi,Mim);
+
+            svdMatrix(method,
+                      Mre,Mim,
+                      UU,iUmatrix.at(itenind),
+                      d,
+                      VV,iVmatrix.at(itenind),
+                      thresh);
             }
+        });
 
-        //Store the squared singular values
-        //(denmat eigenvalues) in alleig
-        QN q = qn(uI,*ui);
+    //Store the squared singular values
+    //(denmat eigenvalues) in alleig
+    for(int itenind = 0; itenind < Nblock; ++itenind)
+        {
+        const Vector& d = dvector.at(itenind);
+        QN q = qn(uI,*uind.at(itenind));
         for(int j = 1; j <= d.Length(); ++j) 
             {
             alleig.push_back(EigQN(sqr(d(j)),q));
             }
-
-        ++itenind;
         }
 
     //2. Truncate eigenvalues
@@ -434,17 +772,20 @@ svdRank2(IQTensor A, const IQIndex& uI, const IQIndex& vI,
     Real svdtruncerr = 0;
     Real docut = -1;
 
-    //Sort all eigenvalues from smallest to largest
-    //irrespective of quantum numbers
-    sort(alleig.begin(),alleig.end());
+    //Sort eigenvalues from smallest to largest
+    //irrespective of quantum numbers (only the
+    //largest maxm if truncating)
+    const bool showeigs = args.getBool("ShowEigs",false);
+    long nsorted = orderEigs(alleig,maxm,!do_truncate || showeigs);
 
     if(do_truncate)
         {
+        const Real totmissed = std::accumulate(missed.begin(),missed.end(),0.);
         svdtruncerr = truncate(alleig,m,docut,maxm,minm,cutoff,
-                               absoluteCutoff,doRelCutoff);
+                               absoluteCutoff,doRelCutoff,totmissed);
         }
 
-    if(args.getBool("ShowEigs",false))
+    if(showeigs)
         {
         cout << endl;
         println("svdRank2 (IQTensor):");
@@ -510,7 +851,7 @@ svdRank2(IQTensor A, const IQIndex& uI, const IQIndex& vI,
     vector<ITensor> Dblock;
     Dblock.reserve(Nblock);
 
-    itenind = 0;
+    int itenind = 0;
     int total_m = 0;
     for(const ITensor& t : A.blocks())
         {
@@ -619,6 +960,7 @@ svdRank2(IQTensor A, const IQIndex& uI, const IQIndex& vI,
 
     int aesize = int(alleig.size());
     int neig = std::min(aesize,L.m());
+    sortLargest(alleig,nsorted,neig);
     Vector DD(neig);
     std::vector<QN> qns(neig);
     for(int i = 0; i < neig; ++i) 
@@ -676,16 +1018,28 @@ diag_hermitian(ITensor rho, ITensor& U, ITensor& D,
     //to ensure eigenvalues are ordered from largest to smallest.
     bool flipSign = rho.scale().sign() > 0;
 
+    //A randomized diagonalization assumes rho is
+    //a density matrix, as in denmatDecomp
+    const bool randomized = do_truncate && svdMethod(args) == SVDMethod::Randomized;
+
+    //At most maxm eigenpairs can be kept, so when truncating
+    //a "PartialEig" diagonalization computes only those
+    const bool partial = do_truncate && args.getBool("PartialEig",false);
+
     //Do the diagonalization
     Vector DD;
     Matrix UU,iUU;
+    Real missed = 0;
     if(!cplx)
         {
         Matrix R;
         rho.toMatrix11NoScale(active,prime(active),R);
-        if(flipSign) R *= -1;
-        EigenValues(R,DD,UU); 
-        if(flipSign) DD *= -1;
+        if(!randomized || !randomizedEigen(R,flipSign,DD,UU,randomizedArgs(args),missed))
+            {
+            if(flipSign) R *= -1;
+            missed = partialEigen(R,partial ? max(1,maxm) : R.Nrows(),DD,UU);
+            if(flipSign) DD *= -1;
+            }
         }
     else
         {
@@ -725,7 +1079,7 @@ diag_hermitian(ITensor rho, ITensor& U, ITensor& D,
     if(do_truncate)
         {
         if(DD(1) < 0) DD *= -1; //DEBUG
-        svdtruncerr = truncate(DD,maxm,minm,cutoff,absoluteCutoff,doRelCutoff);
+        svdtruncerr = truncate(DD,maxm,minm,cutoff,absoluteCutoff,doRelCutoff,missed);
         }
     Spectrum spec;
     spec.truncerr(svdtruncerr);
@@ -822,6 +1176,19 @@ diag_hermitian(IQTensor rho, IQTensor& U, IQTensor& D,
     if(cplx)
         imatrix.resize(rho.blocks().size());
 
+    //A randomized diagonalization assumes rho is
+    //a density matrix, as in denmatDecomp
+    const bool randomized = do_truncate && svdMethod(args) == SVDMethod::Randomized;
+    RandomizedArgs rargs = randomizedArgs(args);
+    //Split the cutoff between the blocks
+    if(!absoluteCutoff) rargs.cutoff /= rho.blocks().size();
+    vector<Real> missed(rho.blocks().size(),0.);
+
+    //Computes only the eigenpairs of each block likely to be
+    //kept, estimated by partialEigCounts (real blocks only)
+    const bool partial = do_truncate && !randomized && !cplx 
+                         && args.getBool("PartialEig",false);
+
     if(rho.indices().front().m() == 0)
         throw ResultIsZero("rho.index(1).m()");
     if(rho.empty())
@@ -842,9 +1209,22 @@ diag_hermitian(IQTensor rho, IQTensor& U, IQTensor& D,
     rho.scaleTo(refNorm);
 
 
+    IQIndex A;
+    for(const IQIndex& I : rho.indices())
+        if(I.primeLevel() == 0)
+            {
+            A = I;
+            break;
+            }
+
     //1. Diagonalize each ITensor within rho.
     //   Store results in mmatrix and mvector.
-    int itenind = 0;
+    vector<const ITensor*> tblock;
+    vector<Index> aind;
+    vector<double> cost;
+    tblock.reserve(rho.blocks().size());
+    aind.reserve(rho.blocks().size());
+    cost.reserve(rho.blocks().size());
     for(const ITensor& t : rho.blocks())
         {
         Index a;
@@ -854,14 +1234,27 @@ diag_hermitian(IQTensor rho, IQTensor& U, IQTensor& D,
                 a = I;
                 break;
                 }
+        tblock.push_back(&t);
+        aind.push_back(a);
+        const double n = a.m();
+        cost.push_back(n*n*n);
+        }
 
-        IQIndex A;
-        for(const IQIndex& I : rho.indices())
-            if(I.primeLevel() == 0)
-                {
-                A = I;
-                break;
-                }
+    //Number of eigenpairs to compute for each block
+    vector<int> ncompute;
+    if(partial) 
+        {
+        ncompute = partialEigCounts(tblock,aind,maxm);
+        }
+    else
+        {
+        for(const Index& a : aind) ncompute.push_back(a.m());
+        }
+
+    auto diagBlock = [&](long itenind)
+        {
+        const ITensor& t = *tblock.at(itenind);
+        const Index& a = aind.at(itenind);
 
         Matrix &UU = mmatrix.at(itenind);
         Vector &d =  mvector.at(itenind);
@@ -874,14 +1267,16 @@ diag_hermitian(IQTensor rho, IQTensor& U, IQTensor& D,
         bool flipSign = t.scale().sign() > 0;
 
         //Diag ITensors within rho
-        const int n = a.m();
         if(!cplx)
             {
             Matrix M;
             t.toMatrix11NoScale(a,prime(a),M);
-            if(flipSign) M *= -1;
-            EigenValues(M,d,UU);
-            if(flipSign) d *= -1;
+            if(!randomized || !randomizedEigen(M,flipSign,d,UU,rargs,missed.at(itenind)))
+                {
+                if(flipSign) M *= -1;
+                missed.at(itenind) = partialEigen(M,ncompute.at(itenind),d,UU);
+                if(flipSign) d *= -1;
+                }
             }
         else
             {
@@ -902,15 +1297,8 @@ diag_hermitian(IQTensor rho, IQTensor& U, IQTensor& D,
             if(flipSign) d *= -1;
             }
 
-        QN q = qn(A,a);
-        for(int j = 1; j <= n; ++j) 
-            {
-            alleig.push_back(EigQN(d(j),q));
-            }
-
-        ++itenind;
-
 #ifdef STRONG_DEBUG
+        const int n = a.m();
 	Real maxM = 1.0;
         for(int r = 1; r <= n; ++r)
 	    for(int c = r+1; c <= n; ++c)
@@ -936,28 +1324,69 @@ diag_hermitian(IQTensor rho, IQTensor& U, IQTensor& D,
             }
         
 #endif //STRONG_DEBUG
-        }
+        };
+
+    decompBlocks(cost,diagBlock);
 
     //2. Truncate eigenvalues
 
-    //Determine number of states to keep m
     Real svdtruncerr = 0;
     Real docut = -1;
-    int m = (int)alleig.size();
+    int m = 0;
+    long nsorted = 0;
+    const bool showeigs = args.getBool("ShowEigs",false);
+    for(bool redo = true; redo;)
+        {
+        alleig.clear();
+        for(size_t itenind = 0; itenind < tblock.size(); ++itenind)
+            {
+            const Vector& d = mvector.at(itenind);
+            QN q = qn(A,aind.at(itenind));
+            for(int j = 1; j <= d.Length(); ++j) 
+                {
+                alleig.push_back(EigQN(d(j),q));
+                }
+            }
 
-    sort(alleig.begin(),alleig.end());
+        //Determine number of states to keep m
+        m = (int)alleig.size();
 
-    if(do_truncate)
-        {
-        //Sort all eigenvalues from smallest to largest
-        //irrespective of quantum numbers
+        //Sort eigenvalues from smallest to largest
+        //irrespective of quantum numbers (only the
+        //largest maxm if truncating)
+        nsorted = orderEigs(alleig,maxm,!do_truncate || showeigs);
+
+        if(do_truncate)
+            {
+            const Real totmissed = std::accumulate(missed.begin(),missed.end(),0.);
+            svdtruncerr = truncate(alleig,m,docut,maxm,minm,cutoff,absoluteCutoff,doRelCutoff,totmissed);
+            }
 
-        svdtruncerr = truncate(alleig,m,docut,maxm,minm,cutoff,absoluteCutoff,doRelCutoff);
+        //A block partially diagonalized with all of its
+        //eigenvalues kept may have more above docut (unless
+        //it holds all maxm states): diagonalize it fully and
+        //truncate again. Otherwise the eigenvalues it leaves
+        //out are discarded, so truncation is unchanged.
+        if(!partial) break;
+        vector<long> rblock;
+        vector<double> rcost;
+        for(size_t itenind = 0; itenind < tblock.size(); ++itenind)
+            {
+            const Vector& d = mvector.at(itenind);
+            const int n = aind.at(itenind).m();
+            if(d.Length() == n || d.Length() >= maxm) continue;
+            if(d(d.Length()) <= docut) continue;
+            ncompute.at(itenind) = n;
+            rblock.push_back(itenind);
+            rcost.push_back(cost.at(itenind));
+            }
+        redo = !rblock.empty();
+        if(redo) decompBlocks(rcost,[&](long j) { diagBlock(rblock.at(j)); });
         }
     Spectrum spec;
     spec.truncerr(svdtruncerr);
 
-    if(args.getBool("ShowEigs",false))
+    if(showeigs)
         {
         cout << endl;
         printfln("Kept %d states in diag_denmat line 721", m);
@@ -1017,7 +1446,7 @@ diag_hermitian(IQTensor rho, IQTensor& U, IQTensor& D,
     IQIndex::Storage iq;
     iq.reserve(rho.blocks().size());
 
-    itenind = 0;
+    int itenind = 0;
     for(const ITensor& t : rho.blocks())
         {
         Vector& thisD = mvector.at(itenind);
@@ -1108,6 +1537,7 @@ diag_hermitian(IQTensor rho, IQTensor& U, IQTensor& D,
 
     int aesize = int(alleig.size());
     int neig = std::min(aesize,newmid.m());
+    sortLargest(alleig,nsorted,neig);
     Vector DD(neig);
     std::vector<QN> qns(neig);
     for(int i = 0; i < neig; ++i) 
@@ -1130,6 +1560,154 @@ diag_hermitian(IQTensor rho, IQTensor& U, IQTensor& D,
     return Spectrum(DD,qns,Args("Truncerr",svdtruncerr));
     } //void diag_hermitian
 
+void
+qrRank2(ITensor A, const Index& qi, const Index& ri,
+        ITensor& Q, ITensor& R)
+    {
+    if(A.r() != 2)
+        {
+        Error("A must be matrix-like");
+        }
+
+    Matrix QQ,RR;
+    if(!A.isComplex())
+        {
+        Matrix M;
+        A.toMatrix11NoScale(qi,ri,M);
+        QRDecomp(M,QQ,RR);
+        Index l("ql",QQ.Ncols(),Link);
+        Q = ITensor(qi,l,QQ);
+        R = ITensor(l,ri,RR);
+        }
+    else
+        {
+        ITensor Are = realPart(A),
+                Aim = imagPart(A);
+        Are.scaleTo(A.scale());
+        Aim.scaleTo(A.scale());
+        Matrix Mre,Mim,
+               iQQ,iRR;
+        Are.toMatrix11NoScale(qi,ri,Mre);
+        Aim.toMatrix11NoScale(qi,ri,Mim);
+        QRDecomp(Mre,Mim,QQ,iQQ,RR,iRR);
+        Index l("ql",QQ.Ncols(),Link);
+        Q = ITensor(qi,l,QQ) + Complex_i*ITensor(qi,l,iQQ);
+        R = ITensor(l,ri,RR) + Complex_i*ITensor(l,ri,iRR);
+        }
+    R *= A.scale();
+    }
+
+void
+qrRank2(IQTensor A, const IQIndex& qI, const IQIndex& rI,
+        IQTensor& Q, IQTensor& R)
+    {
+    if(A.r() != 2)
+        {
+        Error("A must be matrix-like");
+        }
+
+    const bool cplx = A.isComplex();
+
+    //Blocks of a rank 2 IQTensor don't share
+    //sectors, so each one is factored by itself
+    vector<const ITensor*> tblock;
+    vector<const Index*> qind,
+                         rind;
+    vector<double> cost;
+    for(const ITensor& t : A.blocks())
+        {
+        const Index *qi = &(t.indices()[0]),
+                    *ri = &(t.indices()[1]);
+        if(!hasindex(qI,*qi)) swap(qi,ri);
+        tblock.push_back(&t);
+        qind.push_back(qi);
+        rind.push_back(ri);
+        const double mq = qi->m(),
+                     mr = ri->m();
+        cost.push_back(mq*mr*min(mq,mr));
+        }
+    if(tblock.empty())
+        throw ResultIsZero("A has no blocks");
+
+    const long Nblock = tblock.size();
+    vector<Matrix> Qmatrix(Nblock),
+                   Rmatrix(Nblock),
+                   iQmatrix,
+                   iRmatrix;
+    if(cplx)
+        {
+        iQmatrix.resize(Nblock);
+        iRmatrix.resize(Nblock);
+        }
+
+    decompBlocks(cost,[&](long n)
+        {
+        const ITensor& t = *tblock.at(n);
+        const Index &qi = *qind.at(n),
+                    &ri = *rind.at(n);
+        if(!cplx)
+            {
+            Matrix M;
+            t.toMatrix11NoScale(qi,ri,M);
+            QRDecomp(M,Qmatrix.at(n),Rmatrix.at(n));
+            }
+        else
+            {
+            ITensor ret = realPart(t),
+                    imt = imagPart(t);
+            ret.scaleTo(t.scale());
+            imt.scaleTo(t.scale());
+            Matrix Mre,Mim;
+            ret.toMatrix11NoScale(qi,ri,Mre);
+            imt.toMatrix11NoScale(qi,ri,Mim);
+            QRDecomp(Mre,Mim,Qmatrix.at(n),iQmatrix.at(n),
+                             Rmatrix.at(n),iRmatrix.at(n));
+            }
+        });
+
+    IQIndex::Storage Liq;
+    Liq.reserve(Nblock);
+    vector<Index> lind;
+    lind.reserve(Nblock);
+    for(long n = 0; n < Nblock; ++n)
+        {
+        lind.push_back(Index("ql",Qmatrix.at(n).Ncols(),Link));
+        Liq.push_back(IndexQN(lind.back(),qn(qI,*qind.at(n))));
+        }
+    IQIndex L("QL",Liq,qI.dir());
+
+    Q = IQTensor(qI,dag(L));
+    R = IQTensor(L,rI);
+    IQTensor iQ,iR;
+    if(cplx)
+        {
+        iQ = IQTensor(qI,dag(L));
+        iR = IQTensor(L,rI);
+        }
+    for(long n = 0; n < Nblock; ++n)
+        {
+        const Index &qi = *qind.at(n),
+                    &ri = *rind.at(n),
+                    &l = lind.at(n);
+        Q += ITensor(qi,l,Qmatrix.at(n));
+        ITensor Rb(l,ri,Rmatrix.at(n));
+        Rb *= tblock.at(n)->scale();
+        R += Rb;
+        if(cplx)
+            {
+            iQ += ITensor(qi,l,iQmatrix.at(n));
+            ITensor iRb(l,ri,iRmatrix.at(n));
+            iRb *= tblock.at(n)->scale();
+            iR += iRb;
+            }
+        }
+    if(cplx)
+        {
+        Q = Q + iQ*Complex_i;
+        R = R + iR*Complex_i;
+        }
+    }
+
 void 
 eig_decomp(ITensor T, 
            const Index& L, const Index& R,
@@ -18,6 +18,15 @@ namespace itensor {
 // Factors a tensor AA such that AA=U*D*V
 // with D diagonal, real, and non-negative.
 //
+// The "SVDMethod" arg picks how the blocks of AA are
+// decomposed: "DensityMatrix" (default for real AA), "gesdd"
+// (default for complex AA), "gesvd" or "Randomized". 
+// "Randomized" computes only as many singular values as 
+// "Maxm" and "Cutoff" call for (tuned by "RSVDOversample", 
+// default 10, and "RSVDPowerIter", default 2), falling back 
+// to an exact SVD for blocks where that doesn't pay off or 
+// misses too much weight, and for complex blocks.
+//
 template<class Tensor>
 Spectrum 
 svd(Tensor AA, Tensor& U, Tensor& D, Tensor& V, 
@@ -30,7 +39,15 @@ svd(Tensor AA, Tensor& U, Tensor& D, Tensor& V,
 // Result is equivalent to SVD such that AA = U*D*V where if
 // dir==Fromleft, A=U and B=(D*V) or, if dir==Fromright, A=(U*D) and B=V.
 // Implementation is faster than SVD, though, and allows the
-// noise term to be used.
+// noise term to be used. Supports "SVDMethod","Randomized"
+// like svd, using a randomized diagonalization of the
+// density matrix.
+//
+// With "PartialEig" set to true, blocks of a real density 
+// matrix are diagonalized by MRRR (LAPACK dsyevr), computing
+// only the eigenvectors estimated to be kept under "Maxm".
+// Blocks found to keep more are diagonalized again in full,
+// so the result agrees with the full diagonalization.
 //
 // To determine which indices end up on which factors (i.e. on A versus B),
 // the method examines the initial indices of A and B.
@@ -90,6 +107,23 @@ orthoDecomp(Tensor T, Tensor& A, Tensor& B,
             const Args& args = Global::args());
 
 
+//
+// QR decomposition
+//
+// Factors a tensor T such that T=Q*R, where Q and R share
+// a new Link index and Q is isometric: dag(Q)*Q (contracting
+// all but this index) is the identity. The indices of T
+// present on Q upon calling end up on Q, the rest on R.
+// If Q has no indices, those of R are used instead.
+//
+// Never truncates, but is much cheaper than svd, so suits
+// moving the gauge of an MPS (see MPSt::position).
+//
+template<class Tensor>
+void
+qrDecomp(Tensor T, Tensor& Q, Tensor& R);
+
+
 //
 // Inverse Canonical SVD
 //
@@ -458,6 +492,46 @@ orthoDecomp(Tensor T, Tensor& A, Tensor& B,
 
     } //orthoDecomp
 
+void
+qrRank2(ITensor A, const Index& qi, const Index& ri,
+        ITensor& Q, ITensor& R);
+
+void
+qrRank2(IQTensor A, const IQIndex& qI, const IQIndex& rI,
+        IQTensor& Q, IQTensor& R);
+
+template<class Tensor>
+void
+qrDecomp(Tensor T, Tensor& Q, Tensor& R)
+    {
+    using IndexT = typename Tensor::IndexT;
+    using CombinerT = typename Tensor::CombinerT;
+
+    //Combiners which transform T
+    //into a rank 2 tensor
+    CombinerT Qcomb, Rcomb;
+
+    //Divide up indices based on Q
+    //If Q is null, use R instead
+    const Tensor &L = (Q ? Q : R);
+    CombinerT &Lcomb = (Q ? Qcomb : Rcomb),
+              &Ocomb = (Q ? Rcomb : Qcomb);
+    for(const IndexT& I : T.indices())
+        { 
+        if(hasindex(L,I))
+            Lcomb.addleft(I);
+        else
+            Ocomb.addleft(I);
+        }
+
+    T = Qcomb * T * Rcomb;
+
+    qrRank2(T,Qcomb.right(),Rcomb.right(),Q,R);
+
+    Q = dag(Qcomb) * Q;
+    R = R * dag(Rcomb);
+    } //qrDecomp
+
 void 
 eig_decomp(ITensor T, const Index& L, const Index& R, ITensor& V, ITensor& D,
            const Args& args = Global::args());
@@ -0,0 +1,128 @@
+//
+// Distributed under the ITensor Library License, Version 1.1.
+//    (See accompanying LICENSE file.)
+//
+#include "transpose.h"
+
+namespace itensor {
+
+using std::vector;
+
+constexpr long TransposePlan::BlockSize;
+constexpr long TransposePlan::ParallelSize;
+
+TransposePlan::
+TransposePlan(const vector<long>& dims,
+              const vector<long>& dest)
+    {
+    init(dims,dest);
+    }
+
+TransposePlan::
+TransposePlan(const Permutation& P,
+              const IndexSet<Index>& is)
+    {
+    vector<long> dims(is.rn()),
+                 dest(is.rn());
+    for(int j = 1; j <= is.rn(); ++j)
+        {
+        dims[j-1] = is.index(j).m();
+        dest[j-1] = P.dest(j)-1;
+        }
+    init(dims,dest);
+    }
+
+void TransposePlan::
+init(const vector<long>& dims,
+     const vector<long>& dest)
+    {
+#ifdef DEBUG
+    if(dims.size() != dest.size())
+        Error("TransposePlan: dims and dest must have the same size");
+#endif
+    const long r = dims.size();
+
+    size_ = 1;
+    for(long d : dims) size_ *= d;
+
+    //Drop dimensions of extent 1; pos[k] is the
+    //destination position of dimension k among
+    //the remaining ones
+    vector<long> ext,
+                 pos;
+    for(long k = 0; k < r; ++k)
+        {
+        if(dims[k] == 1) continue;
+        long p = 0;
+        for(long j = 0; j < r; ++j)
+            {
+            if(dims[j] != 1 && dest[j] < dest[k]) ++p;
+            }
+        ext.push_back(dims[k]);
+        pos.push_back(p);
+        }
+
+    //Fuse dimensions which are neighbors
+    //in both the source and the destination
+    n_.clear();
+    vector<long> fpos;
+    for(size_t k = 0; k < ext.size(); ++k)
+        {
+        if(k > 0 && pos[k] == pos[k-1]+1)
+            {
+            n_.back() *= ext[k];
+            }
+        else
+            {
+            n_.push_back(ext[k]);
+            fpos.push_back(pos[k]);
+            }
+        }
+    const long nf = n_.size();
+
+    //Relabel fpos as positions among fused dimensions
+    vector<long> rank(nf,0);
+    for(long k = 0; k < nf; ++k)
+    for(long j = 0; j < nf; ++j)
+        {
+        if(fpos[j] < fpos[k]) ++rank[k];
+        }
+
+    //Source and destination strides
+    vector<long> ss(nf),
+                 ds(nf);
+    for(long k = 0, str = 1; k < nf; ++k)
+        {
+        ss[k] = str;
+        str *= n_[k];
+        }
+    for(long k = 0; k < nf; ++k)
+        {
+        ds[k] = 1;
+        for(long j = 0; j < nf; ++j)
+            {
+            if(rank[j] < rank[k]) ds[k] *= n_[j];
+            }
+        }
+
+    q_ = 0;
+    for(long k = 0; k < nf; ++k)
+        {
+        if(rank[k] == 0) q_ = k;
+        }
+
+    ds0_ = (nf > 0 ? ds[0] : 1);
+    ssq_ = (nf > 0 ? ss[q_] : 1);
+    nqb_ = (q_ == 0 ? 1 : (n_[q_]+BlockSize-1)/BlockSize);
+
+    outer_.clear();
+    nouter_ = 1;
+    for(long k = 1; k < nf; ++k)
+        {
+        if(k == q_) continue;
+        outer_.push_back(Dim{n_[k],ss[k],ds[k]});
+        nouter_ *= n_[k];
+        }
+    }
+
+} //namespace itensor
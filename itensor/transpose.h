@@ -0,0 +1,207 @@
+//
+// Distributed under the ITensor Library License, Version 1.1.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_TRANSPOSE_H
+#define __ITENSOR_TRANSPOSE_H
+
+#include "indexset.h"
+#include "detail/parallel.h"
+
+namespace itensor {
+
+//
+// TransposePlan
+//
+// Precomputed recipe for permuting the data of
+// a dense tensor of any rank.
+//
+// Constructing a plan drops dimensions of size 1,
+// fuses dimensions which remain adjacent after the
+// permutation and works out all strides. Applying
+// it makes a single pass over the data, blocked over
+// the fastest-moving dimension of the destination:
+// a block walks the fastest-moving dimension of the
+// source for BlockSize destination positions at once,
+// so that both reads and writes stay in cache.
+//
+// A plan only depends on the dimensions and the
+// permutation, so it can be kept and reused for any
+// number of tensors of the same shape.
+//
+class TransposePlan
+    {
+    public:
+
+    TransposePlan() { }
+
+    //dims[k] is the extent of dimension k of the source
+    //(k == 0 varies fastest); dest[k] is the zero-indexed
+    //position dimension k takes in the destination
+    TransposePlan(const std::vector<long>& dims,
+                  const std::vector<long>& dest);
+
+    //Plan for reordering the data of a tensor with
+    //indices is such that Index j goes to position P.dest(j)
+    TransposePlan(const Permutation& P,
+                  const IndexSet<Index>& is);
+
+    //Total number of elements
+    long
+    size() const { return size_; }
+
+    //True if applying the plan amounts to a straight copy
+    bool
+    isCopy() const { return n_.size() <= 1; }
+
+    //Write the permuted data of src into dst
+    //(dst must have room for size() elements)
+    template<typename T>
+    void
+    operator()(const T* src, T* dst) const;
+
+    //Call f(s,d) for every element, where s is the offset
+    //of the element in the source and d its offset in the
+    //destination. If nthread > 1, and the tensor is large
+    //enough, f is called concurrently from several threads
+    //(on disjoint sets of destination elements).
+    template<typename Func>
+    void
+    forEach(Func&& f, int nthread = 1) const;
+
+    private:
+
+    struct Dim
+        {
+        long n,   //extent
+             ss,  //source stride
+             ds;  //destination stride
+        };
+
+    ///////////
+    long size_ = 0;
+    //Fused dimensions in source order;
+    //n_[0] always has source stride 1
+    std::vector<long> n_;
+    //Fused dimension with destination stride 1
+    int q_ = 0;
+    //Destination stride of n_[0], source stride of n_[q_]
+    long ds0_ = 1,
+         ssq_ = 1;
+    //Dimensions (other than 0 and q_) looped over
+    //outside of the blocked kernel
+    std::vector<Dim> outer_;
+    long nouter_ = 1,
+         nqb_ = 1; //number of blocks along dimension q_
+    ///////////
+
+    void
+    init(const std::vector<long>& dims,
+         const std::vector<long>& dest);
+
+    template<typename Func>
+    void
+    runTasks(Func& f, long tbegin, long tend) const;
+
+    template<typename Func>
+    void
+    kernel(Func& f, long soff, long doff, long qb) const;
+
+    public:
+
+    //Width of the blocks along the fastest dimension of the
+    //destination, used when the source and destination have
+    //different fastest dimensions
+    static constexpr long BlockSize = 32;
+
+    //Minimum number of elements before multiple threads are used
+    static constexpr long ParallelSize = 1l << 16;
+    };
+
+template<typename T>
+void TransposePlan::
+operator()(const T* src, T* dst) const
+    {
+    if(isCopy())
+        {
+        std::copy(src,src+size_,dst);
+        return;
+        }
+    forEach([src,dst](long s, long d) { dst[d] = src[s]; },Global::nthread());
+    }
+
+template<typename Func>
+void TransposePlan::
+forEach(Func&& f, int nthread) const
+    {
+    if(size_ == 0) return;
+    if(size_ < ParallelSize) nthread = 1;
+    detail::parallelRanges(nouter_*nqb_,nthread,
+                           [this,&f](long tb, long te) { runTasks(f,tb,te); });
+    }
+
+template<typename Func>
+void TransposePlan::
+kernel(Func& f, long soff, long doff, long qb) const
+    {
+    const long n0 = n_.empty() ? 1 : n_[0];
+    if(q_ == 0)
+        {
+        //Fastest dimension shared by source and destination
+        for(long i = 0; i < n0; ++i) f(soff+i,doff+i);
+        return;
+        }
+    const long jb = qb*BlockSize,
+               nj = std::min(BlockSize,n_[q_]-jb);
+    soff += jb*ssq_;
+    doff += jb;
+    //The nj source lines (one per j) are each read in order
+    //as i advances; each i writes one contiguous destination run
+    for(long i = 0; i < n0; ++i)
+        {
+        const long s = soff+i,
+                   d = doff+i*ds0_;
+        for(long j = 0; j < nj; ++j) f(s+j*ssq_,d+j);
+        }
+    }
+
+template<typename Func>
+void TransposePlan::
+runTasks(Func& f, long tbegin, long tend) const
+    {
+    //Each task is one block along dimension q_
+    //for one value of the outer dimensions
+    long qb = tbegin%nqb_,
+         o = tbegin/nqb_;
+    long soff = 0,
+         doff = 0;
+    std::vector<long> oi(outer_.size());
+    for(size_t k = 0; k < outer_.size(); ++k)
+        {
+        const Dim& D = outer_[k];
+        oi[k] = o%D.n;
+        o /= D.n;
+        soff += oi[k]*D.ss;
+        doff += oi[k]*D.ds;
+        }
+    for(long t = tbegin; t < tend; ++t)
+        {
+        kernel(f,soff,doff,qb);
+        if(++qb < nqb_) continue;
+        qb = 0;
+        for(size_t k = 0; k < outer_.size(); ++k)
+            {
+            const Dim& D = outer_[k];
+            soff += D.ss;
+            doff += D.ds;
+            if(++oi[k] < D.n) break;
+            soff -= D.n*D.ss;
+            doff -= D.n*D.ds;
+            oi[k] = 0;
+            }
+        }
+    }
+
+} //namespace itensor
+
+#endif
@@ -6,6 +6,7 @@
 #define __ITENSOR_lapack_wrap_h
 
 #include <vector>
+#include <complex>
 
 //
 // Headers and typedefs
@@ -55,7 +56,9 @@ typedef struct
 #define FORTRAN_NO_TRAILING_UNDERSCORE
 
 #include "mkl_blas.h"
+#include "mkl_cblas.h"
 #include "mkl_lapack.h"
+#include "mkl_service.h"
 namespace itensor {
 using LAPACK_INT = MKL_INT;
 using LAPACK_REAL = double;
@@ -72,6 +75,94 @@ using LAPACK_COMPLEX = MKL_Complex16;
 
 namespace itensor {
 
+//Sets the number of threads BLAS may use in calls
+//made by the calling thread (0 restores the global
+//setting) and returns the previous value. Supported
+//only with MKL; otherwise does nothing and returns 0.
+int inline
+setLocalBlasThreads(int n)
+    {
+#ifdef PLATFORM_mkl
+    return mkl_set_num_threads_local(n);
+#else
+    (void)n;
+    return 0;
+#endif
+    }
+
+} //namespace itensor
+
+#if !defined(PLATFORM_mkl) && defined(__GNUC__) && defined(__ELF__)
+//Thread controls of OpenBLAS, null unless linked with it
+extern "C" 
+    {
+    void openblas_set_num_threads(int) __attribute__((weak));
+    int openblas_get_num_threads(void) __attribute__((weak));
+    }
+#define ITENSOR_OPENBLAS_THREADS
+#endif
+
+namespace itensor {
+
+//Sets the number of threads BLAS may use in calls made
+//by any thread and returns the previous value. Supported
+//with OpenBLAS (found at link time, on ELF platforms);
+//otherwise does nothing and returns 0.
+int inline
+setGlobalBlasThreads(int n)
+    {
+#ifdef ITENSOR_OPENBLAS_THREADS
+    if(!openblas_set_num_threads || !openblas_get_num_threads) return 0;
+    const int prev = openblas_get_num_threads();
+    //Changing the setting while other threads are in
+    //BLAS calls is not safe, so only do it when needed
+    if(n > 0 && n != prev) openblas_set_num_threads(n);
+    return prev;
+#else
+    (void)n;
+    return 0;
+#endif
+    }
+
+//
+// Makes BLAS run single threaded while it exists:
+// with MKL, in calls made by the thread creating it;
+// with OpenBLAS, whose setting is global, in calls made
+// by any thread. The thread starting parallel tasks
+// holds one for as long as they run, and so does each
+// task. With other BLAS libraries it does nothing, and
+// the BLAS library should be set up to run serially 
+// when using Global::nthread() > 1.
+//
+class SerialBlasScope
+    {
+    public:
+
+    SerialBlasScope() 
+        : 
+        local_(setLocalBlasThreads(1)),
+        global_(setGlobalBlasThreads(1))
+        { }
+
+    ~SerialBlasScope()
+        {
+        setLocalBlasThreads(local_);
+        setGlobalBlasThreads(global_);
+        }
+
+    SerialBlasScope(const SerialBlasScope&) = delete;
+    SerialBlasScope& operator=(const SerialBlasScope&) = delete;
+
+    private:
+
+    int local_,
+        global_;
+    };
+
+} //namespace itensor
+
+namespace itensor {
+
 //
 //
 // Forward declarations of fortran lapack routines
@@ -109,6 +200,32 @@ void F77NAME(dgemm)(char*,char*,LAPACK_INT*,LAPACK_INT*,LAPACK_INT*,
             LAPACK_INT*,LAPACK_REAL*,LAPACK_REAL*,LAPACK_INT*);
 #endif
 
+#ifdef PLATFORM_macos
+void cblas_sgemm(const enum CBLAS_ORDER __Order,
+        const enum CBLAS_TRANSPOSE __TransA,
+        const enum CBLAS_TRANSPOSE __TransB, const int __M, const int __N,
+        const int __K, const float __alpha, const float *__A,
+        const int __lda, const float *__B, const int __ldb,
+        const float __beta, float *__C, const int __ldc);
+#else
+void F77NAME(sgemm)(char*,char*,LAPACK_INT*,LAPACK_INT*,LAPACK_INT*,
+            float*,float*,LAPACK_INT*,float*,
+            LAPACK_INT*,float*,float*,LAPACK_INT*);
+#endif
+
+#ifdef PLATFORM_macos
+void cblas_zgemm(const enum CBLAS_ORDER __Order,
+        const enum CBLAS_TRANSPOSE __TransA,
+        const enum CBLAS_TRANSPOSE __TransB, const int __M, const int __N,
+        const int __K, const void *__alpha, const void *__A,
+        const int __lda, const void *__B, const int __ldb,
+        const void *__beta, void *__C, const int __ldc);
+#else
+void F77NAME(zgemm)(char*,char*,LAPACK_INT*,LAPACK_INT*,LAPACK_INT*,
+            LAPACK_COMPLEX*,LAPACK_COMPLEX*,LAPACK_INT*,LAPACK_COMPLEX*,
+            LAPACK_INT*,LAPACK_COMPLEX*,LAPACK_COMPLEX*,LAPACK_INT*);
+#endif
+
 #ifdef PLATFORM_macos
 void cblas_dgemv(const enum CBLAS_ORDER Order,
         const enum CBLAS_TRANSPOSE TransA, const LAPACK_INT M, const LAPACK_INT N,
@@ -132,6 +249,19 @@ void F77NAME(dsyev)(const char* jobz, const char* uplo, const LAPACK_INT* n, dou
             LAPACK_INT* info );
 #endif
 
+#ifdef PLATFORM_acml
+void F77NAME(dsyevr)(char *jobz, char *range, char *uplo, int *n, double *a, int *lda, 
+                     double *vl, double *vu, int *il, int *iu, double *abstol, int *m,
+                     double *w, double *z, int *ldz, int *isuppz, double *work, int *lwork,
+                     int *iwork, int *liwork, int *info, 
+                     int jobz_len, int range_len, int uplo_len);
+#else
+void F77NAME(dsyevr)(char *jobz, char *range, char *uplo, LAPACK_INT *n, double *a, LAPACK_INT *lda, 
+                     double *vl, double *vu, LAPACK_INT *il, LAPACK_INT *iu, double *abstol, LAPACK_INT *m,
+                     double *w, double *z, LAPACK_INT *ldz, LAPACK_INT *isuppz, double *work, LAPACK_INT *lwork,
+                     LAPACK_INT *iwork, LAPACK_INT *liwork, LAPACK_INT *info);
+#endif
+
 #ifdef PLATFORM_macos
 void cblas_dscal(const LAPACK_INT N, const LAPACK_REAL alpha, LAPACK_REAL* X,const LAPACK_INT incX);
 #else
@@ -149,6 +279,28 @@ void F77NAME(zgesdd)(char *jobz, LAPACK_INT *m, LAPACK_INT *n, LAPACK_COMPLEX *a
              LAPACK_COMPLEX *work, LAPACK_INT *lwork, double *rwork, LAPACK_INT *iwork, LAPACK_INT *info);
 #endif
 
+#ifdef PLATFORM_acml
+void F77NAME(dgesdd)(char *jobz, int *m, int *n, double *a, int *lda, double *s, 
+             double *u, int *ldu, double *vt, int *ldvt, 
+             double *work, int *lwork, int *iwork, int *info, 
+             int jobz_len);
+#else
+void F77NAME(dgesdd)(char *jobz, LAPACK_INT *m, LAPACK_INT *n, double *a, LAPACK_INT *lda, double *s, 
+             double *u, LAPACK_INT *ldu, double *vt, LAPACK_INT *ldvt, 
+             double *work, LAPACK_INT *lwork, LAPACK_INT *iwork, LAPACK_INT *info);
+#endif
+
+#ifdef PLATFORM_acml
+void F77NAME(dgesvd)(char *jobu, char *jobvt, int *m, int *n, double *a, int *lda, double *s, 
+             double *u, int *ldu, double *vt, int *ldvt, 
+             double *work, int *lwork, int *info, 
+             int jobu_len, int jobvt_len);
+#else
+void F77NAME(dgesvd)(char *jobu, char *jobvt, LAPACK_INT *m, LAPACK_INT *n, double *a, LAPACK_INT *lda, double *s, 
+             double *u, LAPACK_INT *ldu, double *vt, LAPACK_INT *ldvt, 
+             double *work, LAPACK_INT *lwork, LAPACK_INT *info);
+#endif
+
 void F77NAME(dgeqrf)(LAPACK_INT *m, LAPACK_INT *n, double *a, LAPACK_INT *lda, 
                      double *tau, double *work, LAPACK_INT *lwork, LAPACK_INT *info);
 
@@ -156,6 +308,13 @@ void F77NAME(dorgqr)(LAPACK_INT *m, LAPACK_INT *n, LAPACK_INT *k, double *a,
                      LAPACK_INT *lda, double *tau, double *work, LAPACK_INT *lwork, 
                      LAPACK_INT *info);
 
+void F77NAME(zgeqrf)(LAPACK_INT *m, LAPACK_INT *n, LAPACK_COMPLEX *a, LAPACK_INT *lda, 
+                     LAPACK_COMPLEX *tau, LAPACK_COMPLEX *work, LAPACK_INT *lwork, LAPACK_INT *info);
+
+void F77NAME(zungqr)(LAPACK_INT *m, LAPACK_INT *n, LAPACK_INT *k, LAPACK_COMPLEX *a, 
+                     LAPACK_INT *lda, LAPACK_COMPLEX *tau, LAPACK_COMPLEX *work, LAPACK_INT *lwork, 
+                     LAPACK_INT *info);
+
 #ifdef PLATFORM_acml
 void F77NAME(zheev)(char *jobz, char *uplo, LAPACK_INT *n, LAPACK_COMPLEX *a, LAPACK_INT *lda, 
             double *w, LAPACK_COMPLEX *work, LAPACK_INT *lwork, double *rwork, 
@@ -166,6 +325,17 @@ void F77NAME(zheev)(char *jobz, char *uplo, LAPACK_INT *n, LAPACK_COMPLEX *a, LA
            LAPACK_INT *info);
 #endif
 
+#ifdef PLATFORM_acml
+void F77NAME(zheevd)(char *jobz, char *uplo, LAPACK_INT *n, LAPACK_COMPLEX *a, LAPACK_INT *lda, 
+            double *w, LAPACK_COMPLEX *work, LAPACK_INT *lwork, double *rwork, LAPACK_INT *lrwork,
+            LAPACK_INT *iwork, LAPACK_INT *liwork, LAPACK_INT *info, 
+            LAPACK_INT jobz_len, LAPACK_INT uplo_len);
+#else
+void F77NAME(zheevd)(char *jobz, char *uplo, LAPACK_INT *n, LAPACK_COMPLEX *a, LAPACK_INT *lda, 
+            double *w, LAPACK_COMPLEX *work, LAPACK_INT *lwork, double *rwork, LAPACK_INT *lrwork,
+            LAPACK_INT *iwork, LAPACK_INT *liwork, LAPACK_INT *info);
+#endif
+
 
 #ifdef PLATFORM_acml
 void F77NAME(dsygv)(LAPACK_INT *itype, char *jobz, char *uplo, LAPACK_INT *n, double *a, 
@@ -251,6 +421,37 @@ ddot_wrapper(LAPACK_INT N,
 //
 // dgemm
 //
+// Version taking the leading dimensions of A, B and C,
+// so that the matrices can be sub-blocks of larger ones
+//
+void inline
+dgemm_wrapper(bool transa, 
+              bool transb,
+              LAPACK_INT m,
+              LAPACK_INT n,
+              LAPACK_INT k,
+              LAPACK_REAL alpha,
+              const LAPACK_REAL* A,
+              LAPACK_INT lda,
+              const LAPACK_REAL* B,
+              LAPACK_INT ldb,
+              LAPACK_REAL beta,
+              LAPACK_REAL* C,
+              LAPACK_INT ldc)
+    {
+#ifdef PLATFORM_macos
+    auto at = transa ? CblasTrans : CblasNoTrans,
+         bt = transb ? CblasTrans : CblasNoTrans;
+    cblas_dgemm(CblasColMajor,at,bt,m,n,k,alpha,A,lda,B,ldb,beta,C,ldc);
+#else
+    auto *pA = const_cast<double*>(A);
+    auto *pB = const_cast<double*>(B);
+    char at = transa ? 'T' : 'N';
+    char bt = transb ? 'T' : 'N';
+    F77NAME(dgemm)(&at,&bt,&m,&n,&k,&alpha,pA,&lda,pB,&ldb,&beta,C,&ldc);
+#endif
+    }
+
 void inline
 dgemm_wrapper(bool transa, 
               bool transb,
@@ -263,6 +464,112 @@ dgemm_wrapper(bool transa,
               LAPACK_REAL beta,
               LAPACK_REAL* C)
     {
+    LAPACK_INT lda = transa ? k : m,
+               ldb = transb ? n : k;
+    dgemm_wrapper(transa,transb,m,n,k,alpha,A,lda,B,ldb,beta,C,m);
+    }
+
+//
+// dgemm_batch
+//
+// Sets C[j] = op(A[j])*op(B[j]) for a batch of products
+// made of ngroup groups. The products of group g (the next 
+// group_size[g] entries of A, B and C) share the transposes,
+// dimensions and leading dimensions given by entry g of the 
+// other arrays. With MKL the whole batch is one call to
+// cblas_dgemm_batch; otherwise each product is a dgemm call.
+//
+void inline
+dgemm_batch_wrapper(LAPACK_INT ngroup,
+                    const bool* transa,
+                    const bool* transb,
+                    const LAPACK_INT* m,
+                    const LAPACK_INT* n,
+                    const LAPACK_INT* k,
+                    const LAPACK_INT* lda,
+                    const LAPACK_INT* ldb,
+                    const LAPACK_INT* ldc,
+                    const LAPACK_INT* group_size,
+                    const LAPACK_REAL** A,
+                    const LAPACK_REAL** B,
+                    LAPACK_REAL** C)
+    {
+#ifdef PLATFORM_mkl
+    std::vector<CBLAS_TRANSPOSE> at(ngroup),
+                                 bt(ngroup);
+    std::vector<LAPACK_REAL> alpha(ngroup,1.),
+                             beta(ngroup,0.);
+    for(LAPACK_INT g = 0; g < ngroup; ++g)
+        {
+        at[g] = transa[g] ? CblasTrans : CblasNoTrans;
+        bt[g] = transb[g] ? CblasTrans : CblasNoTrans;
+        }
+    cblas_dgemm_batch(CblasColMajor,at.data(),bt.data(),m,n,k,alpha.data(),
+                      A,lda,B,ldb,beta.data(),C,ldc,ngroup,group_size);
+#else
+    for(LAPACK_INT g = 0, j = 0; g < ngroup; ++g)
+    for(LAPACK_INT e = 0; e < group_size[g]; ++e, ++j)
+        {
+        dgemm_wrapper(transa[g],transb[g],m[g],n[g],k[g],1.,
+                      A[j],lda[g],B[j],ldb[g],0.,C[j],ldc[g]);
+        }
+#endif
+    }
+
+//
+// sgemm
+//
+// Single precision version of dgemm_wrapper
+// (taking the leading dimensions)
+//
+void inline
+sgemm_wrapper(bool transa, 
+              bool transb,
+              LAPACK_INT m,
+              LAPACK_INT n,
+              LAPACK_INT k,
+              float alpha,
+              const float* A,
+              LAPACK_INT lda,
+              const float* B,
+              LAPACK_INT ldb,
+              float beta,
+              float* C,
+              LAPACK_INT ldc)
+    {
+#ifdef PLATFORM_macos
+    auto at = transa ? CblasTrans : CblasNoTrans,
+         bt = transb ? CblasTrans : CblasNoTrans;
+    cblas_sgemm(CblasColMajor,at,bt,m,n,k,alpha,A,lda,B,ldb,beta,C,ldc);
+#else
+    auto *pA = const_cast<float*>(A);
+    auto *pB = const_cast<float*>(B);
+    char at = transa ? 'T' : 'N';
+    char bt = transb ? 'T' : 'N';
+    F77NAME(sgemm)(&at,&bt,&m,&n,&k,&alpha,pA,&lda,pB,&ldb,&beta,C,&ldc);
+#endif
+    }
+
+//
+// zgemm
+//
+// Same conventions as dgemm_wrapper but for
+// complex matrices stored as interleaved
+// (real,imag) pairs; transa/transb request
+// the transpose (not the conjugate transpose)
+//
+void inline
+zgemm_wrapper(bool transa, 
+              bool transb,
+              LAPACK_INT m,
+              LAPACK_INT n,
+              LAPACK_INT k,
+              std::complex<double> alpha,
+              const std::complex<double>* A,
+              const std::complex<double>* B,
+              std::complex<double> beta,
+              std::complex<double>* C)
+    {
     LAPACK_INT lda = m,
                ldb = k;
 #ifdef PLATFORM_macos
@@ -278,10 +585,13 @@ dgemm_wrapper(bool transa,
         bt = CblasTrans;
         ldb = n;
         }
-    cblas_dgemm(CblasColMajor,at,bt,m,n,k,alpha,A,lda,B,ldb,beta,C,m);
+    cblas_zgemm(CblasColMajor,at,bt,m,n,k,&alpha,A,lda,B,ldb,&beta,C,m);
 #else
-    auto *pA = const_cast<double*>(A);
-    auto *pB = const_cast<double*>(B);
+    auto *pA = reinterpret_cast<LAPACK_COMPLEX*>(const_cast<std::complex<double>*>(A));
+    auto *pB = reinterpret_cast<LAPACK_COMPLEX*>(const_cast<std::complex<double>*>(B));
+    auto *pC = reinterpret_cast<LAPACK_COMPLEX*>(C);
+    auto *palpha = reinterpret_cast<LAPACK_COMPLEX*>(&alpha);
+    auto *pbeta = reinterpret_cast<LAPACK_COMPLEX*>(&beta);
     char at = 'N';
     char bt = 'N';
     if(transa)
@@ -294,7 +604,7 @@ dgemm_wrapper(bool transa,
         bt = 'T';
         ldb = n;
         }
-    F77NAME(dgemm)(&at,&bt,&m,&n,&k,&alpha,pA,&lda,pB,&ldb,&beta,C,&m);
+    F77NAME(zgemm)(&at,&bt,&m,&n,&k,palpha,pA,&lda,pB,&ldb,pbeta,pC,&m);
 #endif
     }
 
@@ -352,6 +662,62 @@ dsyev_wrapper(char jobz,        //if jobz=='V', compute eigs and evecs
 #endif
     }
 
+//
+// dsyevr
+//
+// Eigenvalues il through iu (counting from the smallest)
+// of a symmetric matrix and their eigenvectors, found by
+// the MRRR algorithm without computing the others.
+//
+// The workspace is kept (per thread) for later calls.
+//
+void inline
+dsyevr_wrapper(char jobz,          //if jobz=='V', compute eigs and evecs
+               char uplo,          //if uplo=='U', read from upper triangle of A
+               LAPACK_INT n,       //number of cols of A
+               LAPACK_REAL* A,     //symmetric matrix A, overwritten
+               LAPACK_INT il,      //index of the first eigenvalue wanted
+               LAPACK_INT iu,      //index of the last eigenvalue wanted
+               LAPACK_REAL* eigs,  //eigenvalues on return (smallest first), size n
+               LAPACK_REAL* Z,     //eigenvectors on return, n x (iu-il+1)
+               LAPACK_INT& m,      //on return, number of eigenvalues found
+               LAPACK_INT& info)   //error info
+    {
+    thread_local std::vector<LAPACK_REAL> work;
+    thread_local std::vector<LAPACK_INT> iwork;
+    std::vector<LAPACK_INT> isuppz(2*std::max<LAPACK_INT>(1,iu-il+1));
+    char range = 'I';
+    LAPACK_INT lda = n,
+               ldz = n;
+    LAPACK_REAL vl = 0,
+                vu = 0,
+                abstol = 0;
+
+    //Compute optimal workspace sizes
+    LAPACK_INT lwork = -1,
+               liwork = -1;
+    LAPACK_REAL wkopt = 0;
+    LAPACK_INT iwkopt = 0;
+#ifdef PLATFORM_acml
+    F77NAME(dsyevr)(&jobz,&range,&uplo,&n,A,&lda,&vl,&vu,&il,&iu,&abstol,&m,eigs,Z,&ldz,
+                    isuppz.data(),&wkopt,&lwork,&iwkopt,&liwork,&info,1,1,1);
+#else
+    F77NAME(dsyevr)(&jobz,&range,&uplo,&n,A,&lda,&vl,&vu,&il,&iu,&abstol,&m,eigs,Z,&ldz,
+                    isuppz.data(),&wkopt,&lwork,&iwkopt,&liwork,&info);
+#endif
+    if(work.size() < size_t(wkopt)) work.resize(size_t(wkopt));
+    if(iwork.size() < size_t(iwkopt)) iwork.resize(size_t(iwkopt));
+    lwork = LAPACK_INT(work.size());
+    liwork = LAPACK_INT(iwork.size());
+#ifdef PLATFORM_acml
+    F77NAME(dsyevr)(&jobz,&range,&uplo,&n,A,&lda,&vl,&vu,&il,&iu,&abstol,&m,eigs,Z,&ldz,
+                    isuppz.data(),work.data(),&lwork,iwork.data(),&liwork,&info,1,1,1);
+#else
+    F77NAME(dsyevr)(&jobz,&range,&uplo,&n,A,&lda,&vl,&vu,&il,&iu,&abstol,&m,eigs,Z,&ldz,
+                    isuppz.data(),work.data(),&lwork,iwork.data(),&liwork,&info);
+#endif
+    }
+
 //
 // dscal
 //
@@ -379,15 +745,16 @@ zgesdd_wrapper(char *jobz,           //char* specifying how much of U, V to comp
                LAPACK_COMPLEX *vt,   //on return, unitary matrix V transpose
                LAPACK_INT *info)
     {
-    std::vector<LAPACK_COMPLEX> work;
-    std::vector<LAPACK_REAL> rwork;
-    std::vector<LAPACK_INT> iwork;
+    //Workspace kept (per thread) for later calls
+    thread_local std::vector<LAPACK_COMPLEX> work;
+    thread_local std::vector<LAPACK_REAL> rwork;
+    thread_local std::vector<LAPACK_INT> iwork;
     LAPACK_INT l = std::min(*m,*n),
                g = std::max(*m,*n);
     LAPACK_INT lwork = l*l+2*l+g+100;
-    work.resize(lwork);
-    rwork.resize(5*l*(1+l));
-    iwork.resize(8*l);
+    if(work.size() < size_t(lwork)) work.resize(lwork);
+    if(rwork.size() < size_t(5*l*(1+l))) rwork.resize(5*l*(1+l));
+    if(iwork.size() < size_t(8*l)) iwork.resize(8*l);
 #ifdef PLATFORM_acml
     LAPACK_INT jobz_len = 1;
     F77NAME(zgesdd)(jobz,m,n,A,m,s,u,m,vt,n,work.data(),&lwork,rwork.data(),iwork.data(),info,jobz_len);
@@ -396,6 +763,91 @@ zgesdd_wrapper(char *jobz,           //char* specifying how much of U, V to comp
 #endif
     }
 
+//
+// dgesdd
+//
+// Singular value decomposition A = U * diag(s) * VT of a real,
+// column-major m x n matrix A by divide and conquer. With
+// jobz=='S', the first min(m,n) columns of U and rows of VT
+// are computed. A is overwritten.
+//
+// The workspace is kept (per thread) for later calls.
+//
+void inline
+dgesdd_wrapper(char jobz,         //'S': compute min(m,n) cols of U, rows of VT
+               LAPACK_INT m,      //number of rows of A
+               LAPACK_INT n,      //number of cols of A
+               LAPACK_REAL* A,    //matrix A, overwritten
+               LAPACK_INT lda,    //leading dimension of A
+               LAPACK_REAL* s,    //on return, singular values (largest first)
+               LAPACK_REAL* u,    //on return, U
+               LAPACK_INT ldu,    //leading dimension of U
+               LAPACK_REAL* vt,   //on return, VT
+               LAPACK_INT ldvt,   //leading dimension of VT
+               LAPACK_INT& info)  //error info
+    {
+    thread_local std::vector<LAPACK_REAL> work;
+    thread_local std::vector<LAPACK_INT> iwork;
+    const LAPACK_INT l = std::min(m,n);
+    if(iwork.size() < size_t(8*l)) iwork.resize(8*l);
+
+    //Compute optimal workspace size (will be written to wkopt)
+    LAPACK_INT lwork = -1;
+    LAPACK_REAL wkopt = 0;
+#ifdef PLATFORM_acml
+    F77NAME(dgesdd)(&jobz,&m,&n,A,&lda,s,u,&ldu,vt,&ldvt,&wkopt,&lwork,iwork.data(),&info,1);
+#else
+    F77NAME(dgesdd)(&jobz,&m,&n,A,&lda,s,u,&ldu,vt,&ldvt,&wkopt,&lwork,iwork.data(),&info);
+#endif
+    if(work.size() < size_t(wkopt)) work.resize(size_t(wkopt));
+    lwork = LAPACK_INT(work.size());
+#ifdef PLATFORM_acml
+    F77NAME(dgesdd)(&jobz,&m,&n,A,&lda,s,u,&ldu,vt,&ldvt,work.data(),&lwork,iwork.data(),&info,1);
+#else
+    F77NAME(dgesdd)(&jobz,&m,&n,A,&lda,s,u,&ldu,vt,&ldvt,work.data(),&lwork,iwork.data(),&info);
+#endif
+    }
+
+//
+// dgesvd
+//
+// Same as dgesdd_wrapper (with jobu, jobvt in place of jobz) 
+// but using QR iteration: slower, but more robust for 
+// matrices on which divide and conquer fails to converge
+//
+void inline
+dgesvd_wrapper(char jobu,         //'S': compute min(m,n) cols of U
+               char jobvt,        //'S': compute min(m,n) rows of VT
+               LAPACK_INT m,      //number of rows of A
+               LAPACK_INT n,      //number of cols of A
+               LAPACK_REAL* A,    //matrix A, overwritten
+               LAPACK_INT lda,    //leading dimension of A
+               LAPACK_REAL* s,    //on return, singular values (largest first)
+               LAPACK_REAL* u,    //on return, U
+               LAPACK_INT ldu,    //leading dimension of U
+               LAPACK_REAL* vt,   //on return, VT
+               LAPACK_INT ldvt,   //leading dimension of VT
+               LAPACK_INT& info)  //error info
+    {
+    thread_local std::vector<LAPACK_REAL> work;
+
+    //Compute optimal workspace size (will be written to wkopt)
+    LAPACK_INT lwork = -1;
+    LAPACK_REAL wkopt = 0;
+#ifdef PLATFORM_acml
+    F77NAME(dgesvd)(&jobu,&jobvt,&m,&n,A,&lda,s,u,&ldu,vt,&ldvt,&wkopt,&lwork,&info,1,1);
+#else
+    F77NAME(dgesvd)(&jobu,&jobvt,&m,&n,A,&lda,s,u,&ldu,vt,&ldvt,&wkopt,&lwork,&info);
+#endif
+    if(work.size() < size_t(wkopt)) work.resize(size_t(wkopt));
+    lwork = LAPACK_INT(work.size());
+#ifdef PLATFORM_acml
+    F77NAME(dgesvd)(&jobu,&jobvt,&m,&n,A,&lda,s,u,&ldu,vt,&ldvt,work.data(),&lwork,&info,1,1);
+#else
+    F77NAME(dgesvd)(&jobu,&jobvt,&m,&n,A,&lda,s,u,&ldu,vt,&ldvt,work.data(),&lwork,&info);
+#endif
+    }
+
 //
 // dgeqrf
 //
@@ -438,6 +890,50 @@ dorgqr_wrapper(LAPACK_INT* m,     //number of rows of A
     F77NAME(dorgqr)(m,n,k,A,lda,tau,work.data(),&lwork,info);
     }
 
+//
+// zgeqrf
+//
+// QR factorization of a complex matrix A
+// (same conventions as dgeqrf_wrapper)
+//
+void inline
+zgeqrf_wrapper(LAPACK_INT* m,       //number of rows of A
+               LAPACK_INT* n,       //number of cols of A
+               LAPACK_COMPLEX* A,   //matrix A
+                                    //on return upper triangle contains R
+               LAPACK_INT* lda,     //leading dimension of A
+               LAPACK_COMPLEX* tau, //scalar factors of elementary reflectors
+                                    //length should be min(m,n)
+               LAPACK_INT* info)    //error info
+    {
+    std::vector<LAPACK_COMPLEX> work;
+    LAPACK_INT lwork = std::max(1,4*std::max(*n,*m));
+    work.resize(lwork+2); 
+    F77NAME(zgeqrf)(m,n,A,lda,tau,work.data(),&lwork,info);
+    }
+
+//
+// zungqr
+//
+// Generates Q from output of QR factorization routine zgeqrf
+// (same conventions as dorgqr_wrapper)
+//
+void inline
+zungqr_wrapper(LAPACK_INT* m,       //number of rows of A
+               LAPACK_INT* n,       //number of cols of A
+               LAPACK_INT* k,       //number of elementary reflectors, typically min(m,n)
+               LAPACK_COMPLEX* A,   //matrix A, as returned from "A" argument of zgeqrf
+                                    //on return contains Q
+               LAPACK_INT* lda,     //leading dimension of A
+               LAPACK_COMPLEX* tau, //scalar factors as returned by zgeqrf
+               LAPACK_INT* info)    //error info
+    {
+    std::vector<LAPACK_COMPLEX> work;
+    auto lwork = std::max(1,4*std::max(*n,*m));
+    work.resize(lwork+2); 
+    F77NAME(zungqr)(m,n,k,A,lda,tau,work.data(),&lwork,info);
+    }
+
 //
 // zheev
 //
@@ -465,6 +961,57 @@ zheev_wrapper(char* jobz,           //if 'V', compute both eigs and evecs
 #endif
     }
 
+//
+// zheevd
+//
+// Same as zheev, but by divide and conquer: much faster 
+// for large matrices when eigenvectors are wanted.
+//
+// The workspace is kept (per thread) for later calls.
+//
+void inline
+zheevd_wrapper(char jobz,          //if 'V', compute both eigs and evecs
+                                   //if 'N', only eigenvalues
+               char uplo,          //if 'U', use upper triangle of A
+               LAPACK_INT n,       //number of cols of A
+               LAPACK_COMPLEX* A,  //matrix A, on return contains eigenvectors
+               LAPACK_INT lda,     //leading dimension of A
+               LAPACK_REAL* d,     //eigenvalues on return (smallest first)
+               LAPACK_INT& info)   //error info
+    {
+    thread_local std::vector<LAPACK_COMPLEX> work;
+    thread_local std::vector<LAPACK_REAL> rwork;
+    thread_local std::vector<LAPACK_INT> iwork;
+
+    //Compute optimal workspace sizes
+    LAPACK_INT lwork = -1,
+               lrwork = -1,
+               liwork = -1;
+    LAPACK_COMPLEX wkopt;
+    LAPACK_REAL rwkopt = 0;
+    LAPACK_INT iwkopt = 0;
+#ifdef PLATFORM_acml
+    F77NAME(zheevd)(&jobz,&uplo,&n,A,&lda,d,&wkopt,&lwork,&rwkopt,&lrwork,&iwkopt,&liwork,&info,1,1);
+#else
+    F77NAME(zheevd)(&jobz,&uplo,&n,A,&lda,d,&wkopt,&lwork,&rwkopt,&lrwork,&iwkopt,&liwork,&info);
+#endif
+    //Real part of wkopt, whatever the members of LAPACK_COMPLEX are called
+    const auto nwork = size_t(reinterpret_cast<const LAPACK_REAL*>(&wkopt)[0]);
+    if(work.size() < nwork) work.resize(nwork);
+    if(rwork.size() < size_t(rwkopt)) rwork.resize(size_t(rwkopt));
+    if(iwork.size() < size_t(iwkopt)) iwork.resize(size_t(iwkopt));
+    lwork = LAPACK_INT(work.size());
+    lrwork = LAPACK_INT(rwork.size());
+    liwork = LAPACK_INT(iwork.size());
+#ifdef PLATFORM_acml
+    F77NAME(zheevd)(&jobz,&uplo,&n,A,&lda,d,work.data(),&lwork,rwork.data(),&lrwork,
+                    iwork.data(),&liwork,&info,1,1);
+#else
+    F77NAME(zheevd)(&jobz,&uplo,&n,A,&lda,d,work.data(),&lwork,rwork.data(),&lrwork,
+                    iwork.data(),&liwork,&info);
+#endif
+    }
+
 //
 // dsygv
 //
@@ -5,6 +5,7 @@
 
 #include "matrixref.h"
 #include <vector>
+#include <atomic>
 
 
 namespace itensor {
@@ -65,15 +66,15 @@ protected:
     inline void init();			// Initialize null matrix 
     inline void fixref();		
 
-    static int& nummats()
+    static std::atomic<int>& nummats()
         {
-        static int nummats_ = 0; // number of news - number of deletes
+        static std::atomic<int> nummats_(0); // number of news - number of deletes
         return nummats_;
         }
 
-    static int& numcon()
+    static std::atomic<int>& numcon()
         {
-        static int numcon_ = 0;	// number of constructor calls 
+        static std::atomic<int> numcon_(0);	// number of constructor calls 
         return numcon_;
         }
     };
@@ -91,12 +92,24 @@ Matrix Solve(const MatrixRef &A, const MatrixRef &B);	// return A^-1 * B
 void Orthog(const MatrixRef &, int nr = 0, int numpass = 2);
 void Orthog(const MatrixRef& Mre, const MatrixRef& Mim, int nr = 0, int numpass = 2);
 
+//QR decomposition M = Q*R of an m x n Matrix M:
+//Q is m x k with orthonormal columns and R is 
+//k x n upper triangular, where k = min(m,n)
 void 
 QRDecomp(const MatrixRef& M, Matrix& Q, Matrix& R);
 
+//Complex version of QRDecomp, M = Mre + i*Mim
+void 
+QRDecomp(const MatrixRef& Mre, const MatrixRef& Mim, 
+         Matrix& Qre, Matrix& Qim, 
+         Matrix& Rre, Matrix& Rim);
+
 // one argument means do all columns < rows 
 
 void EigenValues(const MatrixRef &, Vector &, Matrix &);
+//Lowest k eigenvalues (smallest first) and eigenvectors
+//of a symmetric matrix, without computing the others
+void LowestEigenValues(const MatrixRef& A, Vector& D, Matrix& Z, int k);
 void GenEigenValues(const MatrixRef&, Vector&, Vector&);
 void GenEigenValues(const MatrixRef& A, Vector& Re, Vector& Im, Matrix& ReV, Matrix& ImV);
 void HermitianEigenvalues(const Matrix& re, const Matrix& im, 
@@ -142,7 +155,8 @@ public:
 // Making and resizing:
     explicit Vector (int);
     Vector (int, Real);
-    explicit Vector (const std::vector<Real>& v);
+    template<typename Alloc>
+    explicit Vector (const std::vector<Real,Alloc>& v);
     void ReDimension(int);
     void ReduceDimension(int);
     void Enlarge(int);			// Change size while keeping contents
@@ -192,15 +206,15 @@ protected:
     inline void init();
     inline void fixref();
 
-    static int& numvecs()
+    static std::atomic<int>& numvecs()
         {
-        static int numvecs_ = 0; // number of news - number of deletes
+        static std::atomic<int> numvecs_(0); // number of news - number of deletes
         return numvecs_;
         }
 
-    static int& numcon()
+    static std::atomic<int>& numcon()
         {
-        static int numcon_ = 0;	// number of constructor calls 
+        static std::atomic<int> numcon_(0);	// number of constructor calls 
         return numcon_;
         }
     };
@@ -343,7 +357,8 @@ inline Vector::Vector (int s)
 inline Vector::Vector (int s, Real val)
     { init(); makevector(s); operator=(val); }
 
-inline Vector::Vector (const std::vector<Real>& v)
+template<typename Alloc>
+inline Vector::Vector (const std::vector<Real,Alloc>& v)
     { 
     init(); 
     makevector(v.size()); 
@@ -4,6 +4,7 @@
 #define _storelink_h
 
 #include <vector>
+#include <atomic>
 #include "types.h"
 
 
@@ -17,11 +18,9 @@ namespace itensor {
 
 typedef double Real;
 
-#ifdef USE_CPP11
-#define STATIC_VAR(type,name) static type& name() { static type t{}; return t; }
-#else
-#define STATIC_VAR(type,name) static type& name() { static type t(0); return t; }
-#endif
+//Counters shared by all threads, which may make
+//and destroy storage concurrently
+#define STATIC_VAR(type,name) static std::atomic<type>& name() { static std::atomic<type> t(0); return t; }
 
 class StoreLink
     {
@@ -1,6 +1,7 @@
 #include "svd.h"
 
 #include <fstream>
+#include <random>
 
 #include "lapack_wrap.h"
 
@@ -251,6 +252,165 @@ SVD(const MatrixRef& Are, const MatrixRef& Aim,
     }
 
 
+void
+SVDLapack(const MatrixRef& A, Matrix& U, Vector& D, Matrix& V,
+          bool divideConquer)
+    {
+    const LAPACK_INT n = A.Nrows(), 
+                     m = A.Ncols(),
+                     k = min(n,m);
+
+    //Matrix storage is row major, so LAPACK sees the 
+    //transpose: the m x n matrix A.t() = V.t() * D * U.t().
+    //Its "U" is then V (k x m) and its "VT" is U (n x k).
+    Matrix Ac(A);
+    D.ReDimension(k);
+    U.ReDimension(n,k);
+    V.ReDimension(k,m);
+    if(k == 0) return;
+
+    LAPACK_INT info = 0;
+    if(divideConquer)
+        {
+        dgesdd_wrapper('S',m,n,Ac.Store(),m,D.Store(),V.Store(),m,U.Store(),k,info);
+        //Ac is overwritten: start over from A for dgesvd
+        if(info > 0) Ac = A;
+        }
+    if(!divideConquer || info > 0)
+        {
+        dgesvd_wrapper('S','S',m,n,Ac.Store(),m,D.Store(),V.Store(),m,U.Store(),k,info);
+        }
+
+    if(info != 0) 
+        {
+        cout << "info = " << info << endl;
+        Error("Error condition in SVDLapack");
+        }
+
+#ifdef CHKSVD
+    checksvd(A,U,D,V);
+#endif
+    }
+
+//n x l Matrix of normally distributed random numbers.
+//The seed is fixed so that randomized decompositions
+//are reproducible from run to run.
+Matrix static
+gaussianMatrix(int n, int l)
+    {
+    std::mt19937 rng(1+n+7919*l);
+    std::normal_distribution<Real> dist;
+    Matrix G(n,l);
+    for(int i = 1; i <= n; ++i)
+    for(int j = 1; j <= l; ++j)
+        {
+        G(i,j) = dist(rng);
+        }
+    return G;
+    }
+
+//Replaces the columns of Y (n x l, l <= n) by an orthonormal
+//basis for their span. Uses a Householder QR since, unlike
+//Orthog, it keeps the directions of columns much smaller 
+//than the others (as in the range of a density matrix).
+void static
+orthonormalize(Matrix& Y)
+    {
+    LAPACK_INT n = Y.Nrows(),
+               l = Y.Ncols(),
+               info = 0;
+    //Y.t() stored by rows is Y stored by columns
+    Matrix Yc = Y.t();
+    Vector tau(l);
+    dgeqrf_wrapper(&n,&l,Yc.Store(),&n,tau.Store(),&info);
+    if(info != 0) Error("Error in call to dgeqrf");
+    dorgqr_wrapper(&n,&l,&l,Yc.Store(),&n,tau.Store(),&info);
+    if(info != 0) Error("Error in call to dorgqr");
+    Y = Yc.t();
+    }
+
+Real static
+sumSquares(const MatrixRef& A)
+    {
+    Real s = 0;
+    for(int i = 1; i <= A.Nrows(); ++i) 
+        {
+        const Real nrm = Norm(A.Row(i));
+        s += nrm*nrm;
+        }
+    return s;
+    }
+
+Real
+RandomizedSVD(const MatrixRef& A, Matrix& U, Vector& D, Matrix& V,
+              int l, int niter)
+    {
+    const int n = A.Nrows(),
+              m = A.Ncols();
+    if(l < 1 || l > min(n,m))
+        {
+        Error("RandomizedSVD: l must be between 1 and min(Nrows,Ncols)");
+        }
+
+    //Orthonormal basis Q for the range of A,
+    //sharpened by power iterations
+    Matrix Q = A*gaussianMatrix(m,l);
+    orthonormalize(Q);
+    for(int it = 1; it <= niter; ++it)
+        {
+        Matrix Z = A.t()*Q;
+        orthonormalize(Z);
+        Q = A*Z;
+        orthonormalize(Q);
+        }
+
+    //SVD of the projection of A onto Q
+    Matrix B = Q.t()*A,
+           UB;
+    SVDLapack(B,UB,D,V);
+    U = Q*UB;
+
+    Real kept = 0;
+    for(int j = 1; j <= D.Length(); ++j) kept += D(j)*D(j);
+    return max(0.,sumSquares(A)-kept);
+    }
+
+Real
+RandomizedEigenValues(const MatrixRef& R, Vector& D, Matrix& U,
+                      int l, int niter)
+    {
+    const int n = R.Nrows();
+    if(R.Ncols() != n)
+        {
+        Error("RandomizedEigenValues: R must be square");
+        }
+    if(l < 1 || l > n)
+        {
+        Error("RandomizedEigenValues: l must be between 1 and Nrows");
+        }
+
+    Matrix Q = R*gaussianMatrix(n,l);
+    orthonormalize(Q);
+    for(int it = 1; it <= niter; ++it)
+        {
+        Matrix Y = R*Q;
+        orthonormalize(Y);
+        Q = Y;
+        }
+
+    //EigenValues orders eigenvalues from smallest
+    //to largest, so diagonalize -Q.t()*R*Q
+    Matrix RQ = R*Q,
+           B = Q.t()*RQ,
+           W;
+    B *= -1;
+    EigenValues(B,D,W);
+    D *= -1;
+    U = Q*W;
+
+    return max(0.,Trace(R)-D.sumels());
+    }
+
 void
 SVDComplex(const MatrixRef& Are, const MatrixRef& Aim, 
            Matrix& Ure, Matrix& Uim, 
@@ -301,6 +461,13 @@ SVDComplex(const MatrixRef& Are, const MatrixRef& Aim,
                    (LAPACK_COMPLEX*)VV.Store(),
                    &info);
 
+    if(info > 0)
+        {
+        //zgesdd failed to converge: fall back 
+        //on the density matrix algorithm
+        SVD(Are,Aim,Ure,Uim,d,Vre,Vim);
+        return;
+        }
     if(info != 0) 
         {
         cout << "info = " << info << endl;
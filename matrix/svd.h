@@ -41,6 +41,48 @@ SVDComplex(const MatrixRef& Are, const MatrixRef& Aim,
            Matrix& Ure, Matrix& Uim, 
            Vector& D, 
            Matrix& Vre, Matrix& Vim);
+
+//
+// Singular value decomposition A = U * D * V computed
+// directly by LAPACK, with the same conventions as SVD:
+// for an n x m Matrix A, U is n x k, D has length k and
+// V is k x m where k = min(n,m).
+//
+// If divideConquer is true uses dgesdd, otherwise dgesvd
+// (QR iteration: slower, but more robust). If dgesdd fails
+// to converge, falls back to dgesvd.
+//
+void
+SVDLapack(const MatrixRef& A, Matrix& U, Vector& D, Matrix& V,
+          bool divideConquer = true);
+
+//
+// Randomized SVD: computes the leading l singular values
+// and vectors of A (same conventions as SVD, but U is 
+// n x l and V is l x m) from its projection onto a random 
+// subspace, refined by niter power iterations. See Halko, 
+// Martinsson and Tropp, SIAM Review 53, 217 (2011).
+//
+// Returns the weight of A missed by the l singular values,
+// |A|^2 - sum_j D(j)^2, which is also the squared error
+// of the approximation A = U * D * V.
+//
+Real
+RandomizedSVD(const MatrixRef& A, Matrix& U, Vector& D, Matrix& V,
+              int l, int niter = 2);
+
+//
+// Randomized counterpart of EigenValues for a symmetric,
+// positive semi-definite Matrix R (such as a density matrix):
+// computes its l largest eigenvalues D, ordered from largest
+// to smallest, and eigenvectors U (n x l).
+//
+// Returns the weight missed by the l eigenvalues, 
+// Trace(R) - sum_j D(j).
+//
+Real
+RandomizedEigenValues(const MatrixRef& R, Vector& D, Matrix& U,
+                      int l, int niter = 2);
            
 
 }
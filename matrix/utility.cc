@@ -148,19 +148,15 @@ Orthog(const MatrixRef& Mre, const MatrixRef& Mim,
 void 
 QRDecomp(const MatrixRef& M, Matrix& Q, Matrix& R)
     {
-    int m = M.Nrows();
-    int n = M.Ncols();
-    int tlen = min(m,n);
-    Vector Tau(tlen); Tau = 0;
-
-    if(m > n)
-        {
-        Error("Ncols < Nrows, but currently only Ncols >= Nrows case supported");
-        }
+    LAPACK_INT m = M.Nrows();
+    LAPACK_INT n = M.Ncols();
+    LAPACK_INT k = min(m,n);
+    Vector Tau(k); Tau = 0;
 
+    //M.t() stored by rows is M stored by columns
     Q = M.t();
 
-    int info = 0;
+    LAPACK_INT info = 0;
 
     //Call lapack routine
 
@@ -174,20 +170,70 @@ QRDecomp(const MatrixRef& M, Matrix& Q, Matrix& R)
     if(info != 0) error("Error in call to dgeqrf_.");
 
     //Grab R
-    R = Matrix(m,n);
+    R = Matrix(k,n);
     R = 0;
     //Grab elements of R from Q
-    for(int i = 1; i <= m; ++i)      
+    for(int i = 1; i <= k; ++i)      
     for(int j = i; j <= n; ++j) 
         {
         R(i,j) = Q(j,i);
         }       
 
-    //Generate Q
-    dorgqr_wrapper(&tlen, &tlen, &tlen, Q.Store(), &m, Tau.Store(), &info);
+    //Generate the first k columns of Q
+    dorgqr_wrapper(&m, &k, &k, Q.Store(), &m, Tau.Store(), &info);
     if(info != 0) error("Error in call to dorgqr_.");
 
-    Q = Q.t().SubMatrix(1,tlen,1,tlen);
+    Q = Q.t().SubMatrix(1,m,1,k);
+
+    } //void QRDecomp
+
+void 
+QRDecomp(const MatrixRef& Mre, const MatrixRef& Mim, 
+         Matrix& Qre, Matrix& Qim, 
+         Matrix& Rre, Matrix& Rim)
+    {
+    LAPACK_INT m = Mre.Nrows();
+    LAPACK_INT n = Mre.Ncols();
+    LAPACK_INT k = min(m,n);
+    if(Mim.Nrows() != m || Mim.Ncols() != n)
+        _merror("QRDecomp: Mim not same dimensions as Mre");
+
+    //Interleaved real and imaginary parts, stored by columns
+    Matrix AA(n,2*m);
+    for(int i = 1; i <= m; ++i)
+    for(int j = 1; j <= n; ++j)
+        {
+        AA(j,2*i-1) = Mre(i,j);
+        AA(j,2*i) = Mim(i,j);
+        }
+    Vector Tau(2*k); Tau = 0;
+
+    LAPACK_INT info = 0;
+    zgeqrf_wrapper(&m,&n,(LAPACK_COMPLEX*)AA.Store(),&m,(LAPACK_COMPLEX*)Tau.Store(),&info);
+    if(info != 0) error("Error in call to zgeqrf_.");
+
+    Rre = Matrix(k,n);
+    Rim = Matrix(k,n);
+    Rre = 0;
+    Rim = 0;
+    for(int i = 1; i <= k; ++i)      
+    for(int j = i; j <= n; ++j) 
+        {
+        Rre(i,j) = AA(j,2*i-1);
+        Rim(i,j) = AA(j,2*i);
+        }       
+
+    zungqr_wrapper(&m,&k,&k,(LAPACK_COMPLEX*)AA.Store(),&m,(LAPACK_COMPLEX*)Tau.Store(),&info);
+    if(info != 0) error("Error in call to zungqr_.");
+
+    Qre = Matrix(m,k);
+    Qim = Matrix(m,k);
+    for(int i = 1; i <= m; ++i)
+    for(int j = 1; j <= k; ++j)
+        {
+        Qre(i,j) = AA(j,2*i-1);
+        Qim(i,j) = AA(j,2*i);
+        }
 
     } //void QRDecomp
 
@@ -238,6 +284,43 @@ EigenValues(const MatrixRef& A, Vector& D, Matrix& Z)
     Z = Z.t();
     }
 
+//
+// Lowest k eigenvalues and eigenvectors of a real, 
+// symmetric matrix A, as returned by EigenValues
+// (Z has k columns)
+//
+void 
+LowestEigenValues(const MatrixRef& A, Vector& D, Matrix& Z, int k)
+    {
+    LAPACK_INT N = A.Ncols();
+    if(N == 0)
+      _merror("LowestEigenValues: 0 dimensions matrix");
+    if(N != A.Nrows())
+	_merror("LowestEigenValues: Input Matrix must be square");
+    if(k < 1 || k > N)
+	_merror("LowestEigenValues: k out of range");
+
+    char jobz = 'V';
+    char uplo = 'U';
+    LAPACK_INT info = 0,
+               nfound = 0;
+
+    Matrix AA(A);
+    Vector W(N);
+    Matrix ZZ(k,N);
+    dsyevr_wrapper(jobz,uplo,N,AA.Store(),1,k,W.Store(),ZZ.Store(),nfound,info);
+
+    if(info != 0 || nfound != k)
+        {
+        cerr << "info is " << info << ", found " << nfound << " eigenvalues" << endl;
+        Error("Got an error code in LowestEigenValues");
+        }
+
+    D = W.SubVector(1,k);
+    //Transpose ZZ (column-major as returned) before return
+    Z = ZZ.t();
+    }
+
 //
 //Compute eigenvalues of arbitrary real matrix A
 //
@@ -473,16 +556,11 @@ HermitianEigenvalues(const Matrix& re, const Matrix& im,
         AA(i,2*j) = im(j,i);
         }
 
-    char jobz = 'V';
-    char uplo = 'U';
-    LAPACK_INT lwork = max(1,3*N-1);//max(1, 1+6*N+2*N*N);
-    std::vector<LAPACK_COMPLEX> work(lwork);
-    std::vector<LAPACK_REAL> rwork(lwork);
-    LAPACK_INT info;
+    LAPACK_INT info = 0;
     
     evals.ReDimension(N);
 
-    zheev_wrapper(&jobz,&uplo,&N,(LAPACK_COMPLEX*)AA.Store(),&N,evals.Store(),work.data(),&lwork,rwork.data(),&info);
+    zheevd_wrapper('V','U',N,(LAPACK_COMPLEX*)AA.Store(),N,evals.Store(),info);
 
     if(info != 0)
         {
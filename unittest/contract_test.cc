@@ -0,0 +1,68 @@
+#include "test.h"
+#include "contract.h"
+#include "itensor.h"
+
+using namespace itensor;
+using std::vector;
+using std::pair;
+
+TEST_CASE("Contract")
+{
+
+Index a("a",10),
+      b("b",20),
+      c("c",3),
+      d("d",4),
+      e("e",5);
+
+SECTION("Order")
+    {
+    //A(a,b) B(b,c) v(c): multiplying B and v first is cheapest
+    vector<vector<pair<int,long>>> ops = { {{0,100},{1,100}},
+                                           {{1,100},{2,2}},
+                                           {{2,2}} };
+    auto steps = detail::contractionOrder(ops);
+    REQUIRE(steps.size() == 2);
+    CHECK_EQUAL(steps[0].first,1);
+    CHECK_EQUAL(steps[0].second,2);
+    CHECK_EQUAL(steps[1].first,0);
+    CHECK_EQUAL(steps[1].second,3);
+
+    //Asking again gives the same (cached) order
+    CHECK(detail::contractionOrder(ops) == steps);
+    }
+
+SECTION("Results")
+    {
+    ITensor A(a,b,c),
+            B(b,d),
+            C(c,d,e),
+            D(e);
+    A.randomize();
+    B.randomize();
+    C.randomize();
+    D.randomize();
+
+    ITensor R1 = contract(A,B,C,D);
+    ITensor R2 = A*B*C*D;
+    CHECK_EQUAL(R1.r(),1);
+    CHECK(hasindex(R1,a));
+    CHECK((R1-R2).norm() < 1E-10*R2.norm());
+
+    //Same shape again
+    B.randomize();
+    ITensor R3 = contract(A,B,C,D);
+    CHECK((R3-A*B*C*D).norm() < 1E-10*R3.norm());
+
+    //Built up one tensor at a time
+    ContractExpr<ITensor> net(D);
+    net.add(C).add(A);
+    CHECK_EQUAL(net.size(),3);
+    ITensor R4 = net;
+    CHECK((R4-D*C*A).norm() < 1E-10*R4.norm());
+
+    ITensor R5 = contract(A);
+    CHECK((R5-A).norm() < 1E-12);
+    }
+
+}
@@ -137,6 +137,36 @@ SECTION("AddIndex")
     CHECK_EQUAL(P->r(),3);
     }
 
+SECTION("ManyIndices")
+    {
+    //More indices than are stored inline
+    IndexSet<Index> is;
+    std::vector<Index> inds;
+    for(int j = 1; j <= 3*NMAX; ++j)
+        {
+        inds.push_back(Index(nameint("i",j),(j%3 == 0 ? 1 : 2)));
+        is.addindex(inds.back());
+        }
+    CHECK_EQUAL(is.r(),3*NMAX);
+    CHECK_EQUAL(is.rn(),2*NMAX);
+    for(const Index& I : inds) CHECK(hasindex(is,I));
+    //m!=1 indices come first, in order
+    CHECK_EQUAL(is[0],inds[0]);
+    CHECK_EQUAL(is[2],inds[3]);
+    CHECK_EQUAL(is[is.rn()],inds[2]);
+
+    IndexSet<Index> cp(is);
+    CHECK_EQUAL(cp.r(),is.r());
+    for(int j = 0; j < is.r(); ++j) CHECK_EQUAL(cp[j],is[j]);
+
+    IndexSet<Index> sorted(inds);
+    CHECK_EQUAL(sorted.rn(),is.rn());
+    for(int j = 0; j < is.r(); ++j) CHECK_EQUAL(sorted[j],is[j]);
+
+    is.prime(2);
+    CHECK_EQUAL(is[NMAX+3],prime(cp[NMAX+3],2));
+    }
+
 SECTION("Contraction")
     {
     IQIndexSet is1(S1,L1,L3),
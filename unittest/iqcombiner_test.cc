@@ -1,5 +1,6 @@
 #include "test.h"
 #include "iqcombiner.h"
+#include <thread>
 
 using namespace itensor;
 using namespace std;
@@ -199,5 +200,74 @@ SECTION("CondenseProduct")
     IQTensor diff = phi - ucphi;
     CHECK(diff.norm() < 1E-12);
     }
+SECTION("RoutePlans")
+    {
+    //The same combiner applied to several IQTensors
+    //with the same indices (reusing its routing plans)
+    IQTensor phi2(phi);
+    phi2.randomize();
+
+    for(bool condense : { false, true })
+        {
+        IQCombiner c;
+        c.doCondense(condense);
+        c.addleft(S1);
+        c.addleft(L2);
+        c.init();
+
+        IQTensor cphi = c * phi,
+                 cphi2 = c * phi2,
+                 csum = c * (2*phi + phi2);
+        CHECK((csum - (2*cphi + cphi2)).norm() < 1E-12*csum.norm());
+
+        CHECK((phi - dag(c) * cphi).norm() < 1E-12*phi.norm());
+        CHECK((phi2 - dag(c) * cphi2).norm() < 1E-12*phi2.norm());
+        }
+
+    //Large blocks are combined in parallel (the blocks
+    //of T total 7*60^3 > MinParallelWork elements)
+    auto makeIndex = [](const std::string& name)
+        {
+        return IQIndex(name,
+                       Index(name+"+",60),QN(+1),
+                       Index(name+"0",60),QN( 0),
+                       Index(name+"-",60),QN(-1),Out);
+        };
+    IQIndex X = makeIndex("X"),
+            Y = makeIndex("Y"),
+            Z = makeIndex("Z");
+    IQTensor T(X(61),dag(Y)(61),Z(61));
+    T.randomize();
+
+    IQCombiner c(X,Z);
+    const int nthread = Global::nthread();
+    Global::nthread() = 1;
+    IQTensor serial = c * T;
+    Global::nthread() = 4;
+    IQTensor parallel = c * T,
+             back = dag(c) * parallel;
+    Global::nthread() = nthread;
+
+    CHECK((parallel - serial).norm() < 1E-12*serial.norm());
+    CHECK((back - T).norm() < 1E-12*T.norm());
+
+    //One combiner shared by several threads
+    std::vector<IQTensor> shared(4);
+    std::vector<std::thread> threads;
+    for(size_t n = 0; n < shared.size(); ++n)
+        {
+        threads.emplace_back([&c,&T,&shared,n]
+            {
+            shared[n] = (n%2 == 0 ? c * T : dag(c) * (c * T));
+            });
+        }
+    for(auto& t : threads) t.join();
+    for(size_t n = 0; n < shared.size(); ++n)
+        {
+        const IQTensor& expect = (n%2 == 0 ? serial : T);
+        CHECK((shared[n] - expect).norm() < 1E-12*expect.norm());
+        }
+    }
+
 }
 
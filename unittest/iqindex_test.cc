@@ -1,5 +1,7 @@
 #include "test.h"
 #include "iqindex.h"
+#include <sstream>
+#include <unordered_set>
 
 using namespace itensor;
 using namespace std;
@@ -40,5 +42,121 @@ SECTION("Primes")
     CHECK_EQUAL(I.primeLevel(),2);
     }
 
+SECTION("SectorLookup")
+    {
+    //Enough Index's to use the hash table, and few enough not to
+    for(int nsec : { 3, 20 })
+        {
+        IQIndex::Storage iq;
+        vector<Index> inds;
+        for(int n = 0; n < nsec; ++n)
+            {
+            inds.push_back(Index(format("i%d",n),1+n%3));
+            iq.push_back(IndexQN(inds.back(),QN(n)));
+            }
+        IQIndex I("I",iq);
+
+        int os = 0;
+        for(int n = 0; n < nsec; ++n)
+            {
+            const Index& i = inds.at(n);
+            CHECK(hasindex(I,i));
+            CHECK_EQUAL(findindex(I,i),n+1);
+            CHECK_EQUAL(offset(I,i),os);
+            CHECK(qn(I,i) == QN(n));
+
+            //Last and first values of each Index
+            CHECK(IQIndexVal(I,os+i.m()).blockIndexVal() == i(i.m()));
+            CHECK(IQIndexVal(I,os+1).blockIndexVal() == i(1));
+            os += i.m();
+            }
+        CHECK(!hasindex(I,Index("j")));
+        CHECK_EQUAL(findindex(I,Index("j")),0);
+        CHECK(!hasindex(I,prime(inds.front())));
+
+        IQIndex pI = prime(I,2);
+        CHECK(hasindex(pI,prime(inds.back(),2)));
+        CHECK(!hasindex(pI,inds.back()));
+        CHECK_EQUAL(findindex(pI,prime(inds.back(),2)),nsec);
+        CHECK(hasindex(I,inds.back()));
+
+        std::stringstream ss;
+        I.write(ss);
+        IQIndex rI;
+        rI.read(ss);
+        CHECK_EQUAL(findindex(rI,inds.at(nsec/2)),nsec/2+1);
+        }
+    }
+
+SECTION("ExtraCharges")
+    {
+    const int Nup = QN::addCharge(),
+              K = QN::addCharge(3);
+    CHECK_EQUAL(QN::nCharges(),5);
+    CHECK_EQUAL(QN::modulus(Nup),0);
+    CHECK_EQUAL(QN::modulus(K),3);
+
+    auto a = QN(1,1).setCharge(Nup,1).setCharge(K,2),
+         b = QN(-1,1).setCharge(K,2);
+    CHECK_EQUAL(b.charge(Nup),0);
+
+    auto c = a+b;
+    CHECK_EQUAL(c.sz(),0);
+    CHECK_EQUAL(c.Nf(),2);
+    CHECK_EQUAL(c.charge(Nup),1);
+    CHECK_EQUAL(c.charge(K),1);
+
+    CHECK((c-b) == a);
+    CHECK_EQUAL((-a).charge(Nup),-1);
+    CHECK_EQUAL((-a).charge(K),1);
+    CHECK((a*In) == -a);
+    CHECK((a + (-a)) == QN());
+
+    //QNs differing only in an added charge are distinct sectors
+    auto d = QN(1,1).setCharge(K,1);
+    CHECK(d != QN(1,1));
+    CHECK(QN(1,1) < d);
+    CHECK(!(d < QN(1,1)));
+    std::unordered_set<QN> qs = { a, b, c, d, QN(1,1) };
+    CHECK_EQUAL(qs.size(),5);
+    CHECK(qs.count(QN(1,1).setCharge(K,4)) == 1);
+
+    std::stringstream ss;
+    a.write(ss);
+    QN r;
+    r.read(ss);
+    CHECK(r == a);
+
+    //Readable again once the same charges are registered
+    std::stringstream s5;
+    a.write(s5);
+    QN::resetCharges();
+    CHECK_EQUAL(QN::addCharge(),Nup);
+    CHECK_EQUAL(QN::addCharge(3),K);
+    QN r5;
+    r5.read(s5);
+    CHECK(r5 == a);
+
+    QN::resetCharges();
+    CHECK_EQUAL(QN::nCharges(),3);
+    }
+
+SECTION("QNReadOldLayout")
+    {
+    //sz, Nf, Nfp written without a header
+    std::stringstream ss;
+    const int old[3] = { -3, 5, 1 };
+    ss.write((const char*)old,sizeof(old));
+    QN r;
+    r.read(ss);
+    CHECK(r == QN(-3,5,1));
+
+    QN q(2,-4,0);
+    std::stringstream sn;
+    q.write(sn);
+    r.read(sn);
+    CHECK(r == q);
+    }
+
 
 }
@@ -1,5 +1,6 @@
 #include "test.h"
 #include "iqtensor.h"
+#include <sstream>
 
 using namespace itensor;
 using namespace std;
@@ -117,10 +118,113 @@ SECTION("Contracting Product")
 
     }
 
+SECTION("BlockMatching")
+    {
+    clearIQContractionStats();
+    IQTensor res = A * dag(B);
+    auto stats = iqContractionStats();
+
+    //Count block pairs sharing their L1 and L2 sectors
+    long nmatch = 0;
+    for(const ITensor& a : A.blocks())
+    for(const ITensor& b : B.blocks())
+        {
+        bool match = true;
+        for(const Index& i : b.indices()) 
+            {
+            if(!hasindex(a,i)) match = false;
+            }
+        if(match) ++nmatch;
+        }
+
+    CHECK_EQUAL(stats.contractions,1);
+    CHECK_EQUAL(stats.pairs,A.blocks().size()*B.blocks().size());
+    CHECK_EQUAL(stats.products,nmatch);
+    }
+
+SECTION("ParallelBlocks")
+    {
+    auto makeIndex = [](const std::string& name)
+        {
+        return IQIndex(name,
+                       Index(name+"+",40),QN(+1),
+                       Index(name+"0",40),QN( 0),
+                       Index(name+"-",40),QN(-1),Out);
+        };
+    IQIndex X = makeIndex("X"),
+            Y = makeIndex("Y"),
+            Z = makeIndex("Z"),
+            W = makeIndex("W");
+
+    IQTensor T1(X(41),dag(Y)(41),Z(41)),
+             T2(dag(Z)(41),Y(41),W(41)),
+             P(X(41),Y(41)),
+             Q(Y(41),W(41));
+    T1.randomize();
+    T2.randomize();
+    P.randomize();
+    Q.randomize();
+
+    const int nthread = Global::nthread();
+
+    Global::nthread() = 1;
+    IQTensor serial = T1 * T2,
+             serial_nc = P / Q;
+
+    Global::nthread() = 4;
+    IQTensor parallel = T1 * T2,
+             parallel_nc = P / Q;
+
+    Global::nthread() = nthread;
+
+    CHECK_EQUAL(parallel.blocks().size(),serial.blocks().size());
+    CHECK((parallel-serial).norm() < 1E-12*serial.norm());
+    CHECK_EQUAL(parallel_nc.blocks().size(),serial_nc.blocks().size());
+    CHECK((parallel_nc-serial_nc).norm() < 1E-12*serial_nc.norm());
+    CHECK_NOTHROW(checkStorage(parallel));
+    }
+
+SECTION("BatchedProducts")
+    {
+    //Blocks with the size 1 sector of X put the contracted
+    //index first and are batched; the others need permuting
+    //and are left to the block tasks
+    IQIndex X("X",Index("x+",1),QN(+1),Index("x-",3),QN(-1),Out),
+            Y("Y",Index("y+",2),QN(+1),Index("y-",2),QN(-1),Out),
+            Z("Z",Index("z+",4),QN(+1),Index("z-",4),QN(-1),Out),
+            W("W",Index("w+",2),QN(+2),Index("w0",3),QN( 0),Index("w-",2),QN(-2),Out);
+    IQTensor T(X(1),dag(W)(1),Y(1)),
+             U(W(1),dag(Z)(1));
+    T.randomize();
+    U.randomize();
+
+    batchBlockProducts(false);
+    const IQTensor ref = T * U;
+
+    const int nthread = Global::nthread();
+    batchBlockProducts(true);
+    for(int nt : { 1, 4 })
+        {
+        Global::nthread() = nt;
+        clearIQContractionStats();
+        const IQTensor res = T * U;
+        const auto stats = iqContractionStats();
+        CHECK(stats.batched > 0);
+        CHECK(stats.batched < stats.products);
+        CHECK((res-ref).norm() < 1E-12*ref.norm());
+        CHECK_NOTHROW(checkStorage(res));
+        }
+    Global::nthread() = nthread;
+#ifndef PLATFORM_mkl
+    batchBlockProducts(false);
+#endif
+    }
+
 SECTION("NonContractProd")
     {
 
     IQTensor res = A / B;
+    CHECK_NOTHROW(checkStorage(res));
 
     for(int j1 = 1; j1 <= L1.m(); ++j1)
     for(int j2 = 1; j2 <= L2.m(); ++j2)
@@ -445,6 +549,97 @@ SECTION("AddBlock")
     
     }
 
+SECTION("BlockStorage")
+    {
+    //Only blocks consistent with the divergence are stored
+    int nblock = 0;
+    for(int j1 = 1; j1 <= L1.nindex(); ++j1)
+    for(int k1 = 1; k1 <= S1.nindex(); ++k1)
+    for(int j2 = 1; j2 <= L2.nindex(); ++j2)
+    for(int k2 = 1; k2 <= S2.nindex(); ++k2)
+        {
+        QN q = L1.qn(j1)*L1.dir()+S1.qn(k1)*S1.dir()
+              +L2.qn(j2)*L2.dir()+S2.qn(k2)*S2.dir();
+        if(q == div(A)) ++nblock;
+        }
+    CHECK_EQUAL(A.blocks().size(),nblock);
+    CHECK_NOTHROW(checkStorage(A));
+
+    IQTensor P = A * dag(B);
+    CHECK_NOTHROW(checkStorage(P));
+    CHECK(P.blocks().size() <= S1.nindex()*S2.nindex());
+
+    std::stringstream ss;
+    A.write(ss);
+    IQTensor RA;
+    RA.read(ss);
+    CHECK_EQUAL(RA.blocks().size(),nblock);
+    CHECK((RA-A).norm() < 1E-12);
+    CHECK_NOTHROW(checkStorage(RA));
+
+    //The blocks read view one buffer, in order
+    CHECK(RA.blocks().packed());
+
+    //Complex blocks
+    IQTensor CA = Complex(1,2)*A;
+    std::stringstream cs;
+    CA.write(cs);
+    IQTensor RC;
+    RC.read(cs);
+    CHECK(!RC.blocks().packed());
+    CHECK((realPart(RC)-A).norm() < 1E-12);
+    CHECK((imagPart(RC)-2*A).norm() < 1E-12);
+    }
+
+SECTION("PackedBlocks")
+    {
+    //Products of real IQTensors are laid out in one buffer
+    IQTensor P = A * dag(B),
+             Q = A * dag(B);
+    Q.randomize();
+    CHECK(P.blocks().packed());
+    CHECK(!Q.blocks().packed());
+    CHECK(P.blocks().sameLayout(P.blocks()));
+    const ITensor Pt = P.toITensor(),
+                  Qt = Q.toITensor();
+
+    CHECK_CLOSE(P.norm(),Pt.norm(),1E-12);
+    CHECK_CLOSE(Dot(P,3*P),3*sqr(Pt.norm()),1E-10);
+    CHECK_CLOSE(BraKet(P,P).real(),sqr(Pt.norm()),1E-10);
+    CHECK_CLOSE(Dot(P,Q),Dot(Pt,Qt),1E-10);
+
+    //The data of P is shared with its copy, so the sum goes
+    //into a new buffer
+    IQTensor S = P;
+    IQTensor P2 = 2*P;
+    S += P2;
+    CHECK(S.blocks().packed());
+    CHECK((S.toITensor()-3*Pt).norm() < 1E-12);
+    CHECK((P.toITensor()-Pt).norm() < 1E-12);
+
+    //Now the sum is made in place
+    S += P2;
+    CHECK(S.blocks().packed());
+    CHECK((S.toITensor()-5*Pt).norm() < 1E-12);
+    CHECK((P2.toITensor()-2*Pt).norm() < 1E-12);
+
+    //Sums with unpacked data
+    S += Q;
+    CHECK((S.toITensor()-5*Pt-Qt).norm() < 1E-12);
+
+    //Modifying a block copies it out of the buffer
+    IQTensor M = A * dag(B);
+    CHECK(M.blocks().packed());
+    M.randomize();
+    CHECK(!M.blocks().packed());
+    CHECK((P.toITensor()-Pt).norm() < 1E-12);
+
+    //Non-contracting products are packed too
+    IQTensor N = A / B;
+    CHECK(N.blocks().packed());
+    CHECK_NOTHROW(checkStorage(N));
+    }
+
 SECTION("ComplexConvert")
     {
     IQTensor R(S1(1),L1(3)),
@@ -1,5 +1,8 @@
 #include "test.h"
+#include <fstream>
+#include <cstdio>
 #include "itensor.h"
+#include "combiner.h"
 
 using namespace std;
 using namespace itensor;
@@ -620,6 +623,55 @@ SECTION("SumDifference")
 
 }
 
+SECTION("PermutedAddition")
+    {
+    ITensor A(b2,a1,b3,b4),
+            B(b4,b3,a1,b2);
+    A.randomize();
+    B.randomize();
+
+    auto checkSum = [&](const ITensor& S, Real fa, Real fb)
+        {
+        for(int j2 = 1; j2 <= 2; ++j2)
+        for(int j3 = 1; j3 <= 3; ++j3)
+        for(int j4 = 1; j4 <= 4; ++j4)
+            {
+            CHECK_CLOSE(S(b2(j2),b3(j3),b4(j4)),
+                        fa*A(b2(j2),b3(j3),b4(j4))+fb*B(b2(j2),b3(j3),b4(j4)),1E-10);
+            }
+        };
+
+    //Scale of the left-hand side smaller, then larger
+    ITensor S1 = 1E-3*A;
+    S1 += 1E3*B;
+    checkSum(S1,1E-3,1E3);
+    ITensor S2 = 1E3*A;
+    S2 -= 1E-3*B;
+    checkSum(S2,1E3,-1E-3);
+
+    //Data shared with another tensor is left unchanged
+    ITensor S3(A);
+    S3 += 2*B;
+    checkSum(S3,1,2);
+    checkSum(A,1,0);
+
+    //Complex parts
+    ITensor C = Complex(1,2)*A;
+    C += Complex(3,-1)*B;
+    checkSum(realPart(C),1,3);
+    checkSum(imagPart(C),2,-1);
+
+    ITensor R(A);
+    R += Complex(0,0.5)*B;
+    checkSum(realPart(R),1,0);
+    checkSum(imagPart(R),0,0.5);
+
+    ITensor I = Complex(0,4)*A;
+    I += 0.25*B;
+    checkSum(realPart(I),0,0.25);
+    checkSum(imagPart(I),4,0);
+    }
+
 SECTION("ContractingProduct")
     {
 
@@ -896,6 +948,386 @@ SECTION("ComplexNonContractingProduct")
     CHECK(rdiff.norm() < 1E-12);
     CHECK(idiff.norm() < 1E-12);
 
+    //Only one of the two complex
+    ITensor res2 = Lr / R;
+    CHECK((realPart(res2)-Lr/Rr).norm() < 1E-12);
+    CHECK((imagPart(res2)-Lr/Ri).norm() < 1E-12);
+
+    ITensor res3 = L / Rr;
+    CHECK((realPart(res3)-Lr/Rr).norm() < 1E-12);
+    CHECK((imagPart(res3)-Li/Rr).norm() < 1E-12);
+
+    }
+
+SECTION("ComplexContractingProduct")
+    {
+    ITensor Lr(b2,a1,b3,b4,b5), Li(b2,a1,b3,b4,b5),
+            Rr(b5,b3,a2,l2), Ri(b5,b3,a2,l2);
+
+    Lr.randomize(); 
+    Li.randomize(); 
+    Rr.randomize();
+    Ri.randomize();
+    Lr *= 2.5;
+    Ri *= -0.3;
+
+    ITensor L = Complex_1*Lr + Complex_i*Li;
+    ITensor R = Complex_1*Rr + Complex_i*Ri;
+
+    //Complex times complex
+    ITensor res1 = L * R;
+    CHECK(res1.isComplex());
+    CHECK_EQUAL(res1.r(),5);
+    CHECK(hasindex(res1,b2));
+    CHECK(hasindex(res1,b4));
+    CHECK(hasindex(res1,l2));
+    CHECK(hasindex(res1,a1));
+    CHECK(hasindex(res1,a2));
+    CHECK(!hasindex(res1,b3));
+    CHECK(!hasindex(res1,b5));
+
+    ITensor rdiff = realPart(res1)-(Lr*Rr-Li*Ri);
+    ITensor idiff = imagPart(res1)-(Lr*Ri+Li*Rr);
+    CHECK(rdiff.norm() < 1E-12);
+    CHECK(idiff.norm() < 1E-12);
+
+    //Complex times real
+    ITensor res2 = L * Rr;
+    CHECK(res2.isComplex());
+    CHECK((realPart(res2)-Lr*Rr).norm() < 1E-12);
+    CHECK((imagPart(res2)-Li*Rr).norm() < 1E-12);
+
+    //Real times complex
+    ITensor res3 = Lr * R;
+    CHECK(res3.isComplex());
+    CHECK((realPart(res3)-Lr*Rr).norm() < 1E-12);
+    CHECK((imagPart(res3)-Lr*Ri).norm() < 1E-12);
+
+    //Fully contracted
+    ITensor nrm2 = conj(L) * L;
+    CHECK_EQUAL(nrm2.r(),0);
+    CHECK_CLOSE(realPart(nrm2).toReal(),sqr(L.norm()),1E-10);
+    CHECK(fabs(imagPart(nrm2).toReal()) < 1E-10);
+    }
+
+SECTION("ContractionCache")
+    {
+    ITensor L(b2,b3,b4,b5), 
+            R(b5,l2,b3);
+    L.randomize();
+    R.randomize();
+
+    clearContractionCache();
+
+    ITensor res1 = L * R;
+    CHECK_EQUAL(contractionCacheStats().misses,1);
+    CHECK_EQUAL(contractionCacheStats().hits,0);
+
+    //Same indices, different data: uses the cached plan
+    ITensor L2(L),
+            R2(R);
+    L2.randomize();
+    R2.randomize();
+    ITensor res2 = L2 * R2;
+    CHECK_EQUAL(contractionCacheStats().misses,1);
+    CHECK_EQUAL(contractionCacheStats().hits,1);
+
+    for(int i2 = 1; i2 <= b2.m(); ++i2)
+    for(int i4 = 1; i4 <= b4.m(); ++i4)
+    for(int j2 = 1; j2 <= l2.m(); ++j2)
+        {
+        Real val1 = 0,
+             val2 = 0;
+        for(int i3 = 1; i3 <= b3.m(); ++i3)
+        for(int i5 = 1; i5 <= b5.m(); ++i5)
+            {
+            val1 += L(b2(i2),b3(i3),b4(i4),b5(i5))*R(b5(i5),l2(j2),b3(i3));
+            val2 += L2(b2(i2),b3(i3),b4(i4),b5(i5))*R2(b5(i5),l2(j2),b3(i3));
+            }
+        CHECK_CLOSE(res1(b2(i2),b4(i4),l2(j2)),val1,1E-10);
+        CHECK_CLOSE(res2(b2(i2),b4(i4),l2(j2)),val2,1E-10);
+        }
+
+    //Other indices of the same dimensions, contracted
+    //in the same pattern, also use the cached plan
+    Index c3("c3",b3.m()),
+          c5("c5",b5.m());
+    ITensor Lc(b2,c3,b4,c5),
+            Rc(c5,l2,c3);
+    Lc.randomize();
+    Rc.randomize();
+    ITensor resc = Lc * Rc;
+    CHECK_EQUAL(contractionCacheStats().misses,1);
+    CHECK_EQUAL(contractionCacheStats().hits,2);
+    for(int i2 = 1; i2 <= b2.m(); ++i2)
+    for(int i4 = 1; i4 <= b4.m(); ++i4)
+    for(int j2 = 1; j2 <= l2.m(); ++j2)
+        {
+        Real val = 0;
+        for(int i3 = 1; i3 <= c3.m(); ++i3)
+        for(int i5 = 1; i5 <= c5.m(); ++i5)
+            {
+            val += Lc(b2(i2),c3(i3),b4(i4),c5(i5))*Rc(c5(i5),l2(j2),c3(i3));
+            }
+        CHECK_CLOSE(resc(b2(i2),b4(i4),l2(j2)),val,1E-10);
+        }
+
+    //Priming an index changes which ones are contracted
+    ITensor res3 = L * prime(R,b5);
+    CHECK_EQUAL(contractionCacheStats().misses,2);
+    CHECK_EQUAL(res3.r(),5);
+
+    clearContractionCache();
+    CHECK_EQUAL(contractionCacheStats().hits,0);
+    CHECK_EQUAL(contractionCacheStats().misses,0);
+    }
+
+SECTION("PanelContraction")
+    {
+    //Operands whose contracted indices are not contiguous,
+    //large enough to be split into several panels
+    Index i1("i1",41),
+          i2("i2",100),
+          c1("c1",15),
+          c2("c2",20),
+          r1("r1",2);
+    ITensor L(c1,i1,c2,i2);
+    L.randomize();
+
+    auto checkProduct = [&](const ITensor& R)
+        {
+        ITensor res = L * R;
+        CHECK_EQUAL(res.r(),3);
+        for(int j1 : {1,17,41})
+        for(int j2 : {1,50,100})
+        for(int k = 1; k <= r1.m(); ++k)
+            {
+            Real val = 0;
+            for(int n1 = 1; n1 <= c1.m(); ++n1)
+            for(int n2 = 1; n2 <= c2.m(); ++n2)
+                {
+                val += L(c1(n1),i1(j1),c2(n2),i2(j2))*R(c1(n1),c2(n2),r1(k));
+                }
+            CHECK_CLOSE(res(i1(j1),i2(j2),r1(k)),val,1E-10);
+            }
+        };
+
+    //R not matrix-like
+    ITensor R1(c2,r1,c1);
+    R1.randomize();
+    checkProduct(R1);
+
+    //R matrix-like, contracted indices first
+    ITensor R2(c1,c2,r1);
+    R2.randomize();
+    checkProduct(R2);
+
+    //R matrix-like, contracted indices last
+    ITensor R3(r1,c1,c2);
+    R3.randomize();
+    checkProduct(R3);
+    }
+
+SECTION("SinglePrecision")
+    {
+    Index i1("i1",30),
+          i2("i2",40),
+          c1("c1",15),
+          c2("c2",20);
+    ITensor L(c1,i1,c2,i2),
+            R(c2,c1,prime(i2));
+    L.randomize();
+    R.randomize();
+    ITensor M(i1,c1,c2);
+    M.randomize();
+
+    ITensor dres1 = L * R,
+            dres2 = M * R;
+
+    ITensor sL(L),
+            sM(M);
+    sL.toSinglePrecision();
+    sM.toSinglePrecision();
+    CHECK(sL.isSinglePrecision());
+    CHECK(!L.isSinglePrecision());
+    CHECK(fabs(sL.norm()-L.norm()) < 1E-5*L.norm());
+
+    ITensor sres1 = sL * R,
+            sres2 = sM * R;
+    CHECK(sres1.isSinglePrecision());
+    CHECK((sres1-dres1).norm() < 1E-5*dres1.norm());
+    CHECK((sres2-dres2).norm() < 1E-5*dres2.norm());
+
+    //Adding reads single precision data without promoting it
+    ITensor sum = sL;
+    sum += L;
+    CHECK(sL.isSinglePrecision());
+    CHECK(!sum.isSinglePrecision());
+    CHECK((sum-2*L).norm() < 1E-5*L.norm());
+
+    //Modifying a tensor returns it to double precision
+    sM *= 2;
+    sM.randomize();
+    CHECK(!sM.isSinglePrecision());
+
+    sres1.toDoublePrecision();
+    CHECK(!sres1.isSinglePrecision());
+    CHECK((sres1-dres1).norm() < 1E-5*dres1.norm());
+    }
+
+SECTION("MultiplyBatch")
+    {
+    Index i1("i1",6),
+          i2("i2",7),
+          c1("c1",5),
+          c2("c2",4);
+    //Pairs of two matrix product shapes (one of them twice),
+    //one needing permuting and one complex
+    ITensor L1(i1,c1),
+            L2(i1,c1),
+            R1(c1,i2),
+            L3(c1,c2,i1),
+            R3(c1,c2),
+            L4(c2,i1,c1),
+            R4(i2,c1,c2);
+    for(ITensor* t : {&L1,&L2,&R1,&L3,&R3,&L4,&R4}) t->randomize();
+    L2 *= 3;
+    ITensor C1 = Complex_i*L1;
+
+    vector<std::pair<const ITensor*,const ITensor*>> prods 
+        = {{&L1,&R1},{&L3,&R3},{&L2,&R1},{&L4,&R4},{&C1,&R1}};
+    vector<ITensor> res(prods.size());
+    const vector<bool> batched = multiplyBatch(prods,[&res](size_t n, ITensor& T)
+        {
+        res[n] = T;
+        });
+    REQUIRE(batched.size() == prods.size());
+    //The permuted and the complex products are left out
+    CHECK(batched == vector<bool>({ true, true, true, false, false }));
+    for(size_t n = 0; n < prods.size(); ++n)
+        {
+        if(!batched[n]) 
+            {
+            CHECK(!res[n].valid());
+            continue;
+            }
+        ITensor ref = (*prods[n].first) * (*prods[n].second);
+        CHECK((res[n]-ref).norm() < 1E-12*ref.norm());
+        }
+    }
+
+SECTION("ContractionTuning")
+    {
+    ITensor L(b2,b3,b4,b5), 
+            R(b5,l2,b3);
+    L.randomize();
+    R.randomize();
+    ITensor ref = L * R;
+
+    clearContractionTuning();
+    autotuneContraction(true);
+    ITensor res1 = L * R;
+    ITensor res2 = L * R;
+    autotuneContraction(false);
+    CHECK((res1-ref).norm() < 1E-12*ref.norm());
+    CHECK((res2-ref).norm() < 1E-12*ref.norm());
+
+    const std::string fname = "contraction_tuning_test.txt";
+    writeContractionTuning(fname);
+    clearContractionTuning();
+    readContractionTuning(fname);
+    std::ifstream f(fname);
+    std::string header,
+                line;
+    std::getline(f,header);
+    int nline = 0;
+    while(std::getline(f,line)) ++nline;
+    CHECK_EQUAL(nline,1);
+    std::remove(fname.c_str());
+
+    //Either kernel, per shape class
+    for(std::string kernel : {"small","gemm"})
+        {
+        std::ofstream tf(fname);
+        for(int l = 0; l < 16; ++l)
+        for(int c = 0; c < 16; ++c)
+        for(int r = 0; r < 16; ++r)
+            {
+            tf << l << " " << c << " " << r << " " << kernel << "\n";
+            }
+        tf.close();
+        readContractionTuning(fname);
+        std::remove(fname.c_str());
+        ITensor res = L * R;
+        CHECK((res-ref).norm() < 1E-12*ref.norm());
+        ITensor A(b2,l2),
+                B(l2,b3);
+        A.randomize();
+        B.randomize();
+        ITensor AB = A * B;
+        for(int i = 1; i <= b2.m(); ++i)
+        for(int k = 1; k <= b3.m(); ++k)
+            {
+            Real val = 0;
+            for(int j = 1; j <= l2.m(); ++j) val += A(b2(i),l2(j))*B(l2(j),b3(k));
+            CHECK_CLOSE(AB(b2(i),b3(k)),val,1E-12);
+            }
+        }
+    clearContractionTuning();
+    }
+
+SECTION("HighRank")
+    {
+    //Tensors with more than NMAX indices
+    std::vector<Index> i, 
+                       j;
+    for(int n = 1; n <= 10; ++n)
+        {
+        i.push_back(Index(nameint("i",n),2));
+        j.push_back(Index(nameint("j",n),(n%2 == 0 ? 2 : 3)));
+        }
+    const std::vector<Index> bi = { i[5],i[6],i[7],i[8],i[9],j[0],j[1],j[2],j[3],j[4],a1 };
+    const IndexSet<Index> isA(i),
+                          isB(bi);
+    ITensor A(isA),
+            B(isB);
+    A.randomize();
+    B.randomize();
+
+    ITensor C = A * B;
+    CHECK_EQUAL(C.r(),11);
+    CHECK_EQUAL(C.indices().rn(),10);
+    for(int n = 0; n < 5; ++n) CHECK(hasindex(C,i[n]));
+    for(int n = 0; n < 5; ++n) CHECK(hasindex(C,j[n]));
+    CHECK(hasindex(C,a1));
+
+    //Same product done through Combiners,
+    //with all tensors of rank <= NMAX
+    Combiner c1(i[0],i[1],i[2]),
+             c2(i[5],i[6],i[7],i[8]);
+    ITensor Ac = A * c1 * c2,
+            Bc = B * c2;
+    CHECK(Ac.r() <= NMAX);
+    CHECK(Bc.r() <= NMAX);
+    ITensor Cc = Ac * Bc;
+    CHECK((C * c1 - Cc).norm() < 1E-12*Cc.norm());
+
+    //Sum with a copy having its m!=1 indices reversed
+    std::vector<Index> rev(C.indices().begin(),C.indices().end());
+    std::reverse(rev.begin(),rev.end());
+    Permutation P(1);
+    for(int n = 1; n <= 10; ++n) P.setFromTo(n,11-n);
+    const IndexSet<Index> isD(rev);
+    ITensor D(isD,C,P);
+    CHECK_EQUAL(D.indices()[0],C.indices()[9]);
+    CHECK((D - C).norm() < 1E-12);
+    ITensor E = C;
+    E += 2*D;
+    CHECK((E - 3*C).norm() < 1E-12*C.norm());
+
+    ITensor T = tieIndices(C,i[0],i[1],i[0]);
+    CHECK_EQUAL(T.r(),10);
+    CHECK(hasindex(T,i[0]));
     }
 
 SECTION("TieIndices")
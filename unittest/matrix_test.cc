@@ -3,6 +3,7 @@
 #include "global.h"
 #include "math.h"
 #include "matrix.h"
+#include <thread>
 
 using namespace itensor;
 using namespace std;
@@ -291,6 +292,38 @@ SECTION("TestNormalMatrixDiag")
     REQUIRE(Norm(ImPart.TreatAsVector()) < 1E-12);
     }
 
+SECTION("LowestEigenValues")
+    {
+    const int N = 40,
+              k = 7;
+    Matrix B(N,N);
+    B.Randomize();
+    Matrix A = B+B.t();
+
+    Vector D;
+    Matrix U;
+    EigenValues(A,D,U);
+
+    Vector Dk;
+    Matrix Uk;
+    LowestEigenValues(A,Dk,Uk,k);
+    REQUIRE(Dk.Length() == k);
+    REQUIRE(Uk.Nrows() == N);
+    REQUIRE(Uk.Ncols() == k);
+
+    Vector diff = Dk-D.SubVector(1,k);
+    CHECK(Norm(diff) < 1E-12);
+    for(int j = 1; j <= k; ++j)
+        {
+        Vector r = A*Uk.Column(j)-Dk(j)*Uk.Column(j);
+        CHECK(Norm(r) < 1E-12);
+        }
+    Matrix Id(k,k);
+    Id = 1;
+    Matrix O = Uk.t()*Uk-Id;
+    CHECK(Norm(O.TreatAsVector()) < 1E-12);
+    }
+
 SECTION("ComplexOrthog")
     {
     //
@@ -371,6 +404,53 @@ SECTION("RectQR")
     REQUIRE(Norm(Matrix(Q.t()*Q-I).TreatAsVector()) < 1E-14);
     }
 
+SECTION("TallQR")
+    {
+    const
+    int r = 10,
+        c = 4;
+
+    Matrix M(r,c);
+    M.Randomize();
+
+    Matrix Q,
+           R;
+    QRDecomp(M,Q,R);
+    CHECK_EQUAL(Q.Nrows(),r);
+    CHECK_EQUAL(Q.Ncols(),c);
+    CHECK_EQUAL(R.Nrows(),c);
+
+    Matrix I(c,c);
+    I = 0;
+    I.Diagonal() = 1;
+
+    REQUIRE(Norm(Matrix(Q*R-M).TreatAsVector()) < 1E-14);
+    REQUIRE(Norm(Matrix(Q.t()*Q-I).TreatAsVector()) < 1E-14);
+    for(int i = 2; i <= c; ++i)
+    for(int j = 1; j < i; ++j)
+        {
+        CHECK(R(i,j) == 0);
+        }
+
+    //Complex version
+    Matrix Mim(r,c);
+    Mim.Randomize();
+    Matrix Qre,Qim,
+           Rre,Rim;
+    QRDecomp(M,Mim,Qre,Qim,Rre,Rim);
+
+    Matrix Dre = Qre*Rre - Qim*Rim - M,
+           Dim = Qre*Rim + Qim*Rre - Mim;
+    REQUIRE(Norm(Dre.TreatAsVector()) < 1E-13);
+    REQUIRE(Norm(Dim.TreatAsVector()) < 1E-13);
+
+    //Q^dagger*Q = 1
+    Matrix Ore = Qre.t()*Qre + Qim.t()*Qim - I,
+           Oim = Qre.t()*Qim - Qim.t()*Qre;
+    REQUIRE(Norm(Ore.TreatAsVector()) < 1E-13);
+    REQUIRE(Norm(Oim.TreatAsVector()) < 1E-13);
+    }
+
 SECTION("ComplexEV")
     {
     const int N = 40;
@@ -414,4 +494,28 @@ SECTION("ComplexEV")
         REQUIRE(nrm < 1E-12);
         }
     }
+SECTION("ConcurrentStorage")
+    {
+    //Matrices and Vectors made and destroyed on
+    //several threads keep the shared counters exact
+    const long storage = StoreLink::TotalStorage(),
+               objects = StoreLink::NumObjects();
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t)
+        {
+        threads.emplace_back([]()
+            {
+            for(int n = 0; n < 2000; ++n)
+                {
+                Matrix M(8,8);
+                Vector V(8);
+                M = 1;
+                V = M.Column(1);
+                }
+            });
+        }
+    for(auto& t : threads) t.join();
+    CHECK_EQUAL(StoreLink::TotalStorage(),storage);
+    CHECK_EQUAL(StoreLink::NumObjects(),objects);
+    }
 }
@@ -75,5 +75,33 @@ SECTION("PositionTest")
     CHECK_EQUAL(findCenter(psi),4);
     }
 
+SECTION("PositionQR")
+    {
+    MPS psi = sum(MPS(shFerro),MPS(shNeel));
+    psi.Anc(3) *= Complex_i;
+    const MPS psi0(psi);
+    const Real nrm2 = psiphi(psi0,psi0);
+
+    //No truncation requested: the gauge
+    //is moved by QR and psi is unchanged
+    psi.position(N);
+    CHECK(psi.isOrtho());
+    CHECK_EQUAL(psi.orthoCenter(),N);
+    CHECK_CLOSE(psiphi(psi,psi0),nrm2,1E-10);
+
+    psi.position(1);
+    CHECK_EQUAL(psi.orthoCenter(),1);
+    CHECK_CLOSE(psiphi(psi,psi0),nrm2,1E-10);
+
+    IQMPS iqpsi(shNeel);
+    iqpsi.Anc(3) *= Complex_i;
+    iqpsi.position(N);
+    CHECK_EQUAL(findCenter(iqpsi),N);
+    CHECK(checkQNs(iqpsi));
+    iqpsi.position(1);
+    CHECK_EQUAL(findCenter(iqpsi),1);
+    CHECK_CLOSE(iqpsi.norm(),1,1E-10);
+    }
+
 
 }
@@ -0,0 +1,103 @@
+#include "test.h"
+#include "pool.h"
+#include "itensor.h"
+#include <vector>
+
+using namespace itensor;
+
+using PoolVec = std::vector<Real,PoolAllocator<Real>>;
+
+TEST_CASE("Pool")
+{
+
+SECTION("Reuse")
+    {
+    clearPool();
+    const Real* first = nullptr;
+        {
+        PoolVec v(1000,1.);
+        first = v.data();
+        }
+    CHECK_EQUAL(poolStats().fresh,1);
+
+    //Same size class, so the freed block comes back
+    PoolVec w(990,2.);
+    CHECK(w.data() == first);
+    CHECK_EQUAL(poolStats().reused,1);
+    CHECK_EQUAL(poolStats().fresh,1);
+    for(auto x : w) CHECK_EQUAL(x,2.);
+
+    //Different size class
+    PoolVec u(5000,3.);
+    CHECK_EQUAL(poolStats().fresh,2);
+
+    clearPool();
+    CHECK_EQUAL(poolStats().reused,0);
+    }
+
+SECTION("LargeBlocks")
+    {
+    PoolVec v(10000000,1.);
+    v.back() = 2;
+    CHECK_EQUAL(v.front(),1.);
+    CHECK_EQUAL(v.back(),2.);
+    }
+
+SECTION("Arena")
+    {
+    clearPool();
+    PoolVec keep;
+        {
+        PoolArena arena(1 << 16);
+        for(int n = 1; n <= 100; ++n)
+            {
+            PoolVec v(n*100,Real(n));
+            CHECK_EQUAL(v[n-1],Real(n));
+            }
+        keep.assign(5000,7.);
+        CHECK_EQUAL(poolStats().arena,101);
+        CHECK_EQUAL(poolStats().fresh,0);
+        }
+    //Storage made inside the arena outlives it
+    for(auto x : keep) CHECK_EQUAL(x,7.);
+    keep = PoolVec();
+
+    //Outside of the arena the pool is used again
+    PoolVec v(100);
+    CHECK_EQUAL(poolStats().arena,101);
+    CHECK_EQUAL(poolStats().fresh,1);
+    }
+
+SECTION("NestedArenas")
+    {
+    clearPool();
+    PoolArena outer;
+        {
+        PoolArena inner;
+        PoolVec v(10,1.);
+        }
+    PoolVec w(10,2.);
+    CHECK_EQUAL(poolStats().arena,2);
+    CHECK_EQUAL(w[9],2.);
+    }
+
+SECTION("ITensorStorage")
+    {
+    Index i("i",10),
+          j("j",20),
+          k("k",30);
+    ITensor A(i,j),
+            B(j,k);
+    A.randomize();
+    B.randomize();
+    ITensor C = A*B;
+        {
+        PoolArena arena;
+        ITensor D = A*B;
+        CHECK((C-D).norm() < 1E-12);
+        C = D;
+        }
+    CHECK((C-A*B).norm() < 1E-12);
+    }
+
+}
@@ -0,0 +1,252 @@
+#include "test.h"
+#include "su2tensor.h"
+#include <cmath>
+
+using namespace itensor;
+
+Real static
+maxDiff(const Matrix& A, const Matrix& B)
+    {
+    Real res = 0;
+    for(int i = 1; i <= A.Nrows(); ++i)
+    for(int j = 1; j <= A.Ncols(); ++j)
+        {
+        res = std::max(res,std::fabs(A(i,j)-B(i,j)));
+        }
+    return res;
+    }
+
+TEST_CASE("SU2")
+{
+
+SECTION("Triangle")
+    {
+    CHECK(su2Triangle(1,1,0));
+    CHECK(su2Triangle(1,1,2));
+    CHECK(!su2Triangle(1,1,1));
+    CHECK(!su2Triangle(1,1,4));
+    CHECK(su2Triangle(3,2,1));
+    CHECK(!su2Triangle(2,2,-2));
+    }
+
+SECTION("ClebschGordan")
+    {
+    const Real r2 = 1./std::sqrt(2.),
+               r3 = 1./std::sqrt(3.);
+
+    //Two spin 1/2's
+    CHECK_CLOSE(clebschGordan(1,1,1,1,2,2),1,1E-12);
+    CHECK_CLOSE(clebschGordan(1,1,1,-1,2,0),r2,1E-12);
+    CHECK_CLOSE(clebschGordan(1,-1,1,1,2,0),r2,1E-12);
+    CHECK_CLOSE(clebschGordan(1,1,1,-1,0,0),r2,1E-12);
+    CHECK_CLOSE(clebschGordan(1,-1,1,1,0,0),-r2,1E-12);
+
+    //Two spin 1's to a singlet
+    CHECK_CLOSE(clebschGordan(2,2,2,-2,0,0),r3,1E-12);
+    CHECK_CLOSE(clebschGordan(2,0,2,0,0,0),-r3,1E-12);
+
+    //Selection rules
+    CHECK(clebschGordan(1,1,1,1,2,0) == 0);
+    CHECK(clebschGordan(1,1,1,1,4,2) == 0);
+    CHECK(clebschGordan(1,3,1,-1,2,2) == 0);
+
+    //Orthonormality: spin 3/2 times spin 1
+    const int tj1 = 3,
+              tj2 = 2;
+    for(int tj = 1; tj <= 5; tj += 2)
+    for(int tjp = 1; tjp <= 5; tjp += 2)
+    for(int tm = -1; tm <= 1; tm += 2)
+        {
+        Real overlap = 0;
+        for(int tm1 = -tj1; tm1 <= tj1; tm1 += 2)
+            {
+            const int tm2 = tm-tm1;
+            overlap += clebschGordan(tj1,tm1,tj2,tm2,tj,tm)
+                      *clebschGordan(tj1,tm1,tj2,tm2,tjp,tm);
+            }
+        CHECK_CLOSE(overlap,(tj == tjp ? 1 : 0),1E-12);
+        }
+    }
+
+SECTION("Wigner3j")
+    {
+    //( 1/2 1/2 1 ; 1/2 -1/2 0 ) = 1/sqrt(6)
+    CHECK_CLOSE(wigner3j(1,1,1,-1,2,0),1./std::sqrt(6.),1E-12);
+
+    //Invariant under cyclic permutations of the columns
+    const Real w = wigner3j(3,1,2,-2,1,1);
+    CHECK(std::fabs(w) > 1E-3);
+    CHECK_CLOSE(wigner3j(2,-2,1,1,3,1),w,1E-12);
+    CHECK_CLOSE(wigner3j(1,1,3,1,2,-2),w,1E-12);
+
+    CHECK(wigner3j(1,1,1,1,2,0) == 0);
+    }
+
+SECTION("Wigner6j")
+    {
+    //{ a b c ; b a 0 } = (-1)^(a+b+c)/sqrt((2a+1)(2b+1))
+    CHECK_CLOSE(wigner6j(1,1,2,1,1,0),0.5,1E-12);
+    CHECK_CLOSE(wigner6j(1,1,0,1,1,0),-0.5,1E-12);
+    CHECK_CLOSE(wigner6j(2,3,1,3,2,0),-1./std::sqrt(12.),1E-12);
+
+    CHECK(wigner6j(1,1,1,1,1,1) == 0);
+
+    //Orthogonality: sum_x (2x+1)(2f+1) {a b x; c d f}{a b x; c d g} = delta(f,g)
+    const int ta = 2, tb = 2, tc = 2, td = 2;
+    for(int tf = 0; tf <= 4; tf += 2)
+    for(int tg = 0; tg <= 4; tg += 2)
+        {
+        Real sum = 0;
+        for(int tx = 0; tx <= 4; tx += 2)
+            {
+            sum += (tx+1)*(tf+1)*wigner6j(ta,tb,tx,tc,td,tf)
+                                *wigner6j(ta,tb,tx,tc,td,tg);
+            }
+        CHECK_CLOSE(sum,(tf == tg ? 1 : 0),1E-12);
+        }
+
+    //Cached values agree with the first evaluation
+    CHECK_CLOSE(wigner6j(2,3,1,3,2,0),-1./std::sqrt(12.),1E-12);
+    }
+
+}
+
+TEST_CASE("SU2Tensor")
+{
+//Spin 0 (twice), spin 1/2 and spin 1 (twice)
+SU2Index I;
+I.addMultiplet(0,2).addMultiplet(1,1).addMultiplet(2,2);
+
+SU2Index J;
+J.addMultiplet(1,2).addMultiplet(2,1).addMultiplet(3,1);
+
+SECTION("Index")
+    {
+    CHECK(I.nmult() == 3);
+    CHECK(I.m() == 5);
+    CHECK(I.fullDim() == 10);
+    CHECK(I.degOf(2) == 2);
+    CHECK(I.degOf(3) == 0);
+    CHECK(I.fullOffset(3) == 4);
+
+    SU2Index K(I);
+    K.addMultiplet(1,2);
+    CHECK(K.nmult() == 3);
+    CHECK(K.degOf(1) == 3);
+    }
+
+SECTION("SpinOperator")
+    {
+    SU2Index s;
+    s.addMultiplet(1,1);
+
+    //<1/2||S||1/2> = sqrt(j(j+1)(2j+1))
+    SU2Tensor S(s,s,2);
+    S.block(1,1)(1,1) = std::sqrt(1.5);
+    CHECK(S.findBlock(1,1) != nullptr);
+    CHECK(S.findBlock(1,3) == nullptr);
+
+    const Matrix Sz = S.toMatrix(0);
+    CHECK_CLOSE(Sz(1,1),0.5,1E-12);
+    CHECK_CLOSE(Sz(2,2),-0.5,1E-12);
+    CHECK_CLOSE(Sz(1,2),0,1E-12);
+
+    //S_{+1} = -S^+/sqrt(2)
+    const Matrix Sp = S.toMatrix(2);
+    CHECK_CLOSE(Sp(1,2),-1./std::sqrt(2.),1E-12);
+    CHECK_CLOSE(Sp(2,1),0,1E-12);
+
+    //S.S = -sqrt(3) [S x S]^0 = 3/4
+    SU2Tensor SS = product(S,S,0);
+    SS *= -std::sqrt(3.);
+    const Matrix M = SS.toMatrix(0);
+    CHECK_CLOSE(M(1,1),0.75,1E-12);
+    CHECK_CLOSE(M(2,2),0.75,1E-12);
+    CHECK_CLOSE(M(1,2),0,1E-12);
+    }
+
+SECTION("Product")
+    {
+    //Spin 1 operators from J to I and from I to J
+    SU2Tensor A(I,J,2),
+              B(J,I,2);
+    A.randomize();
+    B.randomize();
+    CHECK(A.nblocks() > 0);
+
+    //Full operators recoupled with Clebsch-Gordan
+    //coefficients must match the reduced product
+    for(int tK = 0; tK <= 4; tK += 2)
+        {
+        const SU2Tensor C = product(A,B,tK);
+        for(int tQ = -tK; tQ <= tK; tQ += 2)
+            {
+            Matrix F(I.fullDim(),I.fullDim());
+            F = 0;
+            for(int tq1 = -2; tq1 <= 2; tq1 += 2)
+                {
+                const int tq2 = tQ-tq1;
+                const Real cg = clebschGordan(2,tq1,2,tq2,tK,tQ);
+                if(cg == 0) continue;
+                F += cg*(A.toMatrix(tq1)*B.toMatrix(tq2));
+                }
+            CHECK(maxDiff(C.toMatrix(tQ),F) < 1E-12);
+            }
+        }
+
+    //Scalars multiply as ordinary operators
+    SU2Tensor X(I,J),
+              Y(J,J);
+    X.randomize();
+    Y.randomize();
+    const Matrix XY = X.toMatrix()*Y.toMatrix();
+    CHECK(maxDiff((X*Y).toMatrix(),XY) < 1E-12);
+
+    //The norm is that of the full operator
+    Real nrm2 = 0;
+    for(int tq = -2; tq <= 2; tq += 2)
+        {
+        const Matrix Aq = A.toMatrix(tq);
+        nrm2 += Trace(Aq*Aq.t());
+        }
+    CHECK_CLOSE(A.norm(),std::sqrt(nrm2),1E-12);
+
+    SU2Tensor Z = X;
+    Z += X;
+    CHECK_CLOSE(Z.norm(),2*X.norm(),1E-12);
+    }
+
+SECTION("SVD")
+    {
+    SU2Tensor T(I,J);
+    T.randomize();
+
+    SU2Tensor U, D, V;
+    Real err = svd(T,U,D,V,{"Cutoff",0.});
+    CHECK(err < 1E-14);
+    CHECK(maxDiff((U*D*V).toMatrix(),T.toMatrix()) < 1E-12);
+
+    //Full U and V are isometries
+    const Matrix Uf = U.toMatrix(),
+                 Vf = V.toMatrix();
+    Matrix Id(Uf.Ncols(),Uf.Ncols());
+    Id = 1;
+    CHECK(maxDiff(Uf.t()*Uf,Id) < 1E-12);
+    CHECK(maxDiff(Vf*Vf.t(),Id) < 1E-12);
+
+    //Truncating counts every projection toward Maxm
+    err = svd(T,U,D,V,{"Cutoff",0.,"Maxm",4});
+    CHECK(U.col().fullDim() <= 4);
+    CHECK(err > 0);
+    const SU2Tensor R = U*D*V;
+    Real diff2 = 0;
+    const Matrix Rf = R.toMatrix(),
+                 Tf = T.toMatrix();
+    for(int i = 1; i <= Rf.Nrows(); ++i)
+    for(int j = 1; j <= Rf.Ncols(); ++j)
+        {
+        diff2 += sqr(Rf(i,j)-Tf(i,j));
+        }
+    CHECK_CLOSE(diff2/sqr(T.norm()),err,1E-10);
+    }
+}
@@ -526,6 +526,54 @@ SECTION("OrthoDecomp")
     }
 
 
+SECTION("QRDecomp")
+    {
+    ITensor phi(Phi0);
+    phi.randomize();
+
+    ITensor Q(L1,S1),R;
+    qrDecomp(phi,Q,R);
+
+    CHECK((phi-Q*R).norm() < 1E-12);
+
+    //Check that Q is isometric
+    Index ql = commonIndex(Q,R);
+    ITensor Id(prime(ql),ql,1);
+    CHECK((Id-dag(Q)*prime(Q,ql)).norm() < 1E-12);
+
+    ITensor cphi(phi);
+    cphi.randomize();
+    phi += Complex_i*cphi;
+
+    Q = ITensor(L1,S1);
+    qrDecomp(phi,Q,R);
+
+    CHECK((phi-Q*R).norm() < 1E-12);
+    ql = commonIndex(Q,R);
+    Id = ITensor(prime(ql),ql,1);
+    CHECK((Id-dag(Q)*prime(Q,ql)).norm() < 1E-12);
+
+    //
+    // IQTensor version
+    //
+
+    Phi0.randomize();
+    IQTensor cPhi0(Phi0);
+    cPhi0.randomize();
+    Phi0 += Complex_i*cPhi0;
+
+    IQTensor C(L1,S1),D;
+    qrDecomp(Phi0,C,D);
+
+    CHECK((Phi0-C*D).norm() < 1E-12);
+    CHECK_EQUAL(div(C),Zero);
+
+    ITensor c = C.toITensor();
+    IQIndex QL = commonIndex(C,D);
+    Id = ITensor(prime(QL),QL,1);
+    CHECK((Id-dag(c)*prime(c,QL)).norm() < 1E-12);
+    }
+
 SECTION("EigDecomp")
     {
     Index i("i",4),
@@ -615,4 +663,243 @@ SECTION("Returned Spectrum scale")
         }
     CHECK(fabs(spec.eig(1)-maxDD) < 1E-12);
     }
+SECTION("ParallelSectors")
+    {
+    auto makeIndex = [](const std::string& name)
+        {
+        return IQIndex(name,
+                       Index(name+"--",80),QN(-2),
+                       Index(name+"-",80),QN(-1),
+                       Index(name+"0",80),QN( 0),
+                       Index(name+"+",80),QN(+1),
+                       Index(name+"++",80),QN(+2),Out);
+        };
+    IQIndex X = makeIndex("X"),
+            Y = makeIndex("Y");
+    IQTensor T(X(1),dag(Y)(1));
+    T.randomize();
+    T *= 1./T.norm();
+
+    IQTensor R(dag(X)(1),prime(X)(1));
+    R.randomize();
+    R = R + swapPrime(R,0,1);
+
+    const int nthread = Global::nthread();
+
+    //Full spectrum, every eigenvalue sorted
+    Global::nthread() = 1;
+    IQTensor U(X),D,V;
+    auto full = svd(T,U,D,V,{"Cutoff",0.,"Maxm",400});
+    CHECK_EQUAL(full.eigs().Length(),400);
+
+    const Args targs = {"Cutoff",0.,"Maxm",100,"Truncate",true};
+
+    IQTensor Us(X),Ds,Vs;
+    auto serial = svd(T,Us,Ds,Vs,targs);
+    IQTensor RUs,RDs;
+    auto rserial = diagHermitian(R,RUs,RDs,targs);
+
+    Global::nthread() = 4;
+    IQTensor Up(X),Dp,Vp;
+    auto parallel = svd(T,Up,Dp,Vp,targs);
+    IQTensor RUp,RDp;
+    auto rparallel = diagHermitian(R,RUp,RDp,targs);
+
+    Global::nthread() = nthread;
+
+    //Kept eigenvalues are the largest, in order
+    CHECK_EQUAL(serial.eigs().Length(),100);
+    Real discarded = 0;
+    for(int j = 101; j <= 400; ++j) discarded += full.eig(j);
+    CHECK_CLOSE(serial.truncerr(),discarded,1E-12);
+    for(int j = 1; j <= 100; ++j)
+        {
+        CHECK_CLOSE(serial.eig(j),full.eig(j),1E-12);
+        if(j > 1) CHECK(serial.eig(j) <= serial.eig(j-1));
+        }
+
+    CHECK_EQUAL(parallel.eigs().Length(),serial.eigs().Length());
+    CHECK(Norm(parallel.eigs()-serial.eigs()) < 1E-12);
+    CHECK_CLOSE(parallel.truncerr(),serial.truncerr(),1E-14);
+    CHECK((Up*Dp*Vp - Us*Ds*Vs).norm() < 1E-10);
+
+    CHECK_EQUAL(rparallel.eigs().Length(),100);
+    CHECK(Norm(rparallel.eigs()-rserial.eigs()) < 1E-12);
+    for(int j = 2; j <= 100; ++j) CHECK(rserial.eig(j) <= rserial.eig(j-1));
+    CHECK((prime(RUp)*RDp*dag(RUp) - prime(RUs)*RDs*dag(RUs)).norm() < 1E-10);
+    }
+SECTION("SVDMethod")
+    {
+    Index a("a",12),
+          b("b",7),
+          c("c",9);
+    ITensor T(a,b,c);
+    T.randomize();
+    T *= 1./T.norm();
+
+    ITensor Ud(a),Dd,Vd;
+    auto dspec = svd(T,Ud,Dd,Vd,{"Cutoff",0.});
+
+    for(auto method : {"gesdd","gesvd"})
+        {
+        ITensor U(a),D,V;
+        auto spec = svd(T,U,D,V,{"Cutoff",0.,"SVDMethod",method});
+        CHECK((T-U*D*V).norm() < 1E-12);
+        CHECK_EQUAL(spec.eigs().Length(),dspec.eigs().Length());
+        CHECK(Norm(spec.eigs()-dspec.eigs()) < 1E-12);
+        }
+
+    IQTensor TR(L1(1),prime(L1(31))),
+             TI(L1(1),prime(L1(31)));
+    IQTensor Z = Complex_1*TR+Complex_i*TI;
+    Z.randomize();
+    Z *= 1.0/Z.norm();
+
+    for(auto method : {"gesdd","gesvd"})
+        {
+        IQTensor U(L1),D,V;
+        svd(Z,U,D,V,{"SVDMethod",method});
+        CHECK((Z-U*D*V).norm() < 1E-10);
+        }
+
+    //Complex tensors default to zgesdd
+    IQTensor ZU(L1),ZD,ZV;
+    auto zspec = svd(Z,ZU,ZD,ZV);
+    CHECK((Z-ZU*ZD*ZV).norm() < 1E-10);
+    IQTensor ZUd(L1),ZDd,ZVd;
+    auto zdspec = svd(Z,ZUd,ZDd,ZVd,{"SVDMethod","DensityMatrix"});
+    CHECK((Z-ZUd*ZDd*ZVd).norm() < 1E-10);
+    CHECK_EQUAL(zspec.eigs().Length(),zdspec.eigs().Length());
+    CHECK(Norm(zspec.eigs()-zdspec.eigs()) < 1E-10);
+    }
+SECTION("Randomized")
+    {
+    //n x m Matrix with singular values scale*2^(-j)
+    auto decaying = [](int n, int m, Real scale)
+        {
+        Matrix U(n,n),V(m,m),S(n,m);
+        U.Randomize();
+        Orthog(U);
+        V.Randomize();
+        Orthog(V);
+        S = 0;
+        for(int j = 1; j <= min(n,m); ++j) S(j,j) = scale*std::pow(2.,-j);
+        Matrix US = U*S;
+        Matrix M = US*V.t();
+        return M;
+        };
+
+    Index a("a",160),
+          b("b",120);
+    ITensor T(a,b,decaying(160,120,1.));
+
+    const Args rargs = {"Cutoff",0.,"Maxm",20,"SVDMethod","Randomized"};
+
+    ITensor U(a),D,V;
+    auto exact = svd(T,U,D,V,{"Cutoff",0.,"Maxm",20});
+    ITensor Ur(a),Dr,Vr;
+    auto rand = svd(T,Ur,Dr,Vr,rargs);
+    CHECK_EQUAL(rand.eigs().Length(),20);
+    CHECK(Norm(rand.eigs()-exact.eigs()) < 1E-12);
+    CHECK_CLOSE(rand.truncerr(),exact.truncerr(),1E-14);
+    CHECK((Ur*Dr*Vr - U*D*V).norm() < 1E-10);
+
+    //Rank set by the cutoff
+    auto cexact = svd(T,U,D,V,{"Cutoff",1E-10});
+    auto crand = svd(T,Ur,Dr,Vr,{"Cutoff",1E-10,"SVDMethod","Randomized"});
+    CHECK_EQUAL(crand.eigs().Length(),cexact.eigs().Length());
+    CHECK(Norm(crand.eigs()-cexact.eigs()) < 1E-12);
+
+    ITensor A(a),B(b);
+    auto dexact = denmatDecomp(T,A,B,Fromleft,{"Cutoff",0.,"Maxm",20});
+    ITensor Ar(a),Br(b);
+    auto drand = denmatDecomp(T,Ar,Br,Fromleft,rargs);
+    CHECK(Norm(drand.eigs()-dexact.eigs()) < 1E-12);
+    CHECK_CLOSE(drand.truncerr(),dexact.truncerr(),1E-14);
+    CHECK((Ar*Br - A*B).norm() < 1E-10);
+
+    //Flat spectrum: falls back to the exact SVD
+    ITensor F(a,b);
+    F.randomize();
+    auto fexact = svd(F,U,D,V,{"Cutoff",0.,"Maxm",20});
+    auto frand = svd(F,Ur,Dr,Vr,rargs);
+    CHECK(Norm(frand.eigs()-fexact.eigs()) < 1E-12);
+    CHECK_CLOSE(frand.truncerr(),fexact.truncerr(),1E-12);
+
+    Index x0("x0",80),x1("x1",80),
+          y0("y0",80),y1("y1",80);
+    IQIndex X("X",x0,QN(0),x1,QN(1),Out),
+            Y("Y",y0,QN(0),y1,QN(1),Out);
+    IQTensor Q(X,dag(Y));
+    Q += ITensor(x0,y0,decaying(80,80,1.));
+    Q += ITensor(x1,y1,decaying(80,80,0.7));
+
+    IQTensor QU(X),QD,QV;
+    auto qexact = svd(Q,QU,QD,QV,{"Cutoff",0.,"Maxm",20});
+    IQTensor QUr(X),QDr,QVr;
+    auto qrand = svd(Q,QUr,QDr,QVr,rargs);
+    CHECK_EQUAL(qrand.eigs().Length(),20);
+    CHECK(Norm(qrand.eigs()-qexact.eigs()) < 1E-12);
+    CHECK_CLOSE(qrand.truncerr(),qexact.truncerr(),1E-14);
+    CHECK((QUr*QDr*QVr - QU*QD*QV).norm() < 1E-10);
+
+    IQTensor QA(X),QB(dag(Y));
+    auto qdexact = denmatDecomp(Q,QA,QB,Fromleft,{"Cutoff",0.,"Maxm",20});
+    IQTensor QAr(X),QBr(dag(Y));
+    auto qdrand = denmatDecomp(Q,QAr,QBr,Fromleft,rargs);
+    CHECK(Norm(qdrand.eigs()-qdexact.eigs()) < 1E-12);
+    CHECK_CLOSE(qdrand.truncerr(),qdexact.truncerr(),1E-14);
+    CHECK((QAr*QBr - QA*QB).norm() < 1E-10);
+    }
+
+SECTION("PartialEig")
+    {
+    Index a("a",160),
+          b("b",120);
+    ITensor T(a,b);
+    T.randomize();
+    T *= 1./T.norm();
+
+    ITensor A(a),B(b);
+    auto exact = denmatDecomp(T,A,B,Fromleft,{"Cutoff",0.,"Maxm",20});
+    ITensor Ap(a),Bp(b);
+    auto part = denmatDecomp(T,Ap,Bp,Fromleft,{"Cutoff",0.,"Maxm",20,"PartialEig",true});
+    CHECK_EQUAL(part.eigs().Length(),20);
+    CHECK(Norm(part.eigs()-exact.eigs()) < 1E-12);
+    CHECK_CLOSE(part.truncerr(),exact.truncerr(),1E-12);
+    CHECK((Ap*Bp - A*B).norm() < 1E-10);
+
+    //Block 0 keeps more states than its diagonal suggests,
+    //so is found to need a full diagonalization
+    Index x0("x0",80),x1("x1",80),
+          y0("y0",80),y1("y1",80);
+    IQIndex X("X",x0,QN(0),x1,QN(1),Out),
+            Y("Y",y0,QN(0),y1,QN(1),Out);
+    Matrix U(80,80),S0(80,80),S1(80,80);
+    U.Randomize();
+    Orthog(U);
+    S0 = 0;
+    S1 = 0;
+    for(int j = 1; j <= 20; ++j) S0(j,j) = sqrt(0.04*(1-j/200.));
+    for(int j = 1; j <= 40; ++j) S1(j,j) = sqrt(0.02*(1-j/200.));
+    Matrix US0 = U*S0;
+    IQTensor Q(X,dag(Y));
+    Q += ITensor(x0,y0,US0);
+    Q += ITensor(x1,y1,S1);
+
+    for(auto& args : {Args("Cutoff",0.,"Maxm",30),
+                      Args("Cutoff",1E-3,"Maxm",45),
+                      Args("Cutoff",0.,"Maxm",60,"DoRelCutoff",true)})
+        {
+        IQTensor QA(X),QB(dag(Y));
+        auto qexact = denmatDecomp(Q,QA,QB,Fromleft,args);
+        IQTensor QAp(X),QBp(dag(Y));
+        auto qpart = denmatDecomp(Q,QAp,QBp,Fromleft,args + Args("PartialEig",true));
+        CHECK_EQUAL(qpart.eigs().Length(),qexact.eigs().Length());
+        CHECK(Norm(qpart.eigs()-qexact.eigs()) < 1E-12);
+        CHECK_CLOSE(qpart.truncerr(),qexact.truncerr(),1E-12);
+        CHECK((QAp*QBp - QA*QB).norm() < 1E-10);
+        }
+    }
+
 }
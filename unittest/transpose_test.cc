@@ -0,0 +1,160 @@
+#include "test.h"
+#include "transpose.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using namespace itensor;
+using std::vector;
+
+//Straightforward (unblocked) permutation used as a reference
+void static
+naiveTranspose(const vector<long>& dims,
+               const vector<long>& dest,
+               const vector<Real>& src,
+               vector<Real>& dst)
+    {
+    const long r = dims.size();
+    vector<long> ndims(r);
+    for(long k = 0; k < r; ++k) ndims[dest[k]] = dims[k];
+    dst.assign(src.size(),0);
+    vector<long> i(r,0);
+    for(size_t n = 0; n < src.size(); ++n)
+        {
+        long d = 0;
+        for(long k = r-1; k >= 0; --k)
+            {
+            //find source dim going to position k
+            long j = std::find(dest.begin(),dest.end(),k)-dest.begin();
+            d = d*ndims[k]+i[j];
+            }
+        dst[d] = src[n];
+        for(long k = 0; k < r; ++k)
+            {
+            if(++i[k] < dims[k]) break;
+            i[k] = 0;
+            }
+        }
+    }
+
+bool static
+checkAllPerms(const vector<long>& dims, int nthread = 1)
+    {
+    const long r = dims.size();
+    long size = 1;
+    for(long d : dims) size *= d;
+    vector<Real> src(size);
+    for(long n = 0; n < size; ++n) src[n] = n+0.5;
+
+    vector<long> dest(r);
+    for(long k = 0; k < r; ++k) dest[k] = k;
+    do  {
+        vector<Real> ref,
+                     res(size,0);
+        naiveTranspose(dims,dest,src,ref);
+        TransposePlan plan(dims,dest);
+        plan.forEach([&src,&res](long s, long d) { res[d] = src[s]; },nthread);
+        if(res != ref) return false;
+        std::fill(res.begin(),res.end(),0);
+        plan(src.data(),res.data());
+        if(res != ref) return false;
+        }
+    while(std::next_permutation(dest.begin(),dest.end()));
+    return true;
+    }
+
+TEST_CASE("TransposePlan")
+{
+
+SECTION("Rank2")
+    {
+    CHECK(checkAllPerms({3,5}));
+    CHECK(checkAllPerms({40,70}));
+    CHECK(checkAllPerms({1,7}));
+    }
+
+SECTION("Rank3")
+    {
+    CHECK(checkAllPerms({2,3,4}));
+    CHECK(checkAllPerms({33,1,35}));
+    }
+
+SECTION("Rank4")
+    {
+    CHECK(checkAllPerms({2,3,4,5}));
+    CHECK(checkAllPerms({37,2,1,34}));
+    }
+
+SECTION("Rank5and6")
+    {
+    CHECK(checkAllPerms({2,3,1,4,3}));
+    CHECK(checkAllPerms({2,3,2,2,3,2}));
+    }
+
+SECTION("Rank8")
+    {
+    vector<long> dims = {2,1,3,2,2,1,2,3},
+                 dest = {7,0,5,1,6,2,4,3};
+    vector<Real> src(2*3*2*2*2*3);
+    for(size_t n = 0; n < src.size(); ++n) src[n] = n;
+    vector<Real> ref,
+                 res(src.size());
+    naiveTranspose(dims,dest,src,ref);
+    TransposePlan(dims,dest)(src.data(),res.data());
+    CHECK(res == ref);
+    }
+
+SECTION("Fusing")
+    {
+    //Permutation keeping blocks of neighbors together
+    //reduces to a rank 2 transpose
+    vector<long> dims = {3,4,5,6},
+                 dest = {2,3,0,1};
+    TransposePlan plan(dims,dest);
+    CHECK(!plan.isCopy());
+    CHECK(plan.size() == 3*4*5*6);
+
+    TransposePlan triv({3,1,4},{1,0,2});
+    CHECK(triv.isCopy());
+    }
+
+SECTION("Multithreaded")
+    {
+    CHECK(checkAllPerms({130,2,131,3},4));
+    CHECK(checkAllPerms({300,301},3));
+    }
+
+SECTION("TaskErrors")
+    {
+    //Errors thrown by tasks reach the calling thread
+    //Tasks after the failing one wait for it, so that
+    //skipping the rest does not depend on scheduling
+    std::atomic<long> ran(0);
+    std::atomic<bool> thrown(false);
+    auto task = [&ran,&thrown](long k)
+        {
+        if(k > 7)
+            {
+            while(!thrown) std::this_thread::yield();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        ++ran;
+        if(k == 7) 
+            {
+            thrown = true;
+            throw ITError("task failed");
+            }
+        };
+    CHECK_THROWS_AS(detail::parallelTasks(10000,4,task),ITError);
+    CHECK(ran.load() < 10000);
+    CHECK(!detail::inParallelTask());
+
+    auto range = [](long begin, long end)
+        {
+        if(begin > 0) throw ITError("range failed");
+        };
+    CHECK_THROWS_AS(detail::parallelRanges(100,4,range),ITError);
+    CHECK_NOTHROW(detail::parallelRanges(100,1,range));
+    }
+
+}